@@ -0,0 +1 @@
+/usr/bin/cc  -Wall -Wextra -O2 -include config.h -D__LINUX__=1 -L./ -o .bench/bench .bench/tools/bench/bench.c.o  libtwin.a -pthread -ljpeg  -lpng16   
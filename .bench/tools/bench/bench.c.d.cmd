@@ -0,0 +1 @@
+/usr/bin/cc -Wall -Wextra -O2 -include config.h -D__LINUX__=1   -Iinclude -M tools/bench/bench.c | sed 's,\(bench\.o\) *:,.bench/tools/bench/ .bench/tools/bench/bench.c.d: ,' > .bench/tools/bench/bench.c.d; cp -rf .bench/tools/bench/bench.c.d .bench/tools/bench/bench.c.d.p; sed -e 's/#.*//' -e 's/^[^:]*: *//' -e 's/ *\$//' -e '/^$/ d' -e 's/$/ :/' < .bench/tools/bench/bench.c.d >> .bench/tools/bench/bench.c.d.p; mv .bench/tools/bench/bench.c.d.p .bench/tools/bench/bench.c.d
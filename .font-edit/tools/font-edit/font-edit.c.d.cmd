@@ -0,0 +1 @@
+/usr/bin/cc -Wall -Wextra -O2 -include config.h -D__LINUX__=1   -Itools/font-edit -M tools/font-edit/font-edit.c | sed 's,\(font-edit\.o\) *:,.font-edit/tools/font-edit/ .font-edit/tools/font-edit/font-edit.c.d: ,' > .font-edit/tools/font-edit/font-edit.c.d; cp -rf .font-edit/tools/font-edit/font-edit.c.d .font-edit/tools/font-edit/font-edit.c.d.p; sed -e 's/#.*//' -e 's/^[^:]*: *//' -e 's/ *\$//' -e '/^$/ d' -e 's/$/ :/' < .font-edit/tools/font-edit/font-edit.c.d >> .font-edit/tools/font-edit/font-edit.c.d.p; mv .font-edit/tools/font-edit/font-edit.c.d.p .font-edit/tools/font-edit/font-edit.c.d
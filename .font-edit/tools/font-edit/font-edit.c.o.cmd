@@ -0,0 +1 @@
+/usr/bin/cc  -Wall -Wextra -O2 -include config.h -D__LINUX__=1    -Itools/font-edit -c -o .font-edit/tools/font-edit/font-edit.c.o tools/font-edit/font-edit.c
@@ -0,0 +1 @@
+/usr/bin/cc -Wall -Wextra -O2 -include config.h -D__LINUX__=1   -Iinclude -M apps/animation.c | sed 's,\(animation\.o\) *:,.libapps.a/apps/ .libapps.a/apps/animation.c.d: ,' > .libapps.a/apps/animation.c.d; cp -rf .libapps.a/apps/animation.c.d .libapps.a/apps/animation.c.d.p; sed -e 's/#.*//' -e 's/^[^:]*: *//' -e 's/ *\$//' -e '/^$/ d' -e 's/$/ :/' < .libapps.a/apps/animation.c.d >> .libapps.a/apps/animation.c.d.p; mv .libapps.a/apps/animation.c.d.p .libapps.a/apps/animation.c.d
@@ -0,0 +1 @@
+/usr/bin/cc -Wall -Wextra -O2 -include config.h -D__LINUX__=1   -Iinclude -M apps/clock.c | sed 's,\(clock\.o\) *:,.libapps.a/apps/ .libapps.a/apps/clock.c.d: ,' > .libapps.a/apps/clock.c.d; cp -rf .libapps.a/apps/clock.c.d .libapps.a/apps/clock.c.d.p; sed -e 's/#.*//' -e 's/^[^:]*: *//' -e 's/ *\$//' -e '/^$/ d' -e 's/$/ :/' < .libapps.a/apps/clock.c.d >> .libapps.a/apps/clock.c.d.p; mv .libapps.a/apps/clock.c.d.p .libapps.a/apps/clock.c.d
@@ -0,0 +1 @@
+/usr/bin/cc -Wall -Wextra -O2 -include config.h -D__LINUX__=1   -Iinclude -M apps/line.c | sed 's,\(line\.o\) *:,.libapps.a/apps/ .libapps.a/apps/line.c.d: ,' > .libapps.a/apps/line.c.d; cp -rf .libapps.a/apps/line.c.d .libapps.a/apps/line.c.d.p; sed -e 's/#.*//' -e 's/^[^:]*: *//' -e 's/ *\$//' -e '/^$/ d' -e 's/$/ :/' < .libapps.a/apps/line.c.d >> .libapps.a/apps/line.c.d.p; mv .libapps.a/apps/line.c.d.p .libapps.a/apps/line.c.d
@@ -0,0 +1 @@
+/usr/bin/cc -Wall -Wextra -O2 -include config.h -D__LINUX__=1   -Iinclude -M apps/spline.c | sed 's,\(spline\.o\) *:,.libapps.a/apps/ .libapps.a/apps/spline.c.d: ,' > .libapps.a/apps/spline.c.d; cp -rf .libapps.a/apps/spline.c.d .libapps.a/apps/spline.c.d.p; sed -e 's/#.*//' -e 's/^[^:]*: *//' -e 's/ *\$//' -e '/^$/ d' -e 's/$/ :/' < .libapps.a/apps/spline.c.d >> .libapps.a/apps/spline.c.d.p; mv .libapps.a/apps/spline.c.d.p .libapps.a/apps/spline.c.d
@@ -0,0 +1 @@
+/usr/bin/cc -Wall -Wextra -O2 -include config.h -D__LINUX__=1 -I/usr/include/libpng16   -Iinclude -Isrc -M backend/fbdev.c | sed 's,\(fbdev\.o\) *:,.libtwin.a/backend/ .libtwin.a/backend/fbdev.c.d: ,' > .libtwin.a/backend/fbdev.c.d; cp -rf .libtwin.a/backend/fbdev.c.d .libtwin.a/backend/fbdev.c.d.p; sed -e 's/#.*//' -e 's/^[^:]*: *//' -e 's/ *\$//' -e '/^$/ d' -e 's/$/ :/' < .libtwin.a/backend/fbdev.c.d >> .libtwin.a/backend/fbdev.c.d.p; mv .libtwin.a/backend/fbdev.c.d.p .libtwin.a/backend/fbdev.c.d
@@ -0,0 +1 @@
+/usr/bin/cc -Wall -Wextra -O2 -include config.h -D__LINUX__=1 -I/usr/include/libpng16   -Iinclude -Isrc -M src/box.c | sed 's,\(box\.o\) *:,.libtwin.a/src/ .libtwin.a/src/box.c.d: ,' > .libtwin.a/src/box.c.d; cp -rf .libtwin.a/src/box.c.d .libtwin.a/src/box.c.d.p; sed -e 's/#.*//' -e 's/^[^:]*: *//' -e 's/ *\$//' -e '/^$/ d' -e 's/$/ :/' < .libtwin.a/src/box.c.d >> .libtwin.a/src/box.c.d.p; mv .libtwin.a/src/box.c.d.p .libtwin.a/src/box.c.d
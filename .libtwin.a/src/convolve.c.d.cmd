@@ -0,0 +1 @@
+/usr/bin/cc -Wall -Wextra -O2 -include config.h -D__LINUX__=1 -I/usr/include/libpng16   -Iinclude -Isrc -M src/convolve.c | sed 's,\(convolve\.o\) *:,.libtwin.a/src/ .libtwin.a/src/convolve.c.d: ,' > .libtwin.a/src/convolve.c.d; cp -rf .libtwin.a/src/convolve.c.d .libtwin.a/src/convolve.c.d.p; sed -e 's/#.*//' -e 's/^[^:]*: *//' -e 's/ *\$//' -e '/^$/ d' -e 's/$/ :/' < .libtwin.a/src/convolve.c.d >> .libtwin.a/src/convolve.c.d.p; mv .libtwin.a/src/convolve.c.d.p .libtwin.a/src/convolve.c.d
@@ -0,0 +1 @@
+/usr/bin/cc -Wall -Wextra -O2 -include config.h -D__LINUX__=1 -I/usr/include/libpng16   -Iinclude -Isrc -M src/font.c | sed 's,\(font\.o\) *:,.libtwin.a/src/ .libtwin.a/src/font.c.d: ,' > .libtwin.a/src/font.c.d; cp -rf .libtwin.a/src/font.c.d .libtwin.a/src/font.c.d.p; sed -e 's/#.*//' -e 's/^[^:]*: *//' -e 's/ *\$//' -e '/^$/ d' -e 's/$/ :/' < .libtwin.a/src/font.c.d >> .libtwin.a/src/font.c.d.p; mv .libtwin.a/src/font.c.d.p .libtwin.a/src/font.c.d
@@ -0,0 +1 @@
+/usr/bin/cc -Wall -Wextra -O2 -include config.h -D__LINUX__=1 -I/usr/include/libpng16   -Iinclude -Isrc -M src/log.c | sed 's,\(log\.o\) *:,.libtwin.a/src/ .libtwin.a/src/log.c.d: ,' > .libtwin.a/src/log.c.d; cp -rf .libtwin.a/src/log.c.d .libtwin.a/src/log.c.d.p; sed -e 's/#.*//' -e 's/^[^:]*: *//' -e 's/ *\$//' -e '/^$/ d' -e 's/$/ :/' < .libtwin.a/src/log.c.d >> .libtwin.a/src/log.c.d.p; mv .libtwin.a/src/log.c.d.p .libtwin.a/src/log.c.d
@@ -0,0 +1 @@
+/usr/bin/cc -Wall -Wextra -O2 -include config.h -D__LINUX__=1 -I/usr/include/libpng16   -Iinclude -Isrc -M src/poly-analytic.c | sed 's,\(poly-analytic\.o\) *:,.libtwin.a/src/ .libtwin.a/src/poly-analytic.c.d: ,' > .libtwin.a/src/poly-analytic.c.d; cp -rf .libtwin.a/src/poly-analytic.c.d .libtwin.a/src/poly-analytic.c.d.p; sed -e 's/#.*//' -e 's/^[^:]*: *//' -e 's/ *\$//' -e '/^$/ d' -e 's/$/ :/' < .libtwin.a/src/poly-analytic.c.d >> .libtwin.a/src/poly-analytic.c.d.p; mv .libtwin.a/src/poly-analytic.c.d.p .libtwin.a/src/poly-analytic.c.d
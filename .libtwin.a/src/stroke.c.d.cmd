@@ -0,0 +1 @@
+/usr/bin/cc -Wall -Wextra -O2 -include config.h -D__LINUX__=1 -I/usr/include/libpng16   -Iinclude -Isrc -M src/stroke.c | sed 's,\(stroke\.o\) *:,.libtwin.a/src/ .libtwin.a/src/stroke.c.d: ,' > .libtwin.a/src/stroke.c.d; cp -rf .libtwin.a/src/stroke.c.d .libtwin.a/src/stroke.c.d.p; sed -e 's/#.*//' -e 's/^[^:]*: *//' -e 's/ *\$//' -e '/^$/ d' -e 's/$/ :/' < .libtwin.a/src/stroke.c.d >> .libtwin.a/src/stroke.c.d.p; mv .libtwin.a/src/stroke.c.d.p .libtwin.a/src/stroke.c.d
@@ -0,0 +1 @@
+/usr/bin/cc -Wall -Wextra -O2 -include config.h -D__LINUX__=1 -I/usr/include/libpng16   -Iinclude -Isrc -M src/text-run.c | sed 's,\(text-run\.o\) *:,.libtwin.a/src/ .libtwin.a/src/text-run.c.d: ,' > .libtwin.a/src/text-run.c.d; cp -rf .libtwin.a/src/text-run.c.d .libtwin.a/src/text-run.c.d.p; sed -e 's/#.*//' -e 's/^[^:]*: *//' -e 's/ *\$//' -e '/^$/ d' -e 's/$/ :/' < .libtwin.a/src/text-run.c.d >> .libtwin.a/src/text-run.c.d.p; mv .libtwin.a/src/text-run.c.d.p .libtwin.a/src/text-run.c.d
@@ -208,6 +208,8 @@ static void _apps_spline_init(apps_spline_t *spline,
         twin_button_create(parent, "Switch curve", 0xffae0000, D(10),
                            TwinStyleBold | TwinStyleOblique);
     twin_widget_set(&button->label.widget, 0xc0808080);
+    /* dragging repaints the button along with the curve */
+    twin_widget_set_retained(&button->label.widget, true);
     button->signal = _apps_spline_button_signal;
     button->closure = spline;
     button->label.widget.shape = TwinShapeRectangle;
@@ -0,0 +1,375 @@
+/*
+ * Twin - A Tiny Window System
+ * Copyright (c) 2025 National Cheng Kung University, Taiwan
+ * All rights reserved.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <twin.h>
+
+#if defined(CONFIG_LOADER_PNG)
+#include <png.h>
+#endif
+
+#include "twin_backend.h"
+#include "twin_private.h"
+
+/*
+ * Headless backend
+ *
+ * Renders into an in-memory ARGB32 framebuffer. Input comes from an optional
+ * script named by MADO_HEADLESS_SCRIPT, one command per line:
+ *
+ *   motion X Y           pointer motion
+ *   down X Y [BUTTON]    button press (default button 1)
+ *   up X Y [BUTTON]      button release
+ *   key down|up KEYSYM   key event
+ *   ucs4 CODEPOINT       character input
+ *   wait MS              keep running timeouts and work for MS milliseconds
+ *   frame                update the screen and dump it
+ *   dump PATH            update the screen and write it to PATH
+ *   quit                 leave twin_dispatch()
+ *
+ * Blank lines and lines starting with '#' are ignored; the end of the script
+ * acts as "quit". Frames are dumped to the printf-style pattern in
+ * MADO_HEADLESS_DUMP (e.g. "frame-%04d.png"), which receives the frame
+ * number; it must hold exactly one integer conversion, and any other '%'
+ * must be written "%%". Paths ending in ".png" are written as PNG when the
+ * PNG loader is enabled; anything else gets the raw little-endian ARGB32
+ * pixels.
+ */
+
+#define SCRIPT_NAME "MADO_HEADLESS_SCRIPT"
+#define DUMP_NAME "MADO_HEADLESS_DUMP"
+
+#define SCREEN(x) ((twin_context_t *) x)->screen
+#define PRIV(x) ((twin_headless_t *) ((twin_context_t *) x)->priv)
+
+typedef struct {
+    twin_argb32_t *framebuffer;
+    twin_coord_t width, height;
+
+    /* Event script */
+    FILE *script;
+    int line;
+    bool done;
+
+    /* Frame dumps */
+    const char *dump_pattern;
+    int frame;
+} twin_headless_t;
+
+static void _twin_headless_put_span(twin_coord_t left,
+                                    twin_coord_t top,
+                                    twin_coord_t right,
+                                    twin_argb32_t *pixels,
+                                    void *closure)
+{
+    twin_headless_t *tx = PRIV(closure);
+
+    memcpy(tx->framebuffer + top * tx->width + left, pixels,
+           (right - left) * sizeof(*pixels));
+}
+
+static bool twin_headless_work(void *closure)
+{
+    twin_screen_t *screen = SCREEN(closure);
+
+    if (twin_screen_damaged(screen))
+        twin_screen_update(screen);
+    return true;
+}
+
+twin_argb32_t *twin_headless_framebuffer(twin_context_t *ctx)
+{
+    return PRIV(ctx)->framebuffer;
+}
+
+#if defined(CONFIG_LOADER_PNG)
+static bool twin_headless_dump_png(twin_headless_t *tx, FILE *file)
+{
+    png_structp png;
+    png_infop info;
+    png_bytep row;
+    twin_coord_t x, y;
+
+    png = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+    if (!png)
+        return false;
+    info = png_create_info_struct(png);
+    row = malloc(tx->width * 4);
+    if (!info || !row || setjmp(png_jmpbuf(png))) {
+        free(row);
+        png_destroy_write_struct(&png, &info);
+        return false;
+    }
+
+    png_init_io(png, file);
+    png_set_IHDR(png, info, tx->width, tx->height, 8, PNG_COLOR_TYPE_RGB_ALPHA,
+                 PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_DEFAULT,
+                 PNG_FILTER_TYPE_DEFAULT);
+    png_write_info(png, info);
+    for (y = 0; y < tx->height; y++) {
+        twin_argb32_t *p = tx->framebuffer + y * tx->width;
+
+        /* the screen is opaque; emit straight RGBA */
+        for (x = 0; x < tx->width; x++) {
+            row[x * 4 + 0] = p[x] >> 16;
+            row[x * 4 + 1] = p[x] >> 8;
+            row[x * 4 + 2] = p[x];
+            row[x * 4 + 3] = p[x] >> 24;
+        }
+        png_write_row(png, row);
+    }
+    png_write_end(png, NULL);
+    free(row);
+    png_destroy_write_struct(&png, &info);
+    return true;
+}
+#endif
+
+static bool twin_headless_dump_raw(twin_headless_t *tx, FILE *file)
+{
+    size_t n = (size_t) tx->width * tx->height;
+
+    return fwrite(tx->framebuffer, sizeof(twin_argb32_t), n, file) == n;
+}
+
+bool twin_headless_dump(twin_context_t *ctx, const char *path)
+{
+    twin_headless_t *tx = PRIV(ctx);
+    size_t len = strlen(path);
+    bool ok;
+    FILE *file;
+
+    twin_headless_work(ctx);
+
+    file = fopen(path, "wb");
+    if (!file) {
+        log_error("Failed to open %s", path);
+        return false;
+    }
+    if (len > 4 && !strcmp(path + len - 4, ".png")) {
+#if defined(CONFIG_LOADER_PNG)
+        ok = twin_headless_dump_png(tx, file);
+#else
+        log_warn("PNG support is disabled; writing raw pixels to %s", path);
+        ok = twin_headless_dump_raw(tx, file);
+#endif
+    } else
+        ok = twin_headless_dump_raw(tx, file);
+    if (fclose(file) != 0)
+        ok = false;
+    if (!ok)
+        log_error("Failed to write %s", path);
+    return ok;
+}
+
+/*
+ * The dump pattern comes from the environment and is handed to snprintf(), so
+ * accept nothing but "%%" and a single int conversion with optional flags,
+ * width and precision
+ */
+static bool twin_headless_pattern_ok(const char *pattern)
+{
+    int conversions = 0;
+
+    for (const char *p = pattern; *p; p++) {
+        if (*p != '%')
+            continue;
+        if (*++p == '%')
+            continue;
+        p += strspn(p, "-+ #0");
+        p += strspn(p, "0123456789");
+        if (*p == '.') {
+            p++;
+            p += strspn(p, "0123456789");
+        }
+        if (!*p || !strchr("diouxX", *p))
+            return false;
+        conversions++;
+    }
+    return conversions == 1;
+}
+
+static void twin_headless_frame(twin_context_t *ctx)
+{
+    twin_headless_t *tx = PRIV(ctx);
+    char path[256];
+
+    twin_headless_work(ctx);
+    if (!tx->dump_pattern)
+        return;
+    snprintf(path, sizeof(path), tx->dump_pattern, tx->frame);
+    twin_headless_dump(ctx, path);
+    tx->frame++;
+}
+
+static void twin_headless_pointer(twin_screen_t *screen,
+                                  twin_event_kind_t kind,
+                                  int x,
+                                  int y,
+                                  int button)
+{
+    twin_event_t ev;
+
+    ev.kind = kind;
+    ev.u.pointer.screen_x = x;
+    ev.u.pointer.screen_y = y;
+    ev.u.pointer.button = button;
+    twin_screen_dispatch(screen, &ev);
+}
+
+/*
+ * Run one script command; return the delay before the next one, or -1 once
+ * the script is over
+ */
+static twin_time_t twin_headless_step(twin_context_t *ctx)
+{
+    twin_headless_t *tx = PRIV(ctx);
+    twin_screen_t *screen = SCREEN(ctx);
+    char line[512], cmd[16], arg[256];
+    int x, y, n, button;
+    twin_event_t ev;
+
+    if (!fgets(line, sizeof(line), tx->script))
+        return -1;
+    tx->line++;
+
+    n = sscanf(line, "%15s", cmd);
+    if (n != 1 || cmd[0] == '#')
+        return 0;
+
+    button = 1;
+    if (!strcmp(cmd, "motion") && sscanf(line, "%*s %d %d", &x, &y) == 2)
+        twin_headless_pointer(screen, TwinEventMotion, x, y, 0);
+    else if (!strcmp(cmd, "down") &&
+             sscanf(line, "%*s %d %d %d", &x, &y, &button) >= 2)
+        twin_headless_pointer(screen, TwinEventButtonDown, x, y, button);
+    else if (!strcmp(cmd, "up") &&
+             sscanf(line, "%*s %d %d %d", &x, &y, &button) >= 2)
+        twin_headless_pointer(screen, TwinEventButtonUp, x, y, button);
+    else if (!strcmp(cmd, "key") &&
+             sscanf(line, "%*s %255s %i", arg, &x) == 2) {
+        ev.kind = strcmp(arg, "up") ? TwinEventKeyDown : TwinEventKeyUp;
+        ev.u.key.key = x;
+        twin_screen_dispatch(screen, &ev);
+    } else if (!strcmp(cmd, "ucs4") && sscanf(line, "%*s %i", &x) == 1) {
+        ev.kind = TwinEventUcs4;
+        ev.u.ucs4.ucs4 = x;
+        twin_screen_dispatch(screen, &ev);
+    } else if (!strcmp(cmd, "wait") && sscanf(line, "%*s %d", &x) == 1)
+        return x > 0 ? x : 0;
+    else if (!strcmp(cmd, "frame"))
+        twin_headless_frame(ctx);
+    else if (!strcmp(cmd, "dump") && sscanf(line, "%*s %255s", arg) == 1)
+        twin_headless_dump(ctx, arg);
+    else if (!strcmp(cmd, "quit"))
+        return -1;
+    else
+        log_warn("%s:%d: unknown command '%s'", SCRIPT_NAME, tx->line, cmd);
+    return 0;
+}
+
+/* The script runs as a timeout, one command per dispatch iteration */
+static twin_time_t twin_headless_script(twin_time_t now maybe_unused,
+                                        void *closure)
+{
+    twin_time_t delay = twin_headless_step(closure);
+
+    if (delay < 0) {
+        PRIV(closure)->done = true;
+        twin_wakeup();
+    }
+    return delay;
+}
+
+static bool twin_headless_poll(twin_context_t *ctx)
+{
+    return !PRIV(ctx)->done;
+}
+
+twin_context_t *twin_headless_init(int width, int height)
+{
+    twin_context_t *ctx = calloc(1, sizeof(twin_context_t));
+    if (!ctx)
+        return NULL;
+    ctx->priv = calloc(1, sizeof(twin_headless_t));
+    if (!ctx->priv)
+        goto bail;
+
+    twin_headless_t *tx = ctx->priv;
+    tx->width = width;
+    tx->height = height;
+    tx->framebuffer = calloc((size_t) width * height, sizeof(twin_argb32_t));
+    if (!tx->framebuffer) {
+        log_error("Failed to allocate framebuffer");
+        goto bail_priv;
+    }
+
+    const char *script = getenv(SCRIPT_NAME);
+    if (script) {
+        tx->script = fopen(script, "r");
+        if (!tx->script) {
+            log_error("Failed to open event script %s", script);
+            goto bail_framebuffer;
+        }
+    }
+    tx->dump_pattern = getenv(DUMP_NAME);
+    if (tx->dump_pattern && !twin_headless_pattern_ok(tx->dump_pattern)) {
+        log_error("%s must contain exactly one integer conversion: %s",
+                  DUMP_NAME, tx->dump_pattern);
+        goto bail_script;
+    }
+
+    ctx->screen = twin_screen_create(width, height, NULL,
+                                     _twin_headless_put_span, ctx);
+    if (!ctx->screen)
+        goto bail_script;
+
+    twin_set_work(twin_headless_work, TWIN_WORK_REDISPLAY, ctx);
+    if (tx->script)
+        twin_set_timeout(twin_headless_script, 0, ctx);
+
+    return ctx;
+
+bail_script:
+    if (tx->script)
+        fclose(tx->script);
+bail_framebuffer:
+    free(tx->framebuffer);
+bail_priv:
+    free(ctx->priv);
+bail:
+    free(ctx);
+    return NULL;
+}
+
+static void twin_headless_configure(twin_context_t *ctx)
+{
+    twin_screen_resize(ctx->screen, PRIV(ctx)->width, PRIV(ctx)->height);
+}
+
+static void twin_headless_exit(twin_context_t *ctx)
+{
+    if (!ctx)
+        return;
+    twin_headless_t *tx = PRIV(ctx);
+    if (tx->script)
+        fclose(tx->script);
+    twin_screen_destroy(ctx->screen);
+    free(tx->framebuffer);
+    free(ctx->priv);
+    free(ctx);
+}
+
+/* Register the headless backend */
+
+const twin_backend_t g_twin_backend = {
+    .init = twin_headless_init,
+    .configure = twin_headless_configure,
+    .poll = twin_headless_poll,
+    .exit = twin_headless_exit,
+};
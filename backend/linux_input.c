@@ -11,6 +11,7 @@
 #include <pthread.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/eventfd.h>
 #include <twin.h>
 #include <unistd.h>
 
@@ -22,6 +23,10 @@
 #define UDEV_RESERVED_CNT 1
 #define UDEV_EVDEV_FD_CNT (EVDEV_CNT_MAX + UDEV_RESERVED_CNT)
 
+/* Must be a power of two */
+#define EVENT_RING_SIZE 256
+#define EVENT_RING_MASK (EVENT_RING_SIZE - 1)
+
 struct evdev_info {
     int idx;
     int fd;
@@ -36,6 +41,17 @@ typedef struct {
     int fd;
     int btns;
     int x, y;
+    bool moved; /* pointer moved since the last motion event */
+
+    /*
+     * Events travel from the evdev thread to the dispatch loop through a
+     * single-producer single-consumer ring; the eventfd wakes the loop.
+     */
+    twin_event_t ring[EVENT_RING_SIZE];
+    unsigned int head; /* next slot to fill, advanced by the evdev thread */
+    unsigned int tail; /* next slot to drain, advanced by the dispatch loop */
+    int wake_fd;
+    twin_file_t *wake_file;
 } twin_linux_input_t;
 
 static void check_mouse_bounds(twin_linux_input_t *tm)
@@ -50,65 +66,108 @@ static void check_mouse_bounds(twin_linux_input_t *tm)
         tm->y = tm->screen->height;
 }
 
-static void twin_linux_input_events(struct input_event *ev,
-                                    twin_linux_input_t *tm)
+static void twin_linux_input_push(twin_linux_input_t *tm,
+                                  twin_event_kind_t kind)
 {
-    /* TODO: twin_screen_dispatch() should be protect by mutex_lock, but the
-     * counterpart piece of code with mutex is not yet sure */
+    unsigned int head = tm->head;
+    uint64_t one = 1;
+    twin_event_t *tev;
+
+    /*
+     * Rather than lose a button transition, hold the evdev thread back until
+     * the dispatch loop catches up; the kernel keeps buffering meanwhile.
+     */
+    while (head - __atomic_load_n(&tm->tail, __ATOMIC_ACQUIRE) ==
+           EVENT_RING_SIZE) {
+        if (write(tm->wake_fd, &one, sizeof(one)) < 0)
+            log_error("Failed to wake up the dispatch loop");
+        usleep(1000);
+    }
 
-    twin_event_t tev;
+    tev = &tm->ring[head & EVENT_RING_MASK];
+    tev->kind = kind;
+    tev->u.pointer.screen_x = tm->x;
+    tev->u.pointer.screen_y = tm->y;
+    tev->u.pointer.button = tm->btns;
+    __atomic_store_n(&tm->head, head + 1, __ATOMIC_RELEASE);
+}
+
+/* Report the pointer position once all axes of a packet are known */
+static void twin_linux_input_motion(twin_linux_input_t *tm)
+{
+    if (!tm->moved)
+        return;
+    tm->moved = false;
+    twin_linux_input_push(tm, TwinEventMotion);
+}
 
+static void twin_linux_input_events(struct input_event *ev,
+                                    twin_linux_input_t *tm)
+{
     switch (ev->type) {
     case EV_REL:
         if (ev->code == REL_X) {
             tm->x += ev->value;
-            check_mouse_bounds(tm);
-            tev.kind = TwinEventMotion;
-            tev.u.pointer.screen_x = tm->x;
-            tev.u.pointer.screen_y = tm->y;
-            tev.u.pointer.button = tm->btns;
-            twin_screen_dispatch(tm->screen, &tev);
+            tm->moved = true;
         } else if (ev->code == REL_Y) {
             tm->y += ev->value;
-            check_mouse_bounds(tm);
-            tev.kind = TwinEventMotion;
-            tev.u.pointer.screen_x = tm->x;
-            tev.u.pointer.screen_y = tm->y;
-            tev.u.pointer.button = tm->btns;
-            twin_screen_dispatch(tm->screen, &tev);
+            tm->moved = true;
         }
+        check_mouse_bounds(tm);
         break;
     case EV_ABS:
         if (ev->code == ABS_X) {
             tm->x = ev->value;
-            check_mouse_bounds(tm);
-            tev.kind = TwinEventMotion;
-            tev.u.pointer.screen_x = tm->x;
-            tev.u.pointer.screen_y = tm->y;
-            tev.u.pointer.button = tm->btns;
-            twin_screen_dispatch(tm->screen, &tev);
+            tm->moved = true;
         } else if (ev->code == ABS_Y) {
             tm->y = ev->value;
-            check_mouse_bounds(tm);
-            tev.kind = TwinEventMotion;
-            tev.u.pointer.screen_x = tm->x;
-            tev.u.pointer.screen_y = tm->y;
-            tev.u.pointer.button = tm->btns;
-            twin_screen_dispatch(tm->screen, &tev);
+            tm->moved = true;
         }
+        check_mouse_bounds(tm);
         break;
     case EV_KEY:
         if (ev->code == BTN_LEFT) {
+            /* Press and release where the pointer is now */
+            twin_linux_input_motion(tm);
             tm->btns = ev->value > 0 ? 1 : 0;
-            tev.kind = tm->btns ? TwinEventButtonDown : TwinEventButtonUp;
-            tev.u.pointer.screen_x = tm->x;
-            tev.u.pointer.screen_y = tm->y;
-            tev.u.pointer.button = tm->btns;
-            twin_screen_dispatch(tm->screen, &tev);
+            twin_linux_input_push(tm, tm->btns ? TwinEventButtonDown
+                                               : TwinEventButtonUp);
         }
+        break;
+    case EV_SYN:
+        if (ev->code == SYN_REPORT)
+            twin_linux_input_motion(tm);
+        break;
     }
 }
 
+/* Dispatch the queued events on the thread running twin_dispatch() */
+static bool twin_linux_input_drain(int file,
+                                   twin_file_op_t ops maybe_unused,
+                                   void *closure)
+{
+    twin_linux_input_t *tm = closure;
+    unsigned int tail = tm->tail;
+    unsigned int head = __atomic_load_n(&tm->head, __ATOMIC_ACQUIRE);
+    uint64_t count;
+    twin_event_t tev;
+
+    if (read(file, &count, sizeof(count)) < 0)
+        log_error("Failed to read input wakeups");
+
+    while (tail != head) {
+        tev = tm->ring[tail & EVENT_RING_MASK];
+        __atomic_store_n(&tm->tail, ++tail, __ATOMIC_RELEASE);
+
+        /* Only the latest of consecutive motions matters */
+        if (tev.kind == TwinEventMotion && tail != head &&
+            tm->ring[tail & EVENT_RING_MASK].kind == TwinEventMotion)
+            continue;
+        twin_screen_dispatch(tm->screen, &tev);
+    }
+    return true;
+}
+
 static int twin_linux_udev_init(struct udev **udev, struct udev_monitor **mon)
 {
     /* Create udev object */
@@ -275,6 +334,13 @@ static void *twin_linux_evdev_thread(void *arg)
                 twin_linux_input_events(&ev, tm);
             }
         }
+
+        /* Wake the dispatch loop if anything was queued */
+        if (tm->head != __atomic_load_n(&tm->tail, __ATOMIC_ACQUIRE)) {
+            uint64_t one = 1;
+            if (write(tm->wake_fd, &one, sizeof(one)) < 0)
+                log_error("Failed to wake up the dispatch loop");
+        }
     }
 
     /* Clean up */
@@ -297,18 +363,39 @@ void *twin_linux_input_create(twin_screen_t *screen)
     tm->x = screen->width / 2;
     tm->y = screen->height / 2;
 
+    /* Drain queued events from the dispatch loop */
+    tm->wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (tm->wake_fd < 0) {
+        log_error("Failed to create input eventfd");
+        goto bail;
+    }
+    tm->wake_file =
+        twin_set_file(twin_linux_input_drain, tm->wake_fd, TWIN_READ, tm);
+    if (!tm->wake_file)
+        goto bail_wake_fd;
+
     /* Start event handling thread */
     if (pthread_create(&tm->evdev_thread, NULL, twin_linux_evdev_thread, tm)) {
         log_error("Failed to create evdev thread");
-        return NULL;
+        goto bail_wake_file;
     }
 
     return tm;
+
+bail_wake_file:
+    twin_clear_file(tm->wake_file);
+bail_wake_fd:
+    close(tm->wake_fd);
+bail:
+    free(tm);
+    return NULL;
 }
 
 void twin_linux_input_destroy(void *_tm)
 {
     twin_linux_input_t *tm = _tm;
+    twin_clear_file(tm->wake_file);
+    close(tm->wake_fd);
     close(tm->fd);
     free(tm);
 }
@@ -16,13 +16,16 @@ typedef struct {
     int *pixels;
     SDL_Renderer *render;
     SDL_Texture *texture;
-    twin_coord_t width, height;
-    int image_y;
+    twin_rect_t update; /* rectangle being drawn by twin_screen_update */
+    bool updated;       /* texture changed since the last present */
 } twin_sdl_t;
 
 #define SCREEN(x) ((twin_context_t *) x)->screen
 #define PRIV(x) ((twin_sdl_t *) ((twin_context_t *) x)->priv)
 
+/* Milliseconds between two input polls while the dispatch loop is idle */
+#define SDL_POLL_INTERVAL 8
+
 static void _twin_sdl_put_begin(twin_coord_t left,
                                 twin_coord_t top,
                                 twin_coord_t right,
@@ -30,9 +33,10 @@ static void _twin_sdl_put_begin(twin_coord_t left,
                                 void *closure)
 {
     twin_sdl_t *tx = PRIV(closure);
-    tx->width = right - left;
-    tx->height = bottom - top;
-    tx->image_y = top;
+    tx->update.left = left;
+    tx->update.top = top;
+    tx->update.right = right;
+    tx->update.bottom = bottom;
 }
 
 static void _twin_sdl_put_span(twin_coord_t left,
@@ -48,11 +52,18 @@ static void _twin_sdl_put_span(twin_coord_t left,
         twin_argb32_t pixel = *pixels++;
         tx->pixels[iy * screen->width + ix] = pixel;
     }
-    if ((top + 1 - tx->image_y) == tx->height) {
-        SDL_UpdateTexture(tx->texture, NULL, tx->pixels,
+    /* Upload each damaged rectangle once its last row is drawn */
+    if (top + 1 == tx->update.bottom) {
+        SDL_Rect rect = {
+            .x = tx->update.left,
+            .y = tx->update.top,
+            .w = tx->update.right - tx->update.left,
+            .h = tx->update.bottom - tx->update.top,
+        };
+        SDL_UpdateTexture(tx->texture, &rect,
+                          tx->pixels + rect.y * screen->width + rect.x,
                           screen->width * sizeof(*pixels));
-        SDL_RenderCopy(tx->render, tx->texture, NULL, NULL);
-        SDL_RenderPresent(tx->render);
+        tx->updated = true;
     }
 }
 
@@ -72,12 +83,24 @@ static void twin_sdl_damage(twin_screen_t *screen, twin_sdl_t *tx)
     twin_screen_damage(screen, 0, 0, width, height);
 }
 
+static twin_time_t twin_sdl_tick(twin_time_t now maybe_unused,
+                                 void *closure maybe_unused)
+{
+    return SDL_POLL_INTERVAL;
+}
+
 static bool twin_sdl_work(void *closure)
 {
     twin_screen_t *screen = SCREEN(closure);
+    twin_sdl_t *tx = PRIV(closure);
 
     if (twin_screen_damaged(screen))
         twin_screen_update(screen);
+    if (tx->updated) {
+        SDL_RenderCopy(tx->render, tx->texture, NULL, NULL);
+        SDL_RenderPresent(tx->render);
+        tx->updated = false;
+    }
     return true;
 }
 
@@ -126,6 +149,8 @@ twin_context_t *twin_sdl_init(int width, int height)
                                      _twin_sdl_put_span, ctx);
 
     twin_set_work(twin_sdl_work, TWIN_WORK_REDISPLAY, ctx);
+    /* SDL offers no descriptor to watch; wake the loop to poll for input */
+    twin_set_timeout(twin_sdl_tick, SDL_POLL_INTERVAL, NULL);
 
     return ctx;
 
@@ -33,6 +33,7 @@ typedef struct {
     twin_screen_t *screen;
     struct aml *aml;
     struct aml_handler *aml_handler;
+    twin_file_t *aml_file;
     struct nvnc *server;
     struct nvnc_display *display;
     struct nvnc_fb *current_fb;
@@ -56,12 +57,9 @@ static void _twin_vnc_put_begin(twin_coord_t left,
                                 twin_coord_t bottom,
                                 void *closure)
 {
-    (void) left;
-    (void) top;
-    (void) right;
-    (void) bottom;
     twin_vnc_t *tx = PRIV(closure);
-    pixman_region_init_rect(&tx->damage_region, 0, 0, tx->width, tx->height);
+    pixman_region_union_rect(&tx->damage_region, &tx->damage_region, left, top,
+                             right - left, bottom - top);
 }
 
 static void _twin_vnc_put_span(twin_coord_t left,
@@ -75,8 +73,6 @@ static void _twin_vnc_put_span(twin_coord_t left,
     size_t span_width = right - left;
 
     memcpy(fb_pixels, pixels, span_width * sizeof(*fb_pixels));
-    pixman_region_union_rect(&tx->damage_region, &tx->damage_region, left, top,
-                             span_width, 1);
 }
 
 static void twin_vnc_get_screen_size(twin_vnc_t *tx, int *width, int *height)
@@ -237,9 +233,14 @@ twin_context_t *twin_vnc_init(int width, int height)
         goto bail_framebuffer;
     }
 
+    pixman_region_init(&tx->damage_region);
     twin_set_work(_twin_vnc_work, TWIN_WORK_REDISPLAY, ctx);
     tx->screen = ctx->screen;
 
+    /* Sleep in the dispatch loop until aml has client traffic to handle */
+    tx->aml_file =
+        twin_set_file(_twin_vnc_aml_ready, aml_get_fd(tx->aml), TWIN_READ, tx);
+
     return ctx;
 
 bail_framebuffer:
@@ -258,14 +259,23 @@ bail_priv:
     return NULL;
 }
 
-static bool twin_vnc_poll(twin_context_t *ctx)
+static bool _twin_vnc_aml_ready(int file maybe_unused,
+                                twin_file_op_t ops maybe_unused,
+                                void *closure)
 {
-    twin_vnc_t *tx = PRIV(ctx);
+    twin_vnc_t *tx = closure;
     aml_poll(tx->aml, 0);
     aml_dispatch(tx->aml);
     return true;
 }
 
+static bool twin_vnc_poll(twin_context_t *ctx)
+{
+    /* Flush whatever the work queue handed to aml in this iteration */
+    _twin_vnc_aml_ready(-1, 0, PRIV(ctx));
+    return true;
+}
+
 static void twin_vnc_configure(twin_context_t *ctx)
 {
     int width, height;
@@ -280,6 +290,8 @@ static void twin_vnc_exit(twin_context_t *ctx)
         return;
 
     twin_vnc_t *tx = PRIV(ctx);
+    if (tx->aml_file)
+        twin_clear_file(tx->aml_file);
     nvnc_fb_unref(tx->current_fb);
     nvnc_display_unref(tx->display);
     nvnc_close(tx->server);
@@ -0,0 +1,34 @@
+#define CONFIG_CONFIGURED 1
+#define CONFIG_BACKEND_HEADLESS 1
+#define CONFIG_RENDERER_BUILTIN 1
+#define CONFIG_LOGGING 1
+#define CONFIG_LOGGING_COLOR 1
+#define CONFIG_LOGGING_CALLBACK 1
+#define CONFIG_SIMD 1
+#define CONFIG_CURSOR 1
+#define CONFIG_DROP_SHADOW 1
+#define CONFIG_HORIZONTAL_OFFSET 1
+#define CONFIG_VERTICAL_OFFSET 1
+#define CONFIG_SHADOW_BLUR 10
+#define CONFIG_GLYPH_CACHE 1
+#define CONFIG_GLYPH_CACHE_SIZE 256
+#define CONFIG_GLYPH_ATLAS 1
+#define CONFIG_GLYPH_ATLAS_SIZE 512
+#define CONFIG_FONT_FILE 1
+#define CONFIG_RASTER_ANALYTIC 1
+#define CONFIG_STROKE_OFFSET 1
+#define CONFIG_PROFILE 1
+#define CONFIG_PROFILE_FRAMES 128
+#define CONFIG_LOADER_PNG 1
+#define CONFIG_LOADER_JPEG 1
+#define CONFIG_LOADER_GIF 1
+#define CONFIG_LOADER_TVG 1
+#define CONFIG_DEMO_APPLICATIONS 1
+#define CONFIG_DEMO_MULTI 1
+#define CONFIG_DEMO_HELLO 1
+#define CONFIG_DEMO_CALCULATOR 1
+#define CONFIG_DEMO_LINE 1
+#define CONFIG_DEMO_SPLINE 1
+#define CONFIG_DEMO_IMAGE 1
+#define CONFIG_TOOLS 1
+#define CONFIG_TOOL_BENCH 1
@@ -55,6 +55,20 @@ typedef struct _twin_rect {
     twin_coord_t left, right, top, bottom;
 } twin_rect_t;
 
+/*
+ * A region: a bounded set of disjoint rectangles
+ *
+ * Rectangles are merged once they overlap, once merging wastes little area,
+ * or once the set is full, so a region never holds more than
+ * TWIN_REGION_MAX_RECTS entries.
+ */
+#define TWIN_REGION_MAX_RECTS 8
+
+typedef struct _twin_region {
+    int n_rects;
+    twin_rect_t rects[TWIN_REGION_MAX_RECTS];
+} twin_region_t;
+
 /*
  * Place matrices in structures so they can be easily copied
  */
@@ -191,6 +205,13 @@ typedef struct _twin_pixmap {
     twin_coord_t origin_x;
     twin_coord_t origin_y;
 
+    /*
+     * Opacity hint - a single rectangle in pixmap coordinates whose
+     * pixels are all fully opaque. The screen skips whatever lies
+     * underneath it. Empty when nothing is known to be opaque.
+     */
+    twin_rect_t opaque;
+
     /*
      * Pixels
      */
@@ -199,7 +220,8 @@ typedef struct _twin_pixmap {
 #if defined(CONFIG_DROP_SHADOW)
     /*
      * When the pixel map is within the active window, it will have a drop
-     * shadow to enhance its visual distinction.
+     * shadow to enhance its visual distinction. The shadow is composed from
+     * the window's shadow asset; the pixels of the pixmap stay transparent.
      */
     bool shadow;
 #endif
@@ -213,7 +235,8 @@ typedef struct _twin_pixmap {
 } twin_pixmap_t;
 
 /*
- * twin_put_begin_t: called before data are drawn to the screen
+ * twin_put_begin_t: called before each damaged rectangle is drawn to the
+ *                   screen; a single update may call it several times
  * twin_put_span_t: called for each scanline drawn
  */
 typedef void (*twin_put_begin_t)(twin_coord_t left,
@@ -269,7 +292,7 @@ struct _twin_screen {
     /*
      * Damage
      */
-    twin_rect_t damage;
+    twin_region_t damage;
     void (*damaged)(void *);
     void *damaged_closure;
     twin_count_t disable;
@@ -290,6 +313,20 @@ struct _twin_screen {
      * Event filter
      */
     bool (*event_filter)(twin_screen_t *screen, twin_event_t *event);
+
+#if defined(CONFIG_SCREEN_THREADS)
+    /*
+     * Worker pool composing damaged bands in parallel
+     */
+    struct _twin_screen_threads *threads;
+#endif
+
+#if defined(CONFIG_PROFILE)
+    /*
+     * Recent frame statistics
+     */
+    struct _twin_screen_profile *profile;
+#endif
 };
 
 /*
@@ -344,11 +381,19 @@ typedef enum _twin_cap {
     TwinCapProjecting,
 } twin_cap_t;
 
+typedef enum _twin_join {
+    TwinJoinRound,
+    TwinJoinMiter,
+    TwinJoinBevel,
+} twin_join_t;
+
 typedef struct _twin_state {
     twin_matrix_t matrix;
     twin_fixed_t font_size;
     twin_style_t font_style;
     twin_cap_t cap_style;
+    twin_join_t join_style;
+    twin_fixed_t tolerance; /* in device pixels */
 } twin_state_t;
 
 /*
@@ -364,6 +409,8 @@ typedef struct _twin_text_metrics {
     twin_fixed_t font_descent;
 } twin_text_metrics_t;
 
+typedef struct _twin_text_run twin_text_run_t;
+
 
 /*
  * Fonts
@@ -386,6 +433,8 @@ typedef struct _twin_charmap {
     unsigned int offsets[UCS_PER_PAGE];
 } twin_charmap_t;
 
+typedef struct _twin_page_index twin_page_index_t;
+
 #define TWIN_FONT_TYPE_STROKE 1
 #define TWIN_FONT_TYPE_TTF 2
 
@@ -401,8 +450,8 @@ typedef struct _twin_font {
     signed char descender;
     signed char height;
 
-    /* those are used at runtime for caching */
-    const twin_charmap_t *cur_page;
+    /* built at runtime on first use */
+    const twin_page_index_t *page_index;
 
 } twin_font_t;
 
@@ -437,6 +486,8 @@ struct _twin_window {
     /* Set the shadow range for horizontal and vertical directions. */
     twin_coord_t shadow_x;
     twin_coord_t shadow_y;
+    /* Nine-slice shadow laid under the pixmap by the compositor */
+    twin_pixmap_t *shadow;
 #endif
 
     twin_window_style_t style;
@@ -448,6 +499,7 @@ struct _twin_window {
     bool draw_queued;
     void *client_data;
     char *name;
+    twin_pixmap_t *frame[2]; /* rendered title bar, inactive and active */
 
     twin_draw_func_t draw;
     twin_event_func_t event;
@@ -478,6 +530,20 @@ typedef bool (*twin_work_proc_t)(void *closure);
 typedef struct _twin_timeout twin_timeout_t;
 typedef struct _twin_work twin_work_t;
 
+/*
+ * File procs are called when a watched file descriptor becomes ready and
+ * return true to keep watching it
+ */
+typedef enum {
+    TWIN_READ = 1,
+    TWIN_WRITE = 2,
+    TWIN_ERROR = 4,
+} twin_file_op_t;
+
+typedef bool (*twin_file_proc_t)(int file, twin_file_op_t ops, void *closure);
+
+typedef struct _twin_file twin_file_t;
+
 /*
  * Widgets
  */
@@ -526,11 +592,16 @@ struct _twin_widget {
     twin_widget_t *copy_geom;
     bool paint;
     bool layout;
+    bool configure; /* extents or children need placing again */
     bool want_focus;
     twin_argb32_t background;
     twin_widget_layout_t preferred;
     twin_shape_t shape;
     twin_fixed_t radius;
+    bool retained;          /* see twin_widget_set_retained() */
+    bool dirty;             /* own content changed since the last paint */
+    twin_pixmap_t *cache;   /* retained rendering */
+    twin_argb32_t cache_bg; /* parent background under a non-rectangle */
 };
 
 struct _twin_box {
@@ -554,6 +625,7 @@ typedef enum _twin_align {
 typedef struct _twin_label {
     twin_widget_t widget;
     char *label;
+    twin_text_run_t *run;
     twin_argb32_t foreground;
     twin_fixed_t font_size;
     twin_style_t font_style;
@@ -694,6 +766,22 @@ void twin_cover(twin_pixmap_t *dst,
 
 void twin_event_enqueue(const twin_event_t *event);
 
+/*
+ * file.c
+ */
+
+twin_file_t *twin_set_file(twin_file_proc_t file_proc,
+                           int file,
+                           twin_file_op_t ops,
+                           void *closure);
+
+void twin_clear_file(twin_file_t *file);
+
+/*
+ * Wake twin_dispatch() from its wait; may be called from any thread
+ */
+void twin_wakeup(void);
+
 /*
  * fixed.c
  */
@@ -728,6 +816,48 @@ void twin_text_metrics_utf8(twin_path_t *path,
                             const char *string,
                             twin_text_metrics_t *m);
 
+/*
+ * Paint a string in a solid color from the current point of path, with its
+ * font and matrix, and advance the current point past it. Unlike
+ * twin_path_utf8(), no outline is added to path.
+ */
+void twin_paint_utf8(twin_pixmap_t *dst,
+                     twin_argb32_t argb,
+                     twin_path_t *path,
+                     const char *string);
+
+#if defined(CONFIG_GLYPH_CACHE)
+/*
+ * glyph-cache.c
+ */
+
+typedef struct _twin_glyph_cache_stats {
+    uint64_t hits, misses;
+    uint64_t evictions; /* glyphs dropped to stay within the budget */
+    uint32_t entries, bytes;
+} twin_glyph_cache_stats_t;
+
+void twin_glyph_cache_stats(twin_glyph_cache_stats_t *stats);
+
+/* Drop every cached glyph, e.g. after changing a font in place */
+void twin_glyph_cache_flush(void);
+#endif
+
+#if defined(CONFIG_FONT_FILE)
+/*
+ * font-file.c
+ */
+
+/*
+ * Map a font file written by tools/ttf. The font is used in place, so only
+ * the glyphs actually drawn are ever paged in.
+ */
+twin_font_t *twin_font_load(const char *file);
+
+/* Release a loaded font, which must no longer be g_twin_font */
+void twin_font_unload(twin_font_t *font);
+#endif
+
 /*
  * hull.c
  */
@@ -924,6 +1054,20 @@ void twin_path_set_cap_style(twin_path_t *path, twin_cap_t cap_style);
 
 twin_cap_t twin_path_current_cap_style(twin_path_t *path);
 
+/* Joins are only drawn by TWIN_STROKE_OFFSET; convolution is always round */
+void twin_path_set_join_style(twin_path_t *path, twin_join_t join_style);
+
+twin_join_t twin_path_current_join_style(twin_path_t *path);
+
+/*
+ * How far, in device pixels, flattened curves, arcs and round joins may stray
+ * from the true shape; a quarter pixel unless set. Coarser paths get fewer
+ * points.
+ */
+void twin_path_set_tolerance(twin_path_t *path, twin_fixed_t tolerance);
+
+twin_fixed_t twin_path_current_tolerance(twin_path_t *path);
+
 twin_state_t twin_path_save(twin_path_t *path);
 
 void twin_path_restore(twin_path_t *path, twin_state_t *state);
@@ -936,6 +1080,21 @@ void twin_composite_path(twin_pixmap_t *dst,
                          twin_operator_t operator);
 void twin_paint_path(twin_pixmap_t *dst, twin_argb32_t argb, twin_path_t *path);
 
+/*
+ * Strokes are outlined either by convolving the path with a pen polygon or,
+ * when built with CONFIG_STROKE_OFFSET, by offsetting each segment and
+ * joining the offsets.
+ */
+typedef enum {
+    TWIN_STROKE_CONVOLVE,
+    TWIN_STROKE_OFFSET,
+} twin_stroker_t;
+
+/* Pick the stroker; false if it was not built in */
+bool twin_set_stroker(twin_stroker_t kind);
+
+twin_stroker_t twin_get_stroker(void);
+
 void twin_composite_stroke(twin_pixmap_t *dst,
                            twin_operand_t *src,
                            twin_coord_t src_x,
@@ -1021,6 +1180,12 @@ void twin_pixmap_damage(twin_pixmap_t *pixmap,
                         twin_coord_t right,
                         twin_coord_t bottom);
 
+void twin_pixmap_set_opaque(twin_pixmap_t *pixmap,
+                            twin_coord_t left,
+                            twin_coord_t top,
+                            twin_coord_t right,
+                            twin_coord_t bottom);
+
 void twin_pixmap_lock(twin_pixmap_t *pixmap);
 
 void twin_pixmap_unlock(twin_pixmap_t *pixmap);
@@ -1041,11 +1206,78 @@ bool twin_pixmap_dispatch(twin_pixmap_t *pixmap, twin_event_t *event);
  * poly.c
  */
 
+/*
+ * Filled paths are rasterized either by sampling a 4x4 grid in each pixel or,
+ * when built with CONFIG_RASTER_ANALYTIC, by computing the exact area covered.
+ */
+typedef enum {
+    TWIN_RASTER_SAMPLED,
+    TWIN_RASTER_ANALYTIC,
+} twin_rasterizer_t;
+
+/* Pick the rasterizer; false if it was not built in */
+bool twin_set_rasterizer(twin_rasterizer_t kind);
+
+twin_rasterizer_t twin_get_rasterizer(void);
+
 void twin_fill_path(twin_pixmap_t *pixmap,
                     twin_path_t *path,
                     twin_coord_t dx,
                     twin_coord_t dy);
 
+#if defined(CONFIG_PROFILE)
+/*
+ * profile.c
+ */
+
+typedef enum {
+    TWIN_PROFILE_TIMEOUT,  /* timeout dispatch */
+    TWIN_PROFILE_WORK,     /* work queue, minus the stages nested in it */
+    TWIN_PROFILE_DRAW,     /* window repaint */
+    TWIN_PROFILE_COMPOSE,  /* scanline compose, minus put_span */
+    TWIN_PROFILE_PUT_SPAN, /* backend put_span */
+    TWIN_PROFILE_STAGES,
+} twin_profile_stage_t;
+
+typedef enum {
+    TWIN_PROFILE_PIXELS, /* pixels composited onto the screen */
+    TWIN_PROFILE_SPANS,  /* spans passed to put_span */
+    TWIN_PROFILE_EDGES,  /* polygon edges rasterized */
+    TWIN_PROFILE_GLYPHS, /* glyphs rendered */
+    TWIN_PROFILE_COUNTERS,
+} twin_profile_counter_t;
+
+/*
+ * A frame ends with the outermost stage that updated the screen. Times are in
+ * nanoseconds of CLOCK_MONOTONIC; each stage counts only its own time, not
+ * that of the stages nested in it.
+ */
+typedef struct _twin_frame_stats {
+    uint32_t frame;
+    uint64_t start, end; /* end of the previous frame, end of this one */
+    uint64_t stage[TWIN_PROFILE_STAGES];
+    uint64_t counter[TWIN_PROFILE_COUNTERS];
+} twin_frame_stats_t;
+
+const char *twin_profile_stage_name(twin_profile_stage_t stage);
+
+const char *twin_profile_counter_name(twin_profile_counter_t counter);
+
+/*
+ * Fetch the statistics of a recent frame; age 0 is the last complete frame.
+ * Return false if that frame is no longer, or not yet, recorded.
+ */
+bool twin_screen_frame_stats(twin_screen_t *screen,
+                             int age,
+                             twin_frame_stats_t *stats);
+
+/*
+ * Write the recorded stages and the per-frame counters as Chrome trace-event
+ * JSON, which chrome://tracing and Perfetto can load.
+ */
+bool twin_screen_write_trace(twin_screen_t *screen, const char *path);
+#endif
+
 /*
  * screen.c
  */
@@ -1118,6 +1350,43 @@ void twin_path_quadratic_curve(twin_path_t *path,
                                twin_fixed_t x2,
                                twin_fixed_t y2);
 
+#if defined(CONFIG_STROKE_OFFSET)
+/*
+ * stroke.c
+ */
+
+/*
+ * Append the outline of stroke drawn with a round pen pen_width across, using
+ * the matrix, cap style and join style of stroke
+ */
+void twin_path_stroke(twin_path_t *path,
+                      twin_path_t *stroke,
+                      twin_fixed_t pen_width);
+#endif
+
+/*
+ * text-run.c
+ */
+
+twin_text_run_t *twin_text_run_create(const char *string,
+                                      twin_fixed_t font_size,
+                                      twin_style_t font_style);
+
+void twin_text_run_destroy(twin_text_run_t *run);
+
+bool twin_text_run_set(twin_text_run_t *run,
+                       const char *string,
+                       twin_fixed_t font_size,
+                       twin_style_t font_style);
+
+void twin_text_run_metrics(twin_text_run_t *run, twin_text_metrics_t *m);
+
+void twin_text_run_paint(twin_pixmap_t *dst,
+                         twin_argb32_t argb,
+                         twin_text_run_t *run,
+                         twin_fixed_t x,
+                         twin_fixed_t y);
+
 /*
  * timeout.c
  */
@@ -1175,6 +1444,13 @@ twin_widget_t *twin_widget_create(twin_box_t *parent,
 
 void twin_widget_set(twin_widget_t *widget, twin_argb32_t background);
 
+/*
+ * Keep what the widget paints in an offscreen pixmap, so that repainting it
+ * while its own content is unchanged is a single composite. Meant for widgets
+ * that paint their whole extent themselves, such as labels and buttons.
+ */
+void twin_widget_set_retained(twin_widget_t *widget, bool retained);
+
 /*
  * window.c
  */
@@ -1252,4 +1528,14 @@ twin_context_t *twin_create(int width, int height);
 
 void twin_destroy(twin_context_t *ctx);
 
+#if defined(CONFIG_BACKEND_HEADLESS)
+/*
+ * backend/headless.c
+ */
+
+twin_argb32_t *twin_headless_framebuffer(twin_context_t *ctx);
+
+bool twin_headless_dump(twin_context_t *ctx, const char *path);
+#endif
+
 #endif /* _TWIN_H_ */
@@ -181,13 +181,6 @@ typedef int64_t twin_xfixed_t;
     (((t) = twin_get_8(d, i) + twin_get_8(s, i)), (twin_argb32_t) twin_sat(t) \
                                                       << (i))
 
-#define _twin_add_ARGB(s, d, i, t) (((t) = (s) + twin_get_8(d, i)))
-#define _twin_add(s, d, t) (((t) = (s) + (d)))
-#define _twin_div(d, den, i, t)                     \
-    (((t) = (d) / (den)), (t) = twin_get_8((t), 0), \
-     (twin_argb32_t) twin_sat(t) << (i))
-#define _twin_sub_ARGB(s, d, i, t) (((t) = (s) - twin_get_8(d, i)))
-#define _twin_sub(s, d, t) (((t) = (s) - (d)))
 #define twin_put_8(d, i, t) (((t) = (d) << (i)))
 
 #define twin_argb32_to_rgb16(s) \
@@ -269,8 +262,17 @@ struct _twin_path {
     int size_sublen;
     int nsublen;
     twin_state_t state;
+    bool scratch; /* points and sublen live in the scratch arena */
 };
 
+/* Flattening tolerance of path, never finer than one sfixed unit */
+static inline twin_sfixed_t _twin_path_tolerance(const twin_path_t *path)
+{
+    twin_sfixed_t tolerance = twin_fixed_to_sfixed(path->state.tolerance);
+
+    return tolerance > 0 ? tolerance : 1;
+}
+
 typedef struct _twin_gpoint {
     twin_gfixed_t x, y;
 } twin_gpoint_t;
@@ -403,8 +405,29 @@ twin_op_func _twin_rgb16_source_a8;
 twin_op_func _twin_a8_source_a8;
 twin_op_func _twin_c_source_a8;
 
+/*
+ * SIMD versions of the hottest primitives, dispatched at runtime to the best
+ * kernel for the CPU; the scalar functions above are the reference.
+ */
 twin_op_func _twin_vec_argb32_over_argb32;
 twin_op_func _twin_vec_argb32_source_argb32;
+twin_op_func _twin_vec_rgb16_source_argb32;
+twin_in_op_func _twin_vec_c_in_a8_over_argb32;
+
+/*
+ * Route the _twin_vec_* entry points to one kernel set: "scalar", "sse2",
+ * "avx2" or "neon", or NULL for the best one the CPU supports. Returns false
+ * when that set is not built in or not supported.
+ */
+bool _twin_vec_select(const char *isa);
+
+/*
+ * Span operator compositing src through an A8 mask row onto dst, or NULL when
+ * the renderer cannot composite that source a row at a time
+ */
+twin_src_msk_op _twin_composite_span_op(twin_pixmap_t *dst,
+                                        twin_operand_t *src,
+                                        twin_operator_t operator);
 
 twin_argb32_t *_twin_fetch_rgb16(twin_pixmap_t *pixmap,
                                  int x,
@@ -425,6 +448,99 @@ twin_dfixed_t _twin_distance_to_line_squared(twin_spoint_t *p,
                                              twin_spoint_t *p1,
                                              twin_spoint_t *p2);
 
+/*
+ * Screen stuff
+ */
+void _twin_screen_compose_span(twin_screen_t *screen,
+                               twin_argb32_t *span,
+                               twin_coord_t y,
+                               twin_coord_t left,
+                               twin_coord_t right);
+
+#if defined(CONFIG_SCREEN_THREADS)
+/*
+ * Compose and emit the scanlines of a damaged rectangle on the worker pool.
+ * Return false when the pool is unavailable or the rectangle is too small to
+ * be worth splitting, in which case the caller composes it serially.
+ */
+bool _twin_screen_threads_update(twin_screen_t *screen,
+                                 twin_coord_t left,
+                                 twin_coord_t top,
+                                 twin_coord_t right,
+                                 twin_coord_t bottom);
+
+void _twin_screen_threads_destroy(twin_screen_t *screen);
+#endif
+
+/*
+ * Scratch arena
+ *
+ * Bump allocator for objects that live no longer than one paint. Callers take
+ * a mark, allocate freely and release the mark, in LIFO order; nothing is
+ * freed individually. Releasing the outermost mark trims the arena to what
+ * that paint needed. Every thread has its own arena.
+ */
+typedef struct _twin_arena_chunk twin_arena_chunk_t;
+
+typedef struct _twin_arena_mark {
+    twin_arena_chunk_t *chunk;
+    size_t used;
+} twin_arena_mark_t;
+
+twin_arena_mark_t _twin_arena_mark(void);
+
+void _twin_arena_release(twin_arena_mark_t mark);
+
+void *_twin_arena_alloc(size_t size);
+
+/*
+ * Profiling stuff
+ *
+ * Stages nest; begin and end must pair up on the thread running the dispatch
+ * loop. _twin_profile_frame() ends the frame of the given screen once the
+ * outermost stage is over.
+ */
+#if defined(CONFIG_PROFILE)
+void _twin_profile_begin(twin_profile_stage_t stage);
+
+void _twin_profile_end(twin_profile_stage_t stage);
+
+void _twin_profile_count(twin_profile_counter_t counter, uint64_t n);
+
+void _twin_profile_frame(twin_screen_t *screen);
+
+void _twin_profile_destroy(twin_screen_t *screen);
+#else
+#define _twin_profile_begin(stage) \
+    do {                           \
+    } while (0)
+#define _twin_profile_end(stage) \
+    do {                         \
+    } while (0)
+#define _twin_profile_count(counter, n) \
+    do {                                \
+    } while (0)
+#define _twin_profile_frame(screen) \
+    do {                            \
+    } while (0)
+#define _twin_profile_destroy(screen) \
+    do {                              \
+    } while (0)
+#endif
+
+/*
+ * Region stuff
+ */
+void _twin_region_clear(twin_region_t *region);
+
+bool _twin_region_is_empty(const twin_region_t *region);
+
+void _twin_region_union_rect(twin_region_t *region,
+                             twin_coord_t left,
+                             twin_coord_t top,
+                             twin_coord_t right,
+                             twin_coord_t bottom);
+
 /*
  * Polygon stuff
  */
@@ -486,6 +602,65 @@ void _twin_path_scurve(twin_path_t *path,
 
 void _twin_path_sfinish(twin_path_t *path);
 
+/*
+ * Set up an empty path whose storage comes from the scratch arena. It must be
+ * done growing before any mark taken after it is released, so paths that are
+ * appended to by callees holding marks of their own cannot be scratch.
+ */
+void _twin_path_init_scratch(twin_path_t *path);
+
+/*
+ * An empty path kept in *path from call to call, for outlines that cannot be
+ * scratch; NULL when out of memory. Trimming frees it once it has grown too
+ * large to be worth keeping.
+ */
+twin_path_t *_twin_path_reuse(twin_path_t **path);
+
+void _twin_path_trim(twin_path_t **path);
+
+/*
+ * Convex hull of path, appended to hull. Its working storage comes from the
+ * scratch arena under the caller's mark, so hull may be a scratch path.
+ */
+void _twin_path_convex_hull(twin_path_t *hull, twin_path_t *path);
+
+#if defined(CONFIG_STROKE_OFFSET)
+/* How many pixels twin_path_stroke may reach beyond the points of stroke */
+twin_coord_t _twin_path_stroke_reach(twin_path_t *stroke,
+                                     twin_fixed_t pen_width);
+#endif
+
+/*
+ * Where the rasterizers put coverage. Rows inside clip are visited top to
+ * bottom; begin returns the A8 cells of row y, indexed by column, which the
+ * rasterizer saturating-adds into, and end, when not NULL, is told which
+ * columns of the row were touched once it is complete.
+ */
+typedef struct _twin_span_sink twin_span_sink_t;
+
+struct _twin_span_sink {
+    twin_rect_t clip;
+    twin_a8_t *(*begin)(twin_span_sink_t *sink, twin_coord_t y);
+    void (*end)(twin_span_sink_t *sink,
+                twin_coord_t y,
+                twin_coord_t left,
+                twin_coord_t right);
+};
+
+/* Rasterize path, offset by (dx, dy), into sink with the current rasterizer */
+void _twin_fill_path_sink(twin_span_sink_t *sink,
+                          twin_path_t *path,
+                          twin_sfixed_t dx,
+                          twin_sfixed_t dy);
+
+#if defined(CONFIG_RASTER_ANALYTIC)
+/* Rasterize path, offset by (dx, dy), into sink by exact area coverage */
+void _twin_fill_path_analytic(twin_span_sink_t *sink,
+                              twin_path_t *path,
+                              twin_sfixed_t dx,
+                              twin_sfixed_t dy);
+#endif
+
 /*
  * Glyph stuff.  Coordinates are stored in 2.6 fixed point format
  */
@@ -505,6 +680,104 @@ void _twin_path_sfinish(twin_path_t *path);
 #define twin_glyph_snap_x(g) (&g[6])
 #define twin_glyph_snap_y(g) (twin_glyph_snap_x(g) + twin_glyph_n_snap_x(g))
 
+/* Bumped by twin_font_unload(), as the address of a font may be reused */
+extern unsigned int _twin_font_generation;
+
+/*
+ * Glyph cache stuff
+ *
+ * A glyph outline depends on the origin only through its subpixel part, so
+ * outlines are cached as rendered at that offset and translated by whole
+ * pixels when drawn. The cached path starts with the point that replaces the
+ * current one and ends with the origin of the next glyph.
+ */
+typedef struct _twin_glyph_key {
+    const twin_font_t *font;
+    twin_ucs4_t ucs4;
+    twin_fixed_t font_size;
+    twin_style_t font_style;
+    twin_cap_t cap_style;      /* stroke fonts are convolved with it */
+    twin_fixed_t tolerance;    /* curves are flattened to it */
+    twin_fixed_t matrix[2][2]; /* linear part of the path matrix */
+    twin_sfixed_t x, y;        /* subpixel part of the origin */
+} twin_glyph_key_t;
+
+/* Describe the glyph for ucs4 drawn with the state of path at origin */
+void _twin_glyph_key_init(twin_glyph_key_t *key,
+                          const twin_path_t *path,
+                          twin_ucs4_t ucs4,
+                          twin_spoint_t origin);
+
+uint32_t _twin_glyph_key_hash(const twin_glyph_key_t *key);
+
+bool _twin_glyph_key_equal(const twin_glyph_key_t *a,
+                           const twin_glyph_key_t *b);
+
+#if defined(CONFIG_GLYPH_CACHE)
+/*
+ * The cache is shared by every thread. Lookups and stores must hold its lock,
+ * and a path returned by a lookup is only valid until the lock is dropped.
+ */
+void _twin_glyph_cache_lock(void);
+
+void _twin_glyph_cache_unlock(void);
+
+const twin_path_t *_twin_glyph_cache_find(const twin_glyph_key_t *key);
+
+void _twin_glyph_cache_store(const twin_glyph_key_t *key,
+                             const twin_path_t *glyph);
+#endif
+
+/*
+ * Glyph atlas stuff
+ *
+ * Coverage masks of untransformed glyphs, rasterized at the subpixel origin of
+ * their key. The atlas is shared by every thread: lookups must hold its lock,
+ * and an entry stays valid until the next lookup or until the lock is dropped.
+ */
+#if defined(CONFIG_GLYPH_ATLAS)
+typedef struct _twin_atlas_glyph {
+    twin_coord_t x, y; /* mask position in the atlas pixmap */
+    twin_coord_t width, height;
+    twin_coord_t left, top; /* mask offset from the whole-pixel origin */
+    twin_sfixed_t advance_x, advance_y;
+} twin_atlas_glyph_t;
+
+void _twin_glyph_atlas_lock(void);
+
+void _twin_glyph_atlas_unlock(void);
+
+const twin_atlas_glyph_t *_twin_glyph_atlas_find(const twin_glyph_key_t *key,
+                                                 const twin_state_t *state);
+
+twin_pixmap_t *_twin_glyph_atlas_pixmap(void);
+
+/* Drop every glyph, as their keys may name a font that goes away */
+void _twin_glyph_atlas_flush(void);
+#endif
+
+/*
+ * Font file stuff
+ *
+ * Font files written by tools/ttf are mapped and used in place: the charmap
+ * and the outlines are laid out exactly as twin_font_t expects them. Fields
+ * are in host byte order and sections start at four-byte aligned offsets.
+ */
+#define TWIN_FONT_FILE_MAGIC 0x31465754 /* "TWF1" */
+#define TWIN_FONT_FILE_VERSION 1
+
+typedef struct _twin_font_file_header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t type; /* TWIN_FONT_TYPE_* */
+    uint32_t n_charmap;
+    uint32_t charmap; /* offset of n_charmap twin_charmap_t */
+    uint32_t outlines;
+    uint32_t outlines_size;
+    uint32_t name, style; /* offsets of NUL-terminated strings */
+    int8_t ascender, descender, height, pad;
+} twin_font_file_header_t;
+
 /*
  * Dispatch stuff
  */
@@ -515,11 +788,12 @@ typedef struct _twin_queue {
 } twin_queue_t;
 
 struct _twin_timeout {
-    twin_queue_t queue;
     twin_time_t time;
     twin_time_t delay;
     twin_timeout_proc_t proc;
     void *closure;
+    int index;         /* position in the timeout heap */
+    uint32_t sequence; /* queueing order among equal times */
 };
 
 struct _twin_work {
@@ -559,6 +833,12 @@ twin_time_t _twin_timeout_delay(void);
 
 void _twin_run_work(void);
 
+bool _twin_work_queued(void);
+
+bool _twin_file_init(void);
+
+void _twin_run_file(twin_time_t delay);
+
 void _twin_box_init(twin_box_t *box,
                     twin_box_t *parent,
                     twin_window_t *window,
@@ -587,6 +867,9 @@ twin_dispatch_result_t _twin_widget_dispatch(twin_widget_t *widget,
 
 void _twin_widget_queue_paint(twin_widget_t *widget);
 
+/* Paint a child of a box, from its retained rendering when it has one */
+void _twin_widget_paint_child(twin_widget_t *widget, twin_event_t *event);
+
 void _twin_widget_queue_layout(twin_widget_t *widget);
 
 bool _twin_widget_contains(twin_widget_t *widget,
@@ -644,6 +927,13 @@ void twin_shadow_border(twin_pixmap_t *shadow,
                         twin_argb32_t color,
                         twin_coord_t shift_x,
                         twin_coord_t shift_y);
+
+/* Compose the drop shadow of an active window over scanline y of span. */
+void _twin_window_span_shadow(twin_window_t *window,
+                              twin_argb32_t *span,
+                              twin_coord_t y,
+                              twin_coord_t left,
+                              twin_coord_t right);
 #endif
 
 /* utility */
@@ -5,6 +5,7 @@
  */
 
 #include <assert.h>
+#include <stdlib.h>
 #include <twin.h>
 
 #include "twin_backend.h"
@@ -15,10 +16,18 @@ extern twin_backend_t g_twin_backend;
 
 twin_context_t *twin_create(int width, int height)
 {
+    /* Backends and their input threads may watch files and wake the loop */
+    _twin_file_init();
     return g_twin_backend.init(width, height);
 }
 
 void twin_destroy(twin_context_t *ctx)
 {
+#if defined(CONFIG_PROFILE)
+    /* Leave a Chrome trace of the session behind when asked to */
+    const char *trace = getenv("MADO_PROFILE_TRACE");
+    if (ctx && trace)
+        twin_screen_write_trace(ctx->screen, trace);
+#endif
     return g_twin_backend.exit(ctx);
 }
@@ -0,0 +1,137 @@
+/*
+ * Twin - A Tiny Window System
+ * Copyright (c) 2025 National Cheng Kung University, Taiwan
+ * All rights reserved.
+ */
+
+#include <stddef.h>
+#include <stdlib.h>
+
+#include "twin_private.h"
+
+/*
+ * Scratch arena for the transient objects of a paint: edge lists, hulls,
+ * pens, stroke outlines and transform spans. Memory is carved from a chain of
+ * chunks by bumping a pointer and handed back in bulk by rewinding to a mark.
+ * Chunks past the current one stay linked for reuse, and releasing the
+ * outermost mark folds the chain into one chunk large enough for the whole of
+ * that paint, so a steady stream of paints allocates nothing.
+ *
+ * Each thread has an arena of its own, so text and paths can be drawn from
+ * several threads at once.
+ */
+
+#define ARENA_ALIGN (sizeof(max_align_t))
+#define ARENA_CHUNK (16 * 1024)
+#define ARENA_KEEP (1024 * 1024) /* never keep more than this across paints */
+
+struct _twin_arena_chunk {
+    twin_arena_chunk_t *next;
+    size_t size;
+    size_t used;
+    max_align_t data[];
+};
+
+static _Thread_local struct {
+    twin_arena_chunk_t *head, *cur;
+    int depth; /* outstanding marks */
+} arena;
+
+static size_t _twin_arena_round(size_t size)
+{
+    return (size + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+}
+
+static twin_arena_chunk_t *_twin_arena_chunk_create(size_t size)
+{
+    twin_arena_chunk_t *chunk = malloc(sizeof(twin_arena_chunk_t) + size);
+
+    if (!chunk)
+        return NULL;
+    chunk->next = NULL;
+    chunk->size = size;
+    chunk->used = 0;
+    return chunk;
+}
+
+static void _twin_arena_chunks_destroy(twin_arena_chunk_t *chunk)
+{
+    while (chunk) {
+        twin_arena_chunk_t *next = chunk->next;
+
+        free(chunk);
+        chunk = next;
+    }
+}
+
+/* Rewind to empty, folding the chain into one chunk that holds all of it */
+static void _twin_arena_trim(void)
+{
+    twin_arena_chunk_t *chunk;
+    size_t total = 0;
+
+    if (!arena.head)
+        return;
+    arena.cur = arena.head;
+    arena.head->used = 0;
+    if (!arena.head->next && arena.head->size <= ARENA_KEEP)
+        return;
+
+    for (chunk = arena.head; chunk; chunk = chunk->next)
+        total += chunk->size;
+    _twin_arena_chunks_destroy(arena.head);
+    arena.head = arena.cur =
+        total <= ARENA_KEEP ? _twin_arena_chunk_create(total) : NULL;
+}
+
+twin_arena_mark_t _twin_arena_mark(void)
+{
+    twin_arena_mark_t mark = {arena.cur, arena.cur ? arena.cur->used : 0};
+
+    arena.depth++;
+    return mark;
+}
+
+void _twin_arena_release(twin_arena_mark_t mark)
+{
+    if (!--arena.depth) {
+        _twin_arena_trim();
+        return;
+    }
+    if (mark.chunk) {
+        arena.cur = mark.chunk;
+        arena.cur->used = mark.used;
+    } else if (arena.head) {
+        arena.cur = arena.head;
+        arena.cur->used = 0;
+    }
+}
+
+void *_twin_arena_alloc(size_t size)
+{
+    twin_arena_chunk_t *chunk = arena.cur;
+    void *p;
+
+    size = _twin_arena_round(size);
+    if (!chunk || chunk->used + size > chunk->size) {
+        twin_arena_chunk_t **link = chunk ? &chunk->next : &arena.head;
+
+        /* chunks past the current one hold nothing live */
+        if (*link && (*link)->size < size) {
+            _twin_arena_chunks_destroy(*link);
+            *link = NULL;
+        }
+        if (!*link) {
+            size_t grow = chunk ? chunk->size * 2 : ARENA_CHUNK;
+
+            *link = _twin_arena_chunk_create(max(grow, size));
+            if (!*link)
+                return NULL;
+        }
+        chunk = arena.cur = *link;
+        chunk->used = 0;
+    }
+    p = (char *) chunk->data + chunk->used;
+    chunk->used += size;
+    return p;
+}
@@ -123,10 +123,11 @@ static twin_dispatch_result_t _twin_box_configure(twin_box_t *box)
             extents.top = pos;
             pos = extents.bottom = pos + child_h + delta_this;
         }
-        if (extents.left != ev.u.configure.extents.left ||
-            extents.top != ev.u.configure.extents.top ||
-            extents.right != ev.u.configure.extents.right ||
-            extents.bottom != ev.u.configure.extents.bottom) {
+        /* leave alone children that neither moved nor need placing */
+        if (child->configure || extents.left != child->extents.left ||
+            extents.top != child->extents.top ||
+            extents.right != child->extents.right ||
+            extents.bottom != child->extents.bottom) {
             ev.kind = TwinEventConfigure;
             ev.u.configure.extents = extents;
             (*child->dispatch)(child, &ev);
@@ -202,7 +203,7 @@ twin_dispatch_result_t _twin_box_dispatch(twin_widget_t *widget,
                 twin_pixmap_set_clip(pixmap, child->extents);
                 twin_pixmap_origin_to_clip(pixmap);
                 child->paint = false;
-                (*child->dispatch)(child, event);
+                _twin_widget_paint_child(child, event);
                 twin_pixmap_restore_clip(pixmap, clip);
                 twin_pixmap_set_origin(pixmap, ox, oy);
             }
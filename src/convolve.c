@@ -187,9 +187,13 @@ void twin_path_convolve(twin_path_t *path,
                         twin_path_t *stroke,
                         twin_path_t *pen)
 {
+    twin_arena_mark_t mark = _twin_arena_mark();
+    twin_path_t hull;
     int p;
     int s;
-    twin_path_t *hull = twin_path_convex_hull(pen);
+
+    _twin_path_init_scratch(&hull);
+    _twin_path_convex_hull(&hull, pen);
 
     p = 0;
     for (s = 0; s <= stroke->nsublen; s++) {
@@ -208,9 +212,9 @@ void twin_path_convolve(twin_path_t *path,
                 .sublen = 0,
                 .nsublen = 0,
             };
-            _twin_subpath_convolve(path, &subpath, hull);
+            _twin_subpath_convolve(path, &subpath, &hull);
             p = sublen;
         }
     }
-    twin_path_destroy(hull);
+    _twin_arena_release(mark);
 }
@@ -5,24 +5,31 @@
  * All rights reserved.
  */
 
-#include <unistd.h>
-
 #include "twin_backend.h"
 #include "twin_private.h"
 
 extern twin_backend_t g_twin_backend;
 
+/*
+ * Each iteration runs the due timeouts and the work queue, then sleeps until a
+ * watched file becomes ready, the next timeout is due or twin_wakeup() is
+ * called. Backends without a file to watch poll for input after the wait.
+ */
 void twin_dispatch(twin_context_t *ctx)
 {
     for (;;) {
+        _twin_profile_begin(TWIN_PROFILE_TIMEOUT);
         _twin_run_timeout();
+        _twin_profile_end(TWIN_PROFILE_TIMEOUT);
+
+        _twin_profile_begin(TWIN_PROFILE_WORK);
         _twin_run_work();
+        _twin_profile_end(TWIN_PROFILE_WORK);
+
+        /* Work queued by the work queue itself runs without waiting */
+        _twin_run_file(_twin_work_queued() ? 0 : _twin_timeout_delay());
 
-        if (g_twin_backend.poll && !g_twin_backend.poll(ctx)) {
-            twin_time_t delay = _twin_timeout_delay();
-            if (delay > 0)
-                usleep(delay * 1000);
+        if (g_twin_backend.poll && !g_twin_backend.poll(ctx))
             break;
-        }
     }
 }
@@ -35,7 +35,7 @@ static const twin_src_op comp2[2][4][3] = {
                 {
                     _twin_argb32_over_a8,
                     _twin_argb32_over_rgb16,
-                    _twin_argb32_over_argb32,
+                    _twin_vec_argb32_over_argb32,
                 },
             {
                 /* C */
@@ -56,13 +56,13 @@ static const twin_src_op comp2[2][4][3] = {
                 {
                     _twin_rgb16_source_a8,
                     _twin_rgb16_source_rgb16,
-                    _twin_rgb16_source_argb32,
+                    _twin_vec_rgb16_source_argb32,
                 },
             [TWIN_ARGB32] =
                 {
                     _twin_argb32_source_a8,
                     _twin_argb32_source_rgb16,
-                    _twin_argb32_source_argb32,
+                    _twin_vec_argb32_source_argb32,
                 },
             {
                 /* C */
@@ -164,7 +164,7 @@ static const twin_src_msk_op comp3[2][4][4][3] = {
                     {
                         _twin_c_in_a8_over_a8,
                         _twin_c_in_a8_over_rgb16,
-                        _twin_c_in_a8_over_argb32,
+                        _twin_vec_c_in_a8_over_argb32,
                     },
                 [TWIN_RGB16] =
                     {
@@ -406,7 +406,8 @@ static twin_xform_t *twin_pixmap_init_xform(twin_pixmap_t *pixmap,
     if (fmt == TWIN_RGB16)
         fmt = TWIN_ARGB32;
 
-    xform = calloc(1, sizeof(twin_xform_t) + width * twin_bytes_per_pixel(fmt));
+    xform = _twin_arena_alloc(sizeof(twin_xform_t) +
+                              width * twin_bytes_per_pixel(fmt));
     if (xform == NULL)
         return NULL;
 
@@ -420,11 +421,6 @@ static twin_xform_t *twin_pixmap_init_xform(twin_pixmap_t *pixmap,
     return xform;
 }
 
-static void twin_pixmap_free_xform(twin_xform_t *xform)
-{
-    free(xform);
-}
-
 #define FX(x) twin_int_to_fixed(x)
 #define XF(x) twin_fixed_to_int(x)
 
@@ -581,6 +577,7 @@ static void _twin_composite_xform(twin_pixmap_t *dst,
     twin_coord_t iy;
     twin_coord_t left, top, right, bottom;
     twin_xform_t *sxform = NULL, *mxform = NULL;
+    twin_arena_mark_t mark;
     twin_source_u s;
 
     dst_x += dst->origin_x;
@@ -606,13 +603,15 @@ static void _twin_composite_xform(twin_pixmap_t *dst,
     width = right - left;
     height = bottom - top;
 
+    /* the spans go back to the arena all at once below */
+    mark = _twin_arena_mark();
     if (src->source_kind == TWIN_PIXMAP) {
         src_x += src->u.pixmap->origin_x;
         src_y += src->u.pixmap->origin_y;
         sxform =
             twin_pixmap_init_xform(src->u.pixmap, left, width, src_x, src_y);
         if (sxform == NULL)
-            return;
+            goto done;
         s.p = sxform->span;
     } else
         s.c = src->u.argb;
@@ -627,7 +626,7 @@ static void _twin_composite_xform(twin_pixmap_t *dst,
             mxform = twin_pixmap_init_xform(msk->u.pixmap, left, width, msk_x,
                                             msk_y);
             if (mxform == NULL)
-                return;
+                goto done;
             m.p = mxform->span;
         } else
             m.c = msk->u.argb;
@@ -653,8 +652,8 @@ static void _twin_composite_xform(twin_pixmap_t *dst,
     }
     }
     twin_pixmap_damage(dst, left, top, right, bottom);
-    twin_pixmap_free_xform(sxform);
-    twin_pixmap_free_xform(mxform);
+done:
+    _twin_arena_release(mark);
 }
 
 void twin_composite(twin_pixmap_t *dst,
@@ -681,6 +680,16 @@ void twin_composite(twin_pixmap_t *dst,
                                msk_y, operator, width, height);
 }
 
+twin_src_msk_op _twin_composite_span_op(twin_pixmap_t *dst,
+                                        twin_operand_t *src,
+                                        twin_operator_t operator)
+{
+    if (src->source_kind == TWIN_PIXMAP &&
+        !twin_matrix_is_identity(&src->u.pixmap->transform))
+        return NULL;
+    return comp3[operator][operand_index(src)][TWIN_A8][dst->format];
+}
+
 /*
  * array primary    index is OVER SOURCE
  * array secondary  index is ARGB32 RGB16 A8
@@ -5,124 +5,130 @@
  * All rights reserved.
  */
 
+#include <stdlib.h>
+
 #include "twin_private.h"
 
 #define TWIN_TITLE_HEIGHT 20
 
-static void _twin_apply_stack_blur(twin_pixmap_t *trg_px,
-                                   twin_pixmap_t *src_px,
-                                   int radius,
-                                   int first_str,
-                                   int first_end,
-                                   int second_str,
-                                   int second_end,
-                                   bool horiz_scan)
+/*
+ * Stack blur
+ *
+ * Each line is blurred from a copy of itself, so the horizontal pass and then
+ * the vertical one work in place and only need a buffer as long as a line of
+ * the area. The four channels of a pixel are carried as lanes of one vector;
+ * the division by the kernel weight is a multiplication by its reciprocal,
+ * exact as long as the weighted sums stay below 2^32 / den, which bounds the
+ * radius.
+ */
+
+#if defined(CONFIG_SIMD) && defined(__SSE2__)
+#define TWIN_BLUR_SSE2 1
+#include <emmintrin.h>
+#endif
+
+#define TWIN_BLUR_RADIUS_MAX 63
+
+#if defined(TWIN_BLUR_SSE2)
+static inline __m128i _twin_blur_unpack(twin_argb32_t p)
 {
-    int den = (radius + 1) * (radius + 1);
-    twin_pointer_t src_ptr, trg_ptr, old_ptr, new_ptr;
-    twin_argb32_t sumInR, sumOutR, sumR, sumInG, sumOutG, sumG, sumInB, sumOutB,
-        sumB, sumInA, sumOutA, sumA, _cur, _old, _new, _src;
-    uint16_t tmpR, tmpG, tmpB, tmpA;
-    for (int first = first_str; first < first_end; first++) {
-        sumInR = sumOutR = sumR = sumInG = sumOutG = sumG = sumInB = sumOutB =
-            sumB = sumInA = sumOutA = sumA = 0x00000000;
-
-        /* Initialize sumOut by padding. */
-        if (horiz_scan)
-            src_ptr = twin_pixmap_pointer(src_px, second_str, first);
-        else
-            src_ptr = twin_pixmap_pointer(src_px, first, second_str);
-        _src = *src_ptr.argb32;
-
-        for (int i = second_str; i < second_str + radius; i++) {
-            sumOutR = _twin_add_ARGB(sumOutR, _src, 0, tmpR);
-            sumOutG = _twin_add_ARGB(sumOutG, _src, 8, tmpG);
-            sumOutB = _twin_add_ARGB(sumOutB, _src, 16, tmpB);
-            sumOutA = _twin_add_ARGB(sumOutA, _src, 24, tmpA);
-            for (int j = 0; j < (i - second_str) + 1; j++) {
-                sumR = _twin_add_ARGB(sumR, _src, 0, tmpR);
-                sumG = _twin_add_ARGB(sumG, _src, 8, tmpG);
-                sumB = _twin_add_ARGB(sumB, _src, 16, tmpB);
-                sumA = _twin_add_ARGB(sumA, _src, 24, tmpA);
-            }
-        }
+    const __m128i zero = _mm_setzero_si128();
 
-        /* Initialize sumIn. */
-        for (int i = second_str; i < second_str + radius; i++) {
-            if (horiz_scan)
-                src_ptr = twin_pixmap_pointer(src_px, i, first);
-            else
-                src_ptr = twin_pixmap_pointer(src_px, first, i);
-            _src = *src_ptr.argb32;
-            sumInR = _twin_add_ARGB(sumInR, _src, 0, tmpR);
-            sumInG = _twin_add_ARGB(sumInG, _src, 8, tmpG);
-            sumInB = _twin_add_ARGB(sumInB, _src, 16, tmpB);
-            sumInA = _twin_add_ARGB(sumInA, _src, 24, tmpA);
-            for (int j = 0; j < radius - (i - second_str); j++) {
-                sumR = _twin_add_ARGB(sumR, _src, 0, tmpR);
-                sumG = _twin_add_ARGB(sumG, _src, 8, tmpG);
-                sumB = _twin_add_ARGB(sumB, _src, 16, tmpB);
-                sumA = _twin_add_ARGB(sumA, _src, 24, tmpA);
-            }
+    return _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(p), zero),
+                              zero);
+}
+
+static void _twin_blur_line(twin_argb32_t *dst,
+                            const twin_argb32_t *src,
+                            int n,
+                            int radius,
+                            uint32_t mul)
+{
+    const __m128i m = _mm_set1_epi32(mul);
+    const __m128i odd_lanes = _mm_set_epi32(-1, 0, -1, 0);
+    __m128i first = _twin_blur_unpack(src[0]);
+    /*
+     * Channels and weights both fit in the low half of their 32-bit lanes,
+     * so pmaddwd yields the full 32-bit products
+     */
+    __m128i sum_out = _mm_madd_epi16(first, _mm_set1_epi32(radius));
+    __m128i sum = _mm_madd_epi16(first,
+                                 _mm_set1_epi32(radius * (radius + 1) / 2));
+    __m128i sum_in = _mm_setzero_si128();
+
+    for (int i = 0; i < radius; i++) {
+        __m128i p = _twin_blur_unpack(src[min(i, n - 1)]);
+
+        sum_in = _mm_add_epi32(sum_in, p);
+        sum = _mm_add_epi32(sum, _mm_madd_epi16(p, _mm_set1_epi32(radius - i)));
+    }
+
+    for (int cur = 0; cur < n; cur++) {
+        __m128i p_cur = _twin_blur_unpack(src[cur]);
+        __m128i even, odd, q;
+
+        sum_out = _mm_add_epi32(sum_out, p_cur);
+        sum_in = _mm_add_epi32(
+            sum_in, _twin_blur_unpack(src[min(cur + radius, n - 1)]));
+        sum = _mm_add_epi32(sum, sum_in);
+
+        /* sum / den on each lane, through 32x32 -> 64 bit products */
+        even = _mm_srli_epi64(_mm_mul_epu32(sum, m), 32);
+        odd = _mm_mul_epu32(_mm_srli_epi64(sum, 32), m);
+        q = _mm_or_si128(even, _mm_and_si128(odd, odd_lanes));
+        q = _mm_packs_epi32(q, q);
+        dst[cur] = _mm_cvtsi128_si32(_mm_packus_epi16(q, q));
+
+        sum = _mm_sub_epi32(sum, sum_out);
+        sum_out = _mm_sub_epi32(
+            sum_out, _twin_blur_unpack(src[max(cur - radius, 0)]));
+        sum_in = _mm_sub_epi32(sum_in, p_cur);
+    }
+}
+#else
+static void _twin_blur_line(twin_argb32_t *dst,
+                            const twin_argb32_t *src,
+                            int n,
+                            int radius,
+                            uint32_t mul)
+{
+    uint32_t sum[4], sum_in[4] = {0}, sum_out[4];
+    int c;
+
+    for (c = 0; c < 4; c++) {
+        uint32_t first = twin_get_8(src[0], c * 8);
+
+        sum_out[c] = first * radius;
+        sum[c] = first * (radius * (radius + 1) / 2);
+    }
+    for (int i = 0; i < radius; i++) {
+        twin_argb32_t p = src[min(i, n - 1)];
+
+        for (c = 0; c < 4; c++) {
+            sum_in[c] += twin_get_8(p, c * 8);
+            sum[c] += twin_get_8(p, c * 8) * (radius - i);
         }
+    }
 
-        for (int cur = second_str; cur < second_end; cur++) {
-            if (horiz_scan) {
-                src_ptr = twin_pixmap_pointer(src_px, cur, first);
-                trg_ptr = twin_pixmap_pointer(trg_px, cur, first);
-                old_ptr = twin_pixmap_pointer(
-                    src_px, max(cur - radius, second_str), first);
-                new_ptr = twin_pixmap_pointer(
-                    src_px, min(cur + radius, second_end - 1), first);
-            } else {
-                src_ptr = twin_pixmap_pointer(src_px, first, cur);
-                trg_ptr = twin_pixmap_pointer(trg_px, first, cur);
-                old_ptr = twin_pixmap_pointer(src_px, first,
-                                              max(cur - radius, second_str));
-                new_ptr = twin_pixmap_pointer(
-                    src_px, first, min(cur + radius, second_end - 1));
-            }
-            _cur = *src_ptr.argb32;
-            _old = *old_ptr.argb32;
-            _new = *new_ptr.argb32;
-            /* STEP 1 : sumOut + current */
-            sumOutR = _twin_add_ARGB(sumOutR, _cur, 0, tmpR);
-            sumOutG = _twin_add_ARGB(sumOutG, _cur, 8, tmpG);
-            sumOutB = _twin_add_ARGB(sumOutB, _cur, 16, tmpB);
-            sumOutA = _twin_add_ARGB(sumOutA, _cur, 24, tmpA);
-            /* STEP 2 : sumIn + new */
-            sumInR = _twin_add_ARGB(sumInR, _new, 0, tmpR);
-            sumInG = _twin_add_ARGB(sumInG, _new, 8, tmpG);
-            sumInB = _twin_add_ARGB(sumInB, _new, 16, tmpB);
-            sumInA = _twin_add_ARGB(sumInA, _new, 24, tmpA);
-            /* STEP 3 : sum + sumIn */
-            sumR = _twin_add(sumR, sumInR, tmpR);
-            sumG = _twin_add(sumG, sumInG, tmpG);
-            sumB = _twin_add(sumB, sumInB, tmpB);
-            sumA = _twin_add(sumA, sumInA, tmpA);
-            /* STEP 4 : sum / denominator */
-            *trg_ptr.argb32 =
-                (_twin_div(sumR, den, 0, tmpR) | _twin_div(sumG, den, 8, tmpG) |
-                 _twin_div(sumB, den, 16, tmpB) |
-                 _twin_div(sumA, den, 24, tmpA));
-            /* STEP 5 : sum - sumOut */
-            sumR = _twin_sub(sumR, sumOutR, tmpR);
-            sumG = _twin_sub(sumG, sumOutG, tmpG);
-            sumB = _twin_sub(sumB, sumOutB, tmpB);
-            sumA = _twin_sub(sumA, sumOutA, tmpA);
-            /* STEP 6 : sumOut - old */
-            sumOutR = _twin_sub_ARGB(sumOutR, _old, 0, tmpR);
-            sumOutG = _twin_sub_ARGB(sumOutG, _old, 8, tmpG);
-            sumOutB = _twin_sub_ARGB(sumOutB, _old, 16, tmpB);
-            sumOutA = _twin_sub_ARGB(sumOutA, _old, 24, tmpA);
-            /* STEP 7 : sumIn - current */
-            sumInR = _twin_sub_ARGB(sumInR, _cur, 0, tmpR);
-            sumInG = _twin_sub_ARGB(sumInG, _cur, 8, tmpG);
-            sumInB = _twin_sub_ARGB(sumInB, _cur, 16, tmpB);
-            sumInA = _twin_sub_ARGB(sumInA, _cur, 24, tmpA);
+    for (int cur = 0; cur < n; cur++) {
+        twin_argb32_t p_cur = src[cur];
+        twin_argb32_t p_new = src[min(cur + radius, n - 1)];
+        twin_argb32_t p_old = src[max(cur - radius, 0)];
+        twin_argb32_t out = 0;
+
+        for (c = 0; c < 4; c++) {
+            sum_out[c] += twin_get_8(p_cur, c * 8);
+            sum_in[c] += twin_get_8(p_new, c * 8);
+            sum[c] += sum_in[c];
+            out |= (twin_argb32_t) (((uint64_t) sum[c] * mul) >> 32) << (c * 8);
+            sum[c] -= sum_out[c];
+            sum_out[c] -= twin_get_8(p_old, c * 8);
+            sum_in[c] -= twin_get_8(p_cur, c * 8);
         }
+        dst[cur] = out;
     }
 }
+#endif
 
 void twin_stack_blur(twin_pixmap_t *px,
                      int radius,
@@ -131,12 +137,34 @@ void twin_stack_blur(twin_pixmap_t *px,
                      twin_coord_t top,
                      twin_coord_t bottom)
 {
-    if (px->format != TWIN_ARGB32)
+    twin_coord_t width, height, x, y;
+    twin_argb32_t *line, *copy;
+    uint32_t den, mul;
+
+    if (px->format != TWIN_ARGB32 || radius < 1)
+        return;
+    if (radius > TWIN_BLUR_RADIUS_MAX)
+        radius = TWIN_BLUR_RADIUS_MAX;
+    if (left < 0)
+        left = 0;
+    if (top < 0)
+        top = 0;
+    if (right > px->width)
+        right = px->width;
+    if (bottom > px->height)
+        bottom = px->height;
+    width = right - left;
+    height = bottom - top;
+    if (width <= 0 || height <= 0)
+        return;
+
+    copy = malloc(2 * max(width, height) * sizeof(twin_argb32_t));
+    if (!copy)
         return;
-    twin_pixmap_t *tmp_px =
-        twin_pixmap_create(px->format, px->width, px->height);
-    memcpy(tmp_px->p.v, px->p.v,
-           px->width * px->height * twin_bytes_per_pixel(px->format));
+    line = copy + max(width, height);
+    den = (radius + 1) * (radius + 1);
+    mul = (uint32_t) (((1ULL << 32) + den - 1) / den);
+
     /*
      * Originally, performing a 2D convolution on each pixel takes O(width *
      * height * k²). However, by first scanning horizontally and then vertically
@@ -144,11 +172,21 @@ void twin_stack_blur(twin_pixmap_t *px,
      * complexity is reduced to O(2 * width * height * k).
      */
     /* Horizontally scan. */
-    _twin_apply_stack_blur(tmp_px, px, radius, top, bottom, left, right, true);
+    for (y = top; y < bottom; y++) {
+        twin_argb32_t *row = twin_pixmap_pointer(px, left, y).argb32;
+
+        memcpy(copy, row, width * sizeof(twin_argb32_t));
+        _twin_blur_line(row, copy, width, radius, mul);
+    }
     /* Vertically scan. */
-    _twin_apply_stack_blur(px, tmp_px, radius, left, right, top, bottom, false);
-    twin_pixmap_destroy(tmp_px);
-    return;
+    for (x = left; x < right; x++) {
+        for (y = 0; y < height; y++)
+            copy[y] = *twin_pixmap_pointer(px, x, top + y).argb32;
+        _twin_blur_line(line, copy, height, radius, mul);
+        for (y = 0; y < height; y++)
+            *twin_pixmap_pointer(px, x, top + y).argb32 = line[y];
+    }
+    free(copy);
 }
 
 #if defined(CONFIG_DROP_SHADOW)
@@ -129,6 +129,17 @@ void twin_composite(twin_pixmap_t *_dst,
     pixman_image_unref(dst);
 }
 
+twin_src_msk_op _twin_composite_span_op(twin_pixmap_t *dst,
+                                        twin_operand_t *src,
+                                        twin_operator_t operator)
+{
+    /* every composite goes through pixman images, which want whole masks */
+    (void) dst;
+    (void) src;
+    (void) operator;
+    return NULL;
+}
+
 void twin_fill(twin_pixmap_t *_dst,
                twin_argb32_t pixel,
                twin_operator_t operator,
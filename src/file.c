@@ -0,0 +1,351 @@
+/*
+ * Twin - A Tiny Window System
+ * Copyright (c) 2025 National Cheng Kung University, Taiwan
+ * All rights reserved.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#if defined(__linux__)
+#include <stdint.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#else
+#include <poll.h>
+#endif
+
+#include "twin_private.h"
+
+/*
+ * File watching
+ *
+ * twin_dispatch() sleeps in _twin_run_file() whenever no work is queued. On
+ * Linux the watched files, a timerfd armed for the earliest timeout and an
+ * eventfd used by twin_wakeup() all share one epoll instance, so the loop
+ * costs nothing while idle and reacts to input as soon as it arrives.
+ * Elsewhere the same is done with poll(2) and a self-pipe.
+ *
+ * Files cleared while their procs are being dispatched stay on a list until
+ * the batch is over, as later events of the batch may still refer to them.
+ */
+
+#define FILE_EVENTS 32
+
+struct _twin_file {
+    twin_file_t *next;
+    int file;
+    twin_file_op_t ops;
+    twin_file_proc_t proc;
+    void *closure;
+    bool deleted;
+};
+
+static twin_file_t *files, *dead;
+static bool dispatching;
+
+#if defined(__linux__)
+static int epoll_fd = -1, timer_fd = -1, wake_fd = -1;
+static bool timer_armed;
+#else
+static int wake_pipe[2] = {-1, -1};
+static int n_files;
+#endif
+
+/* Run the proc of a file that became ready; drop it when it asks to */
+static void _twin_file_ready(twin_file_t *file, twin_file_op_t ops)
+{
+    if (file->deleted)
+        return;
+    if (!(*file->proc)(file->file, ops, file->closure))
+        twin_clear_file(file);
+}
+
+static void _twin_file_unlink(twin_file_t *file)
+{
+    twin_file_t **prev;
+
+    for (prev = &files; *prev; prev = &(*prev)->next) {
+        if (*prev == file) {
+            *prev = file->next;
+            break;
+        }
+    }
+}
+
+static void _twin_file_reap(void)
+{
+    while (dead) {
+        twin_file_t *next = dead->next;
+
+        free(dead);
+        dead = next;
+    }
+}
+
+#if defined(__linux__)
+
+static uint32_t _twin_file_events(twin_file_op_t ops)
+{
+    return ((ops & TWIN_READ) ? EPOLLIN : 0) |
+           ((ops & TWIN_WRITE) ? EPOLLOUT : 0);
+}
+
+static bool _twin_file_watch(int fd, void *ptr)
+{
+    struct epoll_event ev = {.events = EPOLLIN, .data.ptr = ptr};
+
+    return epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) == 0;
+}
+
+bool _twin_file_init(void)
+{
+    if (epoll_fd >= 0)
+        return true;
+
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    /* the timer and wakeup descriptors are told apart by their tags */
+    if (epoll_fd < 0 || timer_fd < 0 || wake_fd < 0 ||
+        !_twin_file_watch(timer_fd, &timer_fd) ||
+        !_twin_file_watch(wake_fd, &wake_fd)) {
+        log_error("Failed to set up the event loop");
+        if (epoll_fd >= 0)
+            close(epoll_fd);
+        if (timer_fd >= 0)
+            close(timer_fd);
+        if (wake_fd >= 0)
+            close(wake_fd);
+        epoll_fd = timer_fd = wake_fd = -1;
+        return false;
+    }
+    return true;
+}
+
+void twin_wakeup(void)
+{
+    uint64_t one = 1;
+
+    if (wake_fd >= 0 && write(wake_fd, &one, sizeof(one)) < 0 &&
+        errno != EAGAIN)
+        log_error("Failed to wake up the event loop");
+}
+
+static void _twin_file_arm(twin_time_t delay)
+{
+    struct itimerspec its = {
+        .it_value.tv_sec = delay / 1000,
+        .it_value.tv_nsec = (long) (delay % 1000) * 1000000,
+    };
+
+    timerfd_settime(timer_fd, 0, &its, NULL);
+    timer_armed = delay > 0;
+}
+
+void _twin_run_file(twin_time_t delay)
+{
+    struct epoll_event events[FILE_EVENTS];
+    uint64_t count;
+    int n, i;
+
+    if (epoll_fd < 0) {
+        if (delay > 0)
+            usleep(delay * 1000);
+        return;
+    }
+
+    /* A zero delay polls; otherwise the timerfd bounds the wait, if at all */
+    if (delay > 0 || timer_armed)
+        _twin_file_arm(delay > 0 ? delay : 0);
+    n = epoll_wait(epoll_fd, events, FILE_EVENTS, delay ? -1 : 0);
+
+    dispatching = true;
+    for (i = 0; i < n; i++) {
+        void *ptr = events[i].data.ptr;
+        twin_file_op_t ops = 0;
+
+        if (ptr == &timer_fd || ptr == &wake_fd) {
+            /* drain the counter so the descriptor stops polling ready */
+            if (read(*(int *) ptr, &count, sizeof(count)) < 0 &&
+                errno != EAGAIN)
+                log_error("Failed to read the event loop counters");
+            continue;
+        }
+        if (events[i].events & EPOLLIN)
+            ops |= TWIN_READ;
+        if (events[i].events & EPOLLOUT)
+            ops |= TWIN_WRITE;
+        if (events[i].events & (EPOLLERR | EPOLLHUP))
+            ops |= TWIN_ERROR;
+        _twin_file_ready(ptr, ops);
+    }
+    dispatching = false;
+    _twin_file_reap();
+}
+
+twin_file_t *twin_set_file(twin_file_proc_t file_proc,
+                           int fd,
+                           twin_file_op_t ops,
+                           void *closure)
+{
+    struct epoll_event ev;
+    twin_file_t *file;
+
+    if (!_twin_file_init())
+        return NULL;
+
+    file = calloc(1, sizeof(twin_file_t));
+    if (!file)
+        return NULL;
+    file->file = fd;
+    file->ops = ops;
+    file->proc = file_proc;
+    file->closure = closure;
+
+    ev.events = _twin_file_events(ops);
+    ev.data.ptr = file;
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+        log_error("Failed to watch file %d", fd);
+        free(file);
+        return NULL;
+    }
+    file->next = files;
+    files = file;
+    return file;
+}
+
+void twin_clear_file(twin_file_t *file)
+{
+    if (file->deleted)
+        return;
+    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, file->file, NULL);
+    _twin_file_unlink(file);
+    file->deleted = true;
+    if (dispatching) {
+        file->next = dead;
+        dead = file;
+    } else
+        free(file);
+}
+
+#else /* poll(2) fallback */
+
+bool _twin_file_init(void)
+{
+    int i;
+
+    if (wake_pipe[0] >= 0)
+        return true;
+
+    if (pipe(wake_pipe) < 0) {
+        log_error("Failed to set up the event loop");
+        wake_pipe[0] = wake_pipe[1] = -1;
+        return false;
+    }
+    for (i = 0; i < 2; i++) {
+        fcntl(wake_pipe[i], F_SETFL, fcntl(wake_pipe[i], F_GETFL) | O_NONBLOCK);
+        fcntl(wake_pipe[i], F_SETFD, FD_CLOEXEC);
+    }
+    return true;
+}
+
+void twin_wakeup(void)
+{
+    char c = 0;
+
+    if (wake_pipe[1] >= 0 && write(wake_pipe[1], &c, 1) < 0 && errno != EAGAIN)
+        log_error("Failed to wake up the event loop");
+}
+
+void _twin_run_file(twin_time_t delay)
+{
+    struct pollfd *pfds;
+    twin_file_t *file, **ready;
+    char buf[64];
+    int n, i;
+
+    if (wake_pipe[0] < 0) {
+        if (delay > 0)
+            usleep(delay * 1000);
+        return;
+    }
+
+    pfds = malloc((n_files + 1) * (sizeof(*pfds) + sizeof(*ready)));
+    if (!pfds)
+        return;
+    ready = (twin_file_t **) (pfds + n_files + 1);
+
+    pfds[0].fd = wake_pipe[0];
+    pfds[0].events = POLLIN;
+    for (file = files, n = 1; file; file = file->next, n++) {
+        pfds[n].fd = file->file;
+        pfds[n].events = ((file->ops & TWIN_READ) ? POLLIN : 0) |
+                         ((file->ops & TWIN_WRITE) ? POLLOUT : 0);
+        ready[n] = file;
+    }
+
+    if (poll(pfds, n, delay) > 0) {
+        if (pfds[0].revents)
+            while (read(wake_pipe[0], buf, sizeof(buf)) > 0)
+                ;
+        dispatching = true;
+        for (i = 1; i < n; i++) {
+            twin_file_op_t ops = 0;
+
+            if (pfds[i].revents & POLLIN)
+                ops |= TWIN_READ;
+            if (pfds[i].revents & POLLOUT)
+                ops |= TWIN_WRITE;
+            if (pfds[i].revents & (POLLERR | POLLHUP | POLLNVAL))
+                ops |= TWIN_ERROR;
+            if (ops)
+                _twin_file_ready(ready[i], ops);
+        }
+        dispatching = false;
+        _twin_file_reap();
+    }
+    free(pfds);
+}
+
+twin_file_t *twin_set_file(twin_file_proc_t file_proc,
+                           int fd,
+                           twin_file_op_t ops,
+                           void *closure)
+{
+    twin_file_t *file;
+
+    if (!_twin_file_init())
+        return NULL;
+
+    file = calloc(1, sizeof(twin_file_t));
+    if (!file)
+        return NULL;
+    file->file = fd;
+    file->ops = ops;
+    file->proc = file_proc;
+    file->closure = closure;
+    file->next = files;
+    files = file;
+    n_files++;
+    return file;
+}
+
+void twin_clear_file(twin_file_t *file)
+{
+    if (file->deleted)
+        return;
+    _twin_file_unlink(file);
+    n_files--;
+    file->deleted = true;
+    if (dispatching) {
+        file->next = dead;
+        dead = file;
+    } else
+        free(file);
+}
+
+#endif
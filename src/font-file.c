@@ -0,0 +1,211 @@
+/*
+ * Twin - A Tiny Window System
+ * Copyright (c) 2025 National Cheng Kung University, Taiwan
+ * All rights reserved.
+ */
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "twin_private.h"
+
+/*
+ * Font files
+ *
+ * A font file is mapped read-only and its charmap and outlines are pointed at
+ * directly, so loading costs one mmap no matter how large the font is; pages
+ * are faulted in as glyphs are drawn and can be shared by every process using
+ * the same file. The layout, the charmap and every glyph program it points at
+ * are checked at load time, so drawing never has to bounds-check outlines.
+ */
+
+typedef struct _twin_font_file {
+    twin_font_t font;
+    void *map;
+    size_t size;
+} twin_font_file_t;
+
+/* Whether [offset, offset + length) lies within the mapping */
+static bool _twin_font_file_range(size_t size, uint64_t offset, uint64_t length)
+{
+    return offset <= size && length <= size - offset;
+}
+
+static bool _twin_font_file_string(const char *map, size_t size, uint32_t at)
+{
+    return at < size && memchr(map + at, '\0', size - at);
+}
+
+/*
+ * A glyph program must end with 'e' inside the outlines, and a stroke glyph
+ * must not list more snap points than the decoder has room for
+ */
+static bool _twin_font_file_glyph(const signed char *outlines,
+                                  uint32_t outlines_size,
+                                  uint32_t type,
+                                  uint32_t offset)
+{
+    const signed char *b = outlines + offset;
+    uint32_t left = outlines_size - offset;
+    uint32_t at;
+
+    if (type == TWIN_FONT_TYPE_STROKE) {
+        if (left < 6 || twin_glyph_n_snap_x(b) < 0 ||
+            twin_glyph_n_snap_x(b) > TWIN_GLYPH_MAX_SNAP_X ||
+            twin_glyph_n_snap_y(b) < 0 ||
+            twin_glyph_n_snap_y(b) > TWIN_GLYPH_MAX_SNAP_Y)
+            return false;
+        at = 6 + twin_glyph_n_snap_x(b) + twin_glyph_n_snap_y(b);
+    } else {
+        at = 4;
+    }
+
+    while (at < left) {
+        switch (b[at++]) {
+        case 'm':
+        case 'l':
+            at += 2;
+            break;
+        case '2':
+            at += 4;
+            break;
+        case 'c':
+            at += 6;
+            break;
+        case 'e':
+            return true;
+        default:
+            return false;
+        }
+    }
+    return false;
+}
+
+/*
+ * Every page must be a Unicode page, as the page index is sized by the
+ * largest one, and every glyph offset must point at a valid glyph program
+ */
+static bool _twin_font_file_charmap(const twin_charmap_t *charmap,
+                                    uint32_t n_charmap,
+                                    const signed char *outlines,
+                                    uint32_t outlines_size,
+                                    uint32_t type)
+{
+    for (uint32_t i = 0; i < n_charmap; i++) {
+        if (charmap[i].page > (0x10ffff >> UCS_PAGE_SHIFT))
+            return false;
+        for (int c = 0; c < UCS_PER_PAGE; c++)
+            if (charmap[i].offsets[c] >= outlines_size ||
+                !_twin_font_file_glyph(outlines, outlines_size, type,
+                                       charmap[i].offsets[c]))
+                return false;
+    }
+    return true;
+}
+
+static bool _twin_font_file_check(const char *map, size_t size)
+{
+    const twin_font_file_header_t *header =
+        (const twin_font_file_header_t *) map;
+
+    if (size < sizeof(*header) || header->magic != TWIN_FONT_FILE_MAGIC ||
+        header->version != TWIN_FONT_FILE_VERSION)
+        return false;
+    if (header->type != TWIN_FONT_TYPE_STROKE &&
+        header->type != TWIN_FONT_TYPE_TTF)
+        return false;
+    /* the page index stores charmap index + 1 in 16 bits */
+    if (!header->n_charmap || header->n_charmap >= UINT16_MAX ||
+        header->charmap % 4 ||
+        !_twin_font_file_range(
+            size, header->charmap,
+            (uint64_t) header->n_charmap * sizeof(twin_charmap_t)))
+        return false;
+    if (!header->outlines_size ||
+        !_twin_font_file_range(size, header->outlines, header->outlines_size))
+        return false;
+    if (!_twin_font_file_charmap(
+            (const twin_charmap_t *) (map + header->charmap),
+            header->n_charmap, (const signed char *) map + header->outlines,
+            header->outlines_size, header->type))
+        return false;
+    return _twin_font_file_string(map, size, header->name) &&
+           _twin_font_file_string(map, size, header->style);
+}
+
+twin_font_t *twin_font_load(const char *file)
+{
+    const twin_font_file_header_t *header;
+    twin_font_file_t *font;
+    struct stat st;
+    void *map;
+    int fd;
+
+    fd = open(file, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        log_error("Failed to open font %s", file);
+        return NULL;
+    }
+    if (fstat(fd, &st) < 0 || st.st_size <= 0) {
+        log_error("Failed to read font %s", file);
+        close(fd);
+        return NULL;
+    }
+    map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        log_error("Failed to map font %s", file);
+        return NULL;
+    }
+
+    if (!_twin_font_file_check(map, st.st_size)) {
+        log_error("%s is not a valid font file", file);
+        goto bail_map;
+    }
+
+    font = calloc(1, sizeof(twin_font_file_t));
+    if (!font)
+        goto bail_map;
+    header = map;
+    font->map = map;
+    font->size = st.st_size;
+    font->font.type = header->type;
+    font->font.name = (const char *) map + header->name;
+    font->font.style = (const char *) map + header->style;
+    font->font.charmap =
+        (const twin_charmap_t *) ((const char *) map + header->charmap);
+    font->font.n_charmap = header->n_charmap;
+    font->font.outlines = (const signed char *) map + header->outlines;
+    font->font.ascender = header->ascender;
+    font->font.descender = header->descender;
+    font->font.height = header->height;
+    return &font->font;
+
+bail_map:
+    munmap(map, st.st_size);
+    return NULL;
+}
+
+void twin_font_unload(twin_font_t *font)
+{
+    twin_font_file_t *file = (twin_font_file_t *) font;
+
+    if (!font)
+        return;
+
+    /* cached glyphs are keyed on the font address, which may be reused */
+#if defined(CONFIG_GLYPH_CACHE)
+    twin_glyph_cache_flush();
+#endif
+#if defined(CONFIG_GLYPH_ATLAS)
+    _twin_glyph_atlas_flush();
+#endif
+    free((void *) font->page_index);
+    munmap(file->map, file->size);
+    free(file);
+    _twin_font_generation++;
+}
@@ -4,6 +4,8 @@
  * All rights reserved.
  */
 
+#include <stdlib.h>
+
 #include "twin_private.h"
 
 #define SNAPI(p) (((p) + 0x8000) & ~0xffff)
@@ -25,6 +27,8 @@ typedef struct _twin_text_info {
     twin_fixed_t snap_y[TWIN_GLYPH_MAX_SNAP_Y];
 } twin_text_info_t;
 
+unsigned int _twin_font_generation;
+
 static void _twin_text_compute_info(twin_path_t *path,
                                     const twin_font_t *font,
                                     twin_text_info_t *info)
@@ -175,13 +179,11 @@ static void _twin_text_compute_snap(twin_text_info_t *info,
         info->snap_y[s] = FY(snap[s], info);
 }
 
-static twin_path_t *_twin_text_compute_pen(const twin_text_info_t *info)
+static void _twin_text_compute_pen(twin_path_t *pen,
+                                   const twin_text_info_t *info)
 {
-    twin_path_t *pen = twin_path_create();
-
     twin_path_set_matrix(pen, info->pen_matrix);
     twin_path_circle(pen, 0, 0, TWIN_FIXED_ONE);
-    return pen;
 }
 
 static twin_fixed_t _twin_snap(twin_fixed_t v, const twin_fixed_t *snap, int n)
@@ -207,24 +209,69 @@ static twin_fixed_t _twin_snap(twin_fixed_t v, const twin_fixed_t *snap, int n)
     return v;
 }
 
-static bool twin_find_ucs4_page(twin_font_t *font, uint32_t page)
+/*
+ * Charmap pages are found through a direct table from page number to charmap
+ * entry, built on first use. It is never modified once published, so lookups
+ * need no locking; threads racing to build it keep whichever copy was
+ * published first.
+ */
+struct _twin_page_index {
+    uint32_t n_pages;
+    uint16_t entry[]; /* charmap index + 1, 0 for pages the font lacks */
+};
+
+static const twin_page_index_t *_twin_font_index(twin_font_t *font)
 {
-    if (font->cur_page && font->cur_page->page == page)
-        return true;
+    const twin_page_index_t *index =
+        __atomic_load_n(&font->page_index, __ATOMIC_ACQUIRE);
+    const twin_page_index_t *expected = NULL;
+    twin_page_index_t *built;
+    uint32_t n_pages = 0;
+
+    if (index)
+        return index;
 
     for (int i = 0; i < font->n_charmap; i++)
-        if (font->charmap[i].page == page) {
-            font->cur_page = &font->charmap[i];
-            return true;
-        }
+        if (font->charmap[i].page >= n_pages)
+            n_pages = font->charmap[i].page + 1;
+    built = calloc(1, sizeof(*built) + n_pages * sizeof(built->entry[0]));
+    if (!built)
+        return NULL;
+    built->n_pages = n_pages;
+    /* the first entry wins should a page appear twice */
+    for (int i = font->n_charmap - 1; i >= 0; i--)
+        built->entry[font->charmap[i].page] = i + 1;
+
+    if (!__atomic_compare_exchange_n(&font->page_index, &expected, built,
+                                     false, __ATOMIC_ACQ_REL,
+                                     __ATOMIC_ACQUIRE)) {
+        free(built);
+        return expected;
+    }
+    return built;
+}
+
+static const twin_charmap_t *twin_find_ucs4_page(twin_font_t *font,
+                                                 uint32_t page)
+{
+    const twin_page_index_t *index = _twin_font_index(font);
 
-    font->cur_page = &font->charmap[0];
-    return false;
+    if (index) {
+        if (page < index->n_pages && index->entry[page])
+            return &font->charmap[index->entry[page] - 1];
+        return NULL;
+    }
+
+    /* out of memory, fall back to scanning the charmap */
+    for (int i = 0; i < font->n_charmap; i++)
+        if (font->charmap[i].page == page)
+            return &font->charmap[i];
+    return NULL;
 }
 
 bool twin_has_ucs4(twin_font_t *font, twin_ucs4_t ucs4)
 {
-    return twin_find_ucs4_page(font, twin_ucs_page(ucs4));
+    return twin_find_ucs4_page(font, twin_ucs_page(ucs4)) != NULL;
 }
 
 #define SNAPX(p) _snap(path, p, snap_x, nsnap_x)
@@ -232,12 +279,12 @@ bool twin_has_ucs4(twin_font_t *font, twin_ucs4_t ucs4)
 
 static const signed char *_twin_g_base(twin_font_t *font, twin_ucs4_t ucs4)
 {
-    int idx = twin_ucs_char_in_page(ucs4);
-
-    if (!twin_find_ucs4_page(font, twin_ucs_page(ucs4)))
-        idx = 0;
+    const twin_charmap_t *page = twin_find_ucs4_page(font, twin_ucs_page(ucs4));
 
-    return font->outlines + font->cur_page->offsets[idx];
+    /* missing glyphs draw as the first glyph of the font */
+    if (!page)
+        return font->outlines + font->charmap[0].offsets[0];
+    return font->outlines + page->offsets[twin_ucs_char_in_page(ucs4)];
 }
 
 static twin_fixed_t _twin_glyph_width(twin_text_info_t *info,
@@ -317,15 +364,15 @@ static const signed char *twin_glyph_draw(const twin_font_t *font,
     return b + 4;
 }
 
-void twin_path_ucs4(twin_path_t *path, twin_ucs4_t ucs4)
+static void _twin_path_glyph(twin_path_t *path, twin_ucs4_t ucs4)
 {
     twin_font_t *font = g_twin_font;
     const signed char *b = _twin_g_base(font, ucs4);
     const signed char *g = twin_glyph_draw(font, b);
     twin_spoint_t origin;
     twin_fixed_t x1, y1, x2, y2, x3, y3, _x1, _y1;
-    twin_path_t *stroke;
-    twin_path_t *pen = NULL;
+    twin_arena_mark_t mark = _twin_arena_mark();
+    twin_path_t stroke, pen;
     twin_fixed_t width;
     twin_text_info_t info;
 
@@ -335,11 +382,12 @@ void twin_path_ucs4(twin_path_t *path, twin_ucs4_t ucs4)
 
     origin = _twin_path_current_spoint(path);
 
-    stroke = twin_path_create();
-    twin_path_set_matrix(stroke, info.matrix);
+    _twin_path_init_scratch(&stroke);
+    twin_path_set_matrix(&stroke, info.matrix);
 
+    _twin_path_init_scratch(&pen);
     if (font->type == TWIN_FONT_TYPE_STROKE)
-        pen = _twin_text_compute_pen(&info);
+        _twin_text_compute_pen(&pen, &info);
 
     x1 = y1 = 0;
     for (;;) {
@@ -352,7 +400,7 @@ void twin_path_ucs4(twin_path_t *path, twin_ucs4_t ucs4)
                 x1 = _twin_snap(x1, info.snap_x, info.n_snap_x);
                 y1 = _twin_snap(y1, info.snap_y, info.n_snap_y);
             }
-            twin_path_move(stroke, x1, y1);
+            twin_path_move(&stroke, x1, y1);
             continue;
         case 'l':
             x1 = FX(*g++, &info);
@@ -361,7 +409,7 @@ void twin_path_ucs4(twin_path_t *path, twin_ucs4_t ucs4)
                 x1 = _twin_snap(x1, info.snap_x, info.n_snap_x);
                 y1 = _twin_snap(y1, info.snap_y, info.n_snap_y);
             }
-            twin_path_draw(stroke, x1, y1);
+            twin_path_draw(&stroke, x1, y1);
             continue;
         case 'c':
             x3 = FX(*g++, &info);
@@ -378,7 +426,7 @@ void twin_path_ucs4(twin_path_t *path, twin_ucs4_t ucs4)
                 x1 = _twin_snap(x1, info.snap_x, info.n_snap_x);
                 y1 = _twin_snap(y1, info.snap_y, info.n_snap_y);
             }
-            twin_path_curve(stroke, x3, y3, x2, y2, x1, y1);
+            twin_path_curve(&stroke, x3, y3, x2, y2, x1, y1);
             continue;
         case '2':
             _x1 = FX(*g++, &info);
@@ -389,7 +437,7 @@ void twin_path_ucs4(twin_path_t *path, twin_ucs4_t ucs4)
             y1 = FY(*g++, &info);
             x2 = x1 + 2 * (_x1 - x1) / 3;
             y2 = y1 + 2 * (_y1 - y1) / 3;
-            twin_path_curve(stroke, x3, y3, x2, y2, x1, y1);
+            twin_path_curve(&stroke, x3, y3, x2, y2, x1, y1);
             continue;
         case 'e':
             break;
@@ -399,12 +447,11 @@ void twin_path_ucs4(twin_path_t *path, twin_ucs4_t ucs4)
         break;
     }
 
-    if (font->type == TWIN_FONT_TYPE_STROKE) {
-        twin_path_convolve(path, stroke, pen);
-        twin_path_destroy(pen);
-    } else
-        twin_path_append(path, stroke);
-    twin_path_destroy(stroke);
+    if (font->type == TWIN_FONT_TYPE_STROKE)
+        twin_path_convolve(path, &stroke, &pen);
+    else
+        twin_path_append(path, &stroke);
+    _twin_arena_release(mark);
 
     width = _twin_glyph_width(&info, b);
 
@@ -412,6 +459,127 @@ void twin_path_ucs4(twin_path_t *path, twin_ucs4_t ucs4)
                      origin.y + _twin_matrix_dy(&info.matrix, width, 0));
 }
 
+void _twin_glyph_key_init(twin_glyph_key_t *key,
+                          const twin_path_t *path,
+                          twin_ucs4_t ucs4,
+                          twin_spoint_t origin)
+{
+    key->font = g_twin_font;
+    key->ucs4 = ucs4;
+    key->font_size = path->state.font_size;
+    key->font_style = path->state.font_style;
+    key->cap_style = path->state.cap_style;
+    key->tolerance = path->state.tolerance;
+    key->matrix[0][0] = path->state.matrix.m[0][0];
+    key->matrix[0][1] = path->state.matrix.m[0][1];
+    key->matrix[1][0] = path->state.matrix.m[1][0];
+    key->matrix[1][1] = path->state.matrix.m[1][1];
+    key->x = twin_sfixed_mod(origin.x);
+    key->y = twin_sfixed_mod(origin.y);
+}
+
+uint32_t _twin_glyph_key_hash(const twin_glyph_key_t *key)
+{
+    const uint32_t words[] = {
+        (uint32_t) (uintptr_t) key->font,
+        key->ucs4,
+        (uint32_t) key->font_size,
+        (uint32_t) key->font_style,
+        (uint32_t) key->cap_style,
+        (uint32_t) key->tolerance,
+        (uint32_t) key->matrix[0][0],
+        (uint32_t) key->matrix[0][1],
+        (uint32_t) key->matrix[1][0],
+        (uint32_t) key->matrix[1][1],
+        (uint32_t) (key->x << 4 | key->y),
+    };
+    uint32_t hash = 2166136261u;
+
+    /* FNV-1a over whole words */
+    for (size_t i = 0; i < sizeof(words) / sizeof(words[0]); i++)
+        hash = (hash ^ words[i]) * 16777619u;
+    return hash;
+}
+
+bool _twin_glyph_key_equal(const twin_glyph_key_t *a, const twin_glyph_key_t *b)
+{
+    return a->font == b->font && a->ucs4 == b->ucs4 &&
+           a->font_size == b->font_size && a->font_style == b->font_style &&
+           a->cap_style == b->cap_style && a->tolerance == b->tolerance &&
+           a->matrix[0][0] == b->matrix[0][0] &&
+           a->matrix[0][1] == b->matrix[0][1] &&
+           a->matrix[1][0] == b->matrix[1][0] &&
+           a->matrix[1][1] == b->matrix[1][1] && a->x == b->x && a->y == b->y;
+}
+
+#if defined(CONFIG_GLYPH_CACHE)
+/* Append a cached glyph, whose first point replaces the current one */
+static void _twin_glyph_replay(twin_path_t *path,
+                               const twin_path_t *glyph,
+                               twin_sfixed_t dx,
+                               twin_sfixed_t dy)
+{
+    path->points[path->npoints - 1].x = glyph->points[0].x + dx;
+    path->points[path->npoints - 1].y = glyph->points[0].y + dy;
+    for (int p = 1, s = 0; p < glyph->npoints; p++) {
+        if (s < glyph->nsublen && p == glyph->sublen[s]) {
+            _twin_path_sfinish(path);
+            s++;
+        }
+        _twin_path_sdraw(path, glyph->points[p].x + dx,
+                         glyph->points[p].y + dy);
+    }
+}
+
+static bool _twin_path_ucs4_cached(twin_path_t *path, twin_ucs4_t ucs4)
+{
+    twin_spoint_t origin = _twin_path_current_spoint(path);
+    int start = path->nsublen ? path->sublen[path->nsublen - 1] : 0;
+    /* grows while convolving, so not scratch */
+    static _Thread_local twin_path_t *outline;
+    twin_path_t *glyph;
+    const twin_path_t *cached;
+    twin_glyph_key_t key;
+
+    /* Glyphs continuing a subpath would not start with a point to replace */
+    if (path->npoints - start != 1)
+        return false;
+
+    _twin_glyph_key_init(&key, path, ucs4, origin);
+
+    _twin_glyph_cache_lock();
+    cached = _twin_glyph_cache_find(&key);
+    if (cached)
+        _twin_glyph_replay(path, cached, twin_sfixed_floor(origin.x),
+                           twin_sfixed_floor(origin.y));
+    _twin_glyph_cache_unlock();
+    if (cached)
+        return true;
+
+    if (!(glyph = _twin_path_reuse(&outline)))
+        return false;
+    glyph->state = path->state;
+    _twin_path_smove(glyph, key.x, key.y);
+    _twin_path_glyph(glyph, ucs4);
+    _twin_glyph_replay(path, glyph, twin_sfixed_floor(origin.x),
+                       twin_sfixed_floor(origin.y));
+    _twin_glyph_cache_lock();
+    _twin_glyph_cache_store(&key, glyph);
+    _twin_glyph_cache_unlock();
+    _twin_path_trim(&outline);
+    return true;
+}
+#endif
+
+void twin_path_ucs4(twin_path_t *path, twin_ucs4_t ucs4)
+{
+#if defined(CONFIG_GLYPH_CACHE)
+    if (!_twin_path_ucs4_cached(path, ucs4))
+#endif
+        _twin_path_glyph(path, ucs4);
+    _twin_profile_count(TWIN_PROFILE_GLYPHS, 1);
+}
+
 twin_fixed_t twin_width_ucs4(twin_path_t *path, twin_ucs4_t ucs4)
 {
     twin_text_metrics_t metrics;
@@ -481,6 +649,64 @@ void twin_path_utf8(twin_path_t *path, const char *string)
     }
 }
 
+void twin_paint_utf8(twin_pixmap_t *dst,
+                     twin_argb32_t argb,
+                     twin_path_t *path,
+                     const char *string)
+{
+    twin_spoint_t origin = _twin_path_current_spoint(path);
+    twin_path_t *text;
+
+#if defined(CONFIG_GLYPH_ATLAS)
+    /* Untransformed text is composited glyph by glyph from the atlas */
+    if (path->state.matrix.m[0][0] == TWIN_FIXED_ONE &&
+        path->state.matrix.m[0][1] == 0 && path->state.matrix.m[1][0] == 0 &&
+        path->state.matrix.m[1][1] == TWIN_FIXED_ONE) {
+        twin_operand_t src = {.source_kind = TWIN_SOLID, .u.argb = argb};
+        twin_operand_t msk = {.source_kind = TWIN_PIXMAP};
+        const twin_atlas_glyph_t *glyph;
+        twin_glyph_key_t key;
+        twin_ucs4_t ucs4;
+        int len;
+
+        _twin_glyph_atlas_lock();
+        while ((len = _twin_utf8_to_ucs4(string, &ucs4)) > 0) {
+            _twin_glyph_key_init(&key, path, ucs4, origin);
+            glyph = _twin_glyph_atlas_find(&key, &path->state);
+            if (!glyph)
+                break;
+            if (glyph->width) {
+                msk.u.pixmap = _twin_glyph_atlas_pixmap();
+                twin_composite(dst, twin_sfixed_trunc(origin.x) + glyph->left,
+                               twin_sfixed_trunc(origin.y) + glyph->top, &src,
+                               0, 0, &msk, glyph->x, glyph->y, TWIN_OVER,
+                               glyph->width, glyph->height);
+            }
+            origin.x += glyph->advance_x;
+            origin.y += glyph->advance_y;
+            string += len;
+        }
+        _twin_glyph_atlas_unlock();
+        _twin_path_smove(path, origin.x, origin.y);
+
+        /* anything the atlas could not hold is filled as a path below */
+        if (len <= 0)
+            return;
+    }
+#endif
+
+    text = twin_path_create();
+    if (!text)
+        return;
+    text->state = path->state;
+    _twin_path_smove(text, origin.x, origin.y);
+    twin_path_utf8(text, string);
+    twin_paint_path(dst, argb, text);
+    origin = _twin_path_current_spoint(text);
+    twin_path_destroy(text);
+    _twin_path_smove(path, origin.x, origin.y);
+}
+
 twin_fixed_t twin_width_utf8(twin_path_t *path, const char *string)
 {
     int len;
@@ -0,0 +1,194 @@
+/*
+ * Twin - A Tiny Window System
+ * Copyright (c) 2025 National Cheng Kung University, Taiwan
+ * All rights reserved.
+ */
+
+#include <pthread.h>
+#include <stdlib.h>
+
+#include "twin_private.h"
+
+/*
+ * Glyph atlas
+ *
+ * Coverage masks of untransformed glyphs are rasterized once into a shared A8
+ * pixmap and composited from there. Glyphs are packed on shelves, rows as tall
+ * as the tallest glyph placed on them; once the pixmap is full, it is cleared
+ * and filled again from scratch, which keeps the allocator trivial and the
+ * working set of the current screen in the atlas. Every thread shares the
+ * atlas, so it is only touched with its lock held.
+ */
+
+#define ATLAS_SIZE CONFIG_GLYPH_ATLAS_SIZE
+#define ATLAS_BUCKETS 512 /* power of two */
+
+typedef struct _twin_atlas_entry {
+    struct _twin_atlas_entry *next; /* hash chain */
+    twin_glyph_key_t key;
+    uint32_t hash;
+    twin_atlas_glyph_t glyph;
+} twin_atlas_entry_t;
+
+static struct {
+    pthread_mutex_t lock;
+    twin_pixmap_t *pixmap;
+    twin_coord_t shelf_x, shelf_y, shelf_height;
+    twin_atlas_entry_t *buckets[ATLAS_BUCKETS];
+} atlas = {.lock = PTHREAD_MUTEX_INITIALIZER};
+
+void _twin_glyph_atlas_lock(void)
+{
+    pthread_mutex_lock(&atlas.lock);
+}
+
+void _twin_glyph_atlas_unlock(void)
+{
+    pthread_mutex_unlock(&atlas.lock);
+}
+
+static void _twin_glyph_atlas_reset(void)
+{
+    for (int i = 0; i < ATLAS_BUCKETS; i++) {
+        while (atlas.buckets[i]) {
+            twin_atlas_entry_t *next = atlas.buckets[i]->next;
+
+            free(atlas.buckets[i]);
+            atlas.buckets[i] = next;
+        }
+    }
+    twin_fill(atlas.pixmap, 0x00000000, TWIN_SOURCE, 0, 0, ATLAS_SIZE,
+              ATLAS_SIZE);
+    atlas.shelf_x = atlas.shelf_y = atlas.shelf_height = 0;
+}
+
+/* Find room for a width x height mask, clearing the atlas when it is full */
+static bool _twin_glyph_atlas_alloc(twin_coord_t width,
+                                    twin_coord_t height,
+                                    twin_coord_t *x,
+                                    twin_coord_t *y)
+{
+    if (width > ATLAS_SIZE || height > ATLAS_SIZE)
+        return false;
+
+    if (atlas.shelf_x + width > ATLAS_SIZE) {
+        atlas.shelf_x = 0;
+        atlas.shelf_y += atlas.shelf_height;
+        atlas.shelf_height = 0;
+    }
+    if (atlas.shelf_y + height > ATLAS_SIZE)
+        _twin_glyph_atlas_reset();
+
+    *x = atlas.shelf_x;
+    *y = atlas.shelf_y;
+    atlas.shelf_x += width;
+    if (height > atlas.shelf_height)
+        atlas.shelf_height = height;
+    return true;
+}
+
+/* Rasterize the glyph of key and record where its coverage went */
+static bool _twin_glyph_atlas_render(const twin_glyph_key_t *key,
+                                     const twin_state_t *state,
+                                     twin_atlas_glyph_t *glyph)
+{
+    twin_sfixed_t left = TWIN_SFIXED_MAX, top = TWIN_SFIXED_MAX;
+    twin_sfixed_t right = TWIN_SFIXED_MIN, bottom = TWIN_SFIXED_MIN;
+    twin_path_t *path = twin_path_create();
+    twin_spoint_t end;
+    bool ok = true;
+
+    if (!path)
+        return false;
+    path->state = *state;
+    _twin_path_smove(path, key->x, key->y);
+    twin_path_ucs4(path, key->ucs4);
+
+    /* the last point is where the next glyph starts, not part of this one */
+    end = path->points[path->npoints - 1];
+    for (int i = 0; i < path->npoints - 1; i++) {
+        twin_spoint_t p = path->points[i];
+
+        if (p.x < left)
+            left = p.x;
+        if (p.x > right)
+            right = p.x;
+        if (p.y < top)
+            top = p.y;
+        if (p.y > bottom)
+            bottom = p.y;
+    }
+
+    glyph->advance_x = end.x - key->x;
+    glyph->advance_y = end.y - key->y;
+    glyph->x = glyph->y = glyph->left = glyph->top = 0;
+    glyph->width = glyph->height = 0;
+    if (left < right && top < bottom) {
+        glyph->left = twin_sfixed_trunc(left);
+        glyph->top = twin_sfixed_trunc(top);
+        glyph->width = twin_sfixed_trunc(twin_sfixed_ceil(right)) - glyph->left;
+        glyph->height =
+            twin_sfixed_trunc(twin_sfixed_ceil(bottom)) - glyph->top;
+
+        ok = _twin_glyph_atlas_alloc(glyph->width, glyph->height, &glyph->x,
+                                     &glyph->y);
+        if (ok) {
+            twin_pixmap_clip(atlas.pixmap, glyph->x, glyph->y,
+                             glyph->x + glyph->width, glyph->y + glyph->height);
+            twin_fill_path(atlas.pixmap, path, glyph->x - glyph->left,
+                           glyph->y - glyph->top);
+            twin_pixmap_reset_clip(atlas.pixmap);
+        }
+    }
+    twin_path_destroy(path);
+    return ok;
+}
+
+const twin_atlas_glyph_t *_twin_glyph_atlas_find(const twin_glyph_key_t *key,
+                                                 const twin_state_t *state)
+{
+    uint32_t hash = _twin_glyph_key_hash(key);
+    twin_atlas_entry_t *entry, **bucket;
+
+    if (!atlas.pixmap) {
+        atlas.pixmap = twin_pixmap_create(TWIN_A8, ATLAS_SIZE, ATLAS_SIZE);
+        if (!atlas.pixmap)
+            return NULL;
+        _twin_glyph_atlas_reset();
+    }
+
+    for (entry = atlas.buckets[hash & (ATLAS_BUCKETS - 1)]; entry;
+         entry = entry->next) {
+        if (entry->hash == hash && _twin_glyph_key_equal(&entry->key, key))
+            return &entry->glyph;
+    }
+
+    entry = malloc(sizeof(twin_atlas_entry_t));
+    if (!entry)
+        return NULL;
+    if (!_twin_glyph_atlas_render(key, state, &entry->glyph)) {
+        free(entry);
+        return NULL;
+    }
+    entry->key = *key;
+    entry->hash = hash;
+
+    /* rendering may have cleared the atlas; pick the bucket only now */
+    bucket = &atlas.buckets[hash & (ATLAS_BUCKETS - 1)];
+    entry->next = *bucket;
+    *bucket = entry;
+    return &entry->glyph;
+}
+
+twin_pixmap_t *_twin_glyph_atlas_pixmap(void)
+{
+    return atlas.pixmap;
+}
+
+void _twin_glyph_atlas_flush(void)
+{
+    _twin_glyph_atlas_lock();
+    if (atlas.pixmap)
+        _twin_glyph_atlas_reset();
+    _twin_glyph_atlas_unlock();
+}
@@ -0,0 +1,176 @@
+/*
+ * Twin - A Tiny Window System
+ * Copyright (c) 2025 National Cheng Kung University, Taiwan
+ * All rights reserved.
+ */
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "twin_private.h"
+
+/*
+ * Glyph outline cache
+ *
+ * Entries are hashed on their key and kept on a list from most to least
+ * recently used; the least recently used ones are dropped whenever the cache
+ * would outgrow CONFIG_GLYPH_CACHE_SIZE. Each entry holds its points and
+ * subpath ends in the same allocation. One cache serves every thread, so it
+ * is only touched with its lock held.
+ */
+
+#define GLYPH_BUCKETS 1024 /* power of two */
+#define GLYPH_BUDGET ((size_t) CONFIG_GLYPH_CACHE_SIZE * 1024)
+
+typedef struct _twin_glyph_entry {
+    struct _twin_glyph_entry *next;  /* hash chain */
+    struct _twin_glyph_entry *newer; /* LRU list */
+    struct _twin_glyph_entry *older;
+    twin_glyph_key_t key;
+    uint32_t hash;
+    size_t bytes;
+    twin_path_t path;
+} twin_glyph_entry_t;
+
+static struct {
+    pthread_mutex_t lock;
+    twin_glyph_entry_t *buckets[GLYPH_BUCKETS];
+    twin_glyph_entry_t *newest, *oldest;
+    twin_glyph_cache_stats_t stats;
+} cache = {.lock = PTHREAD_MUTEX_INITIALIZER};
+
+void _twin_glyph_cache_lock(void)
+{
+    pthread_mutex_lock(&cache.lock);
+}
+
+void _twin_glyph_cache_unlock(void)
+{
+    pthread_mutex_unlock(&cache.lock);
+}
+
+static void _twin_glyph_unlink(twin_glyph_entry_t *entry)
+{
+    if (entry->newer)
+        entry->newer->older = entry->older;
+    else
+        cache.newest = entry->older;
+    if (entry->older)
+        entry->older->newer = entry->newer;
+    else
+        cache.oldest = entry->newer;
+}
+
+static void _twin_glyph_push(twin_glyph_entry_t *entry)
+{
+    entry->newer = NULL;
+    entry->older = cache.newest;
+    if (cache.newest)
+        cache.newest->newer = entry;
+    else
+        cache.oldest = entry;
+    cache.newest = entry;
+}
+
+static void _twin_glyph_evict(twin_glyph_entry_t *entry)
+{
+    twin_glyph_entry_t **prev =
+        &cache.buckets[entry->hash & (GLYPH_BUCKETS - 1)];
+
+    while (*prev != entry)
+        prev = &(*prev)->next;
+    *prev = entry->next;
+    _twin_glyph_unlink(entry);
+
+    cache.stats.entries--;
+    cache.stats.bytes -= entry->bytes;
+    free(entry);
+}
+
+static twin_glyph_entry_t *_twin_glyph_lookup(const twin_glyph_key_t *key,
+                                              uint32_t hash)
+{
+    twin_glyph_entry_t *entry;
+
+    for (entry = cache.buckets[hash & (GLYPH_BUCKETS - 1)]; entry;
+         entry = entry->next) {
+        if (entry->hash == hash && _twin_glyph_key_equal(&entry->key, key))
+            return entry;
+    }
+    return NULL;
+}
+
+const twin_path_t *_twin_glyph_cache_find(const twin_glyph_key_t *key)
+{
+    twin_glyph_entry_t *entry =
+        _twin_glyph_lookup(key, _twin_glyph_key_hash(key));
+
+    if (!entry) {
+        cache.stats.misses++;
+        return NULL;
+    }
+    if (entry != cache.newest) {
+        _twin_glyph_unlink(entry);
+        _twin_glyph_push(entry);
+    }
+    cache.stats.hits++;
+    return &entry->path;
+}
+
+void _twin_glyph_cache_store(const twin_glyph_key_t *key,
+                             const twin_path_t *glyph)
+{
+    size_t points = glyph->npoints * sizeof(twin_spoint_t);
+    size_t sublen = glyph->nsublen * sizeof(int);
+    size_t bytes = sizeof(twin_glyph_entry_t) + points + sublen;
+    uint32_t hash = _twin_glyph_key_hash(key);
+    twin_glyph_entry_t *entry, **bucket;
+
+    /* another thread may have stored the same glyph since the lookup */
+    if (bytes > GLYPH_BUDGET || _twin_glyph_lookup(key, hash))
+        return;
+    while (cache.stats.bytes + bytes > GLYPH_BUDGET) {
+        _twin_glyph_evict(cache.oldest);
+        cache.stats.evictions++;
+    }
+
+    entry = malloc(bytes);
+    if (!entry)
+        return;
+    entry->key = *key;
+    entry->hash = hash;
+    entry->bytes = bytes;
+
+    /* twin_spoint_t is four bytes wide, which keeps the subpath ends aligned */
+    entry->path = *glyph;
+    entry->path.points = (twin_spoint_t *) (entry + 1);
+    entry->path.sublen = (int *) ((char *) entry->path.points + points);
+    entry->path.size_points = glyph->npoints;
+    entry->path.size_sublen = glyph->nsublen;
+    memcpy(entry->path.points, glyph->points, points);
+    memcpy(entry->path.sublen, glyph->sublen, sublen);
+
+    bucket = &cache.buckets[entry->hash & (GLYPH_BUCKETS - 1)];
+    entry->next = *bucket;
+    *bucket = entry;
+    _twin_glyph_push(entry);
+
+    cache.stats.entries++;
+    cache.stats.bytes += bytes;
+}
+
+void twin_glyph_cache_stats(twin_glyph_cache_stats_t *stats)
+{
+    _twin_glyph_cache_lock();
+    *stats = cache.stats;
+    _twin_glyph_cache_unlock();
+}
+
+void twin_glyph_cache_flush(void)
+{
+    _twin_glyph_cache_lock();
+    while (cache.oldest)
+        _twin_glyph_evict(cache.oldest);
+    _twin_glyph_cache_unlock();
+}
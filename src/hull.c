@@ -39,7 +39,7 @@ static twin_hull_t *_twin_hull_create(const twin_path_t *path, int *nhull)
         if (p[i].y < p[e].y || (p[i].y == p[e].y && p[i].x < p[e].x))
             e = i;
 
-    hull = malloc(n * sizeof(twin_hull_t));
+    hull = _twin_arena_alloc(n * sizeof(twin_hull_t));
     if (!hull)
         return NULL;
     *nhull = n;
@@ -180,41 +180,46 @@ static void _twin_hull_eliminate_concave(twin_hull_t *hull, int num_hull)
 /*
  * Convert the hull structure back to a simple path
  */
-static twin_path_t *_twin_hull_to_path(const twin_hull_t *hull, int num_hull)
+static void _twin_hull_to_path(twin_path_t *path,
+                               const twin_hull_t *hull,
+                               int num_hull)
 {
-    twin_path_t *path = twin_path_create();
-
     for (int i = 0; i < num_hull; i++) {
         if (hull[i].discard)
             continue;
         _twin_path_sdraw(path, hull[i].point.x, hull[i].point.y);
     }
-
-    return path;
 }
 
 /*
- * Given a path, return the convex hull using the Graham scan algorithm.
+ * Given a path, compute the convex hull using the Graham scan algorithm.
  */
 
-twin_path_t *twin_path_convex_hull(twin_path_t *path)
+void _twin_path_convex_hull(twin_path_t *convex_path, twin_path_t *path)
 {
     twin_hull_t *hull;
     int num_hull;
-    twin_path_t *convex_path;
 
     hull = _twin_hull_create(path, &num_hull);
-    if (!hull)
-        return NULL;
+    if (hull) {
+        qsort(hull + 1, num_hull - 1, sizeof(twin_hull_t),
+              _twin_hull_vertex_compare);
 
-    qsort(hull + 1, num_hull - 1, sizeof(twin_hull_t),
-          _twin_hull_vertex_compare);
+        _twin_hull_eliminate_concave(hull, num_hull);
 
-    _twin_hull_eliminate_concave(hull, num_hull);
+        _twin_hull_to_path(convex_path, hull, num_hull);
+    }
+}
 
-    convex_path = _twin_hull_to_path(hull, num_hull);
+twin_path_t *twin_path_convex_hull(twin_path_t *path)
+{
+    twin_path_t *convex_path = twin_path_create();
 
-    free(hull);
+    if (convex_path) {
+        twin_arena_mark_t mark = _twin_arena_mark();
 
+        _twin_path_convex_hull(convex_path, path);
+        _twin_arena_release(mark);
+    }
     return convex_path;
 }
@@ -10,35 +10,28 @@
 
 static void _twin_label_query_geometry(twin_label_t *label)
 {
-    twin_path_t *path = twin_path_create();
     twin_text_metrics_t m;
 
     label->widget.preferred.width = twin_fixed_to_int(label->font_size) * 2;
     label->widget.preferred.height = twin_fixed_to_int(label->font_size) * 2;
-    if (path) {
-        twin_path_set_font_size(path, label->font_size);
-        twin_path_set_font_style(path, label->font_style);
-        twin_text_metrics_utf8(path, label->label, &m);
+    if (label->run) {
+        twin_text_run_metrics(label->run, &m);
         label->widget.preferred.width += twin_fixed_to_int(m.width);
-        twin_path_destroy(path);
     }
 }
 
 static void _twin_label_paint(twin_label_t *label)
 {
-    twin_path_t *path = twin_path_create();
     twin_text_metrics_t m;
     twin_coord_t w = _twin_widget_width(label);
     twin_coord_t h = _twin_widget_height(label);
 
-    if (path) {
+    if (label->run) {
         twin_fixed_t wf = twin_int_to_fixed(w);
         twin_fixed_t hf = twin_int_to_fixed(h);
         twin_fixed_t x = 0, y;
 
-        twin_path_set_font_size(path, label->font_size);
-        twin_path_set_font_style(path, label->font_style);
-        twin_text_metrics_utf8(path, label->label, &m);
+        twin_text_run_metrics(label->run, &m);
         y = (hf - (m.ascent + m.descent)) / 2 + m.ascent + label->offset.y;
         switch (label->align) {
         case TwinAlignLeft:
@@ -52,10 +45,8 @@ static void _twin_label_paint(twin_label_t *label)
             break;
         }
         x += label->offset.x;
-        twin_path_move(path, x, y);
-        twin_path_utf8(path, label->label);
-        twin_paint_path(label->widget.window->pixmap, label->foreground, path);
-        twin_path_destroy(path);
+        twin_text_run_paint(label->widget.window->pixmap, label->foreground,
+                            label->run, x, y);
     }
 }
 
@@ -98,6 +89,16 @@ void twin_label_set(twin_label_t *label,
     label->font_size = font_size;
     label->font_style = font_style;
     label->foreground = foreground;
+    if (label->label) {
+        if (!label->run)
+            label->run = twin_text_run_create(label->label, font_size,
+                                              font_style);
+        else if (!twin_text_run_set(label->run, label->label, font_size,
+                                    font_style)) {
+            twin_text_run_destroy(label->run);
+            label->run = NULL;
+        }
+    }
     _twin_widget_queue_layout(&label->widget);
 }
 
@@ -112,6 +113,7 @@ void _twin_label_init(twin_label_t *label,
     static const twin_widget_layout_t preferred = {0, 0, 1, 1};
     _twin_widget_init(&label->widget, parent, 0, preferred, dispatch);
     label->label = NULL;
+    label->run = NULL;
     label->offset.x = 0;
     label->offset.y = 0;
     label->align = TwinAlignCenter;
@@ -6,6 +6,7 @@
  */
 
 #include <stdlib.h>
+#include <string.h>
 
 #include "twin_private.h"
 
@@ -42,6 +43,25 @@ twin_spoint_t _twin_path_subpath_first_spoint(twin_path_t *path)
     return path->points[start];
 }
 
+/*
+ * Resize an array of the path; scratch paths cannot give arena memory back, so
+ * they leave the old array behind until the arena is released
+ */
+static void *_twin_path_realloc(twin_path_t *path,
+                                void *old,
+                                size_t old_size,
+                                size_t size)
+{
+    void *p;
+
+    if (!path->scratch)
+        return realloc(old, size);
+    p = _twin_arena_alloc(size);
+    if (p && old)
+        memcpy(p, old, old_size);
+    return p;
+}
+
 void _twin_path_sfinish(twin_path_t *path)
 {
     switch (_twin_current_subpath_len(path)) {
@@ -59,10 +79,9 @@ void _twin_path_sfinish(twin_path_t *path)
             size_sublen = path->size_sublen * 2;
         else
             size_sublen = 1;
-        if (path->sublen)
-            sublen = realloc(path->sublen, size_sublen * sizeof(int));
-        else
-            sublen = malloc(size_sublen * sizeof(int));
+        sublen = _twin_path_realloc(path, path->sublen,
+                                    path->size_sublen * sizeof(int),
+                                    size_sublen * sizeof(int));
         if (!sublen)
             return;
         path->sublen = sublen;
@@ -102,10 +121,9 @@ void _twin_path_sdraw(twin_path_t *path, twin_sfixed_t x, twin_sfixed_t y)
             size_points = path->size_points * 2;
         else
             size_points = 16;
-        if (path->points)
-            points = realloc(path->points, size_points * sizeof(twin_spoint_t));
-        else
-            points = malloc(size_points * sizeof(twin_spoint_t));
+        points = _twin_path_realloc(path, path->points,
+                                    path->size_points * sizeof(twin_spoint_t),
+                                    size_points * sizeof(twin_spoint_t));
         if (!points)
             return;
         path->points = points;
@@ -185,10 +203,30 @@ void twin_path_ellipse(twin_path_t *path,
     twin_path_close(path);
 }
 
-static twin_fixed_t _twin_matrix_max_radius(twin_matrix_t *m)
+/*
+ * An arc cut into 2^n chords strays by R (1 - cos(pi / 2^n)), about
+ * R pi^2 / 2^(2n + 1), from a circle of radius R, so the chords needed only
+ * grow with sqrt(R / tolerance). Bounding R by the Frobenius norm of the
+ * matrix keeps the test in squares: 2^(4n) >= (pi^2 / 2)^2 R^2 / tolerance^2,
+ * a little under 25 R^2 / tolerance^2.
+ */
+static int _twin_path_arc_order(twin_path_t *path)
 {
-    return (twin_fixed_abs(m->m[0][0]) + twin_fixed_abs(m->m[0][1]) +
-            twin_fixed_abs(m->m[1][0]) + twin_fixed_abs(m->m[1][1]));
+    const twin_matrix_t *m = &path->state.matrix;
+    int64_t t = twin_sfixed_to_fixed(_twin_path_tolerance(path));
+    int64_t e = 0, v;
+    int n;
+
+    for (int i = 0; i < 2; i++)
+        for (int j = 0; j < 2; j++)
+            e += (int64_t) m->m[i][j] * m->m[i][j];
+    v = 25 * ((e + t * t - 1) / (t * t));
+    n = v > 1 ? (64 - twin_clzll(v - 1) + 3) / 4 : 0;
+    if (n < 2)
+        n = 2;
+    if (n > 10)
+        n = 10;
+    return n;
 }
 
 void twin_path_arc(twin_path_t *path,
@@ -204,33 +242,20 @@ void twin_path_arc(twin_path_t *path,
     twin_path_translate(path, x, y);
     twin_path_scale(path, x_radius, y_radius);
 
-    twin_fixed_t max_radius = _twin_matrix_max_radius(&path->state.matrix);
-    int32_t sides = max_radius / twin_sfixed_to_fixed(TWIN_SFIXED_TOLERANCE);
-    if (sides > 1024)
-        sides = 1024;
-
-    /* Calculate the nearest power of 2 that is >= sides. */
-    int32_t n = (sides > 1) ? (31 - twin_clz(sides) + 1) : 2;
+    twin_angle_t step = TWIN_ANGLE_360 >> _twin_path_arc_order(path);
+    twin_angle_t end = start + extent;
+    twin_angle_t a;
 
-    twin_angle_t step = TWIN_ANGLE_360 >> n;
-    twin_angle_t inc = step;
-    twin_angle_t epsilon = 1;
-    if (extent < 0) {
-        inc = -inc;
-        epsilon = -1;
+    /* chords run between the multiples of step strictly inside the arc */
+    twin_path_draw_polar(path, start);
+    if (extent > 0) {
+        for (a = (start & ~(step - 1)) + step; a < end; a += step)
+            twin_path_draw_polar(path, a);
+    } else {
+        for (a = ((start + step - 1) & ~(step - 1)) - step; a > end; a -= step)
+            twin_path_draw_polar(path, a);
     }
-
-    twin_angle_t first = (start + inc - epsilon) & ~(step - 1);
-    twin_angle_t last = (start + extent - inc + epsilon) & ~(step - 1);
-
-    if (first != start)
-        twin_path_draw_polar(path, start);
-
-    for (twin_angle_t a = first; a != last; a += inc)
-        twin_path_draw_polar(path, a);
-
-    if (last != start + extent)
-        twin_path_draw_polar(path, start + extent);
+    twin_path_draw_polar(path, end);
 
     twin_path_set_matrix(path, save);
 }
@@ -521,13 +546,37 @@ twin_cap_t twin_path_current_cap_style(twin_path_t *path)
     return path->state.cap_style;
 }
 
+void twin_path_set_join_style(twin_path_t *path, twin_join_t join_style)
+{
+    path->state.join_style = join_style;
+}
+
+twin_join_t twin_path_current_join_style(twin_path_t *path)
+{
+    return path->state.join_style;
+}
+
+void twin_path_set_tolerance(twin_path_t *path, twin_fixed_t tolerance)
+{
+    path->state.tolerance = tolerance;
+}
+
+twin_fixed_t twin_path_current_tolerance(twin_path_t *path)
+{
+    return path->state.tolerance;
+}
+
 void twin_path_empty(twin_path_t *path)
 {
     path->npoints = 0;
     path->nsublen = 0;
 }
 
-void twin_path_bounds(twin_path_t *path, twin_rect_t *rect)
+/*
+ * Pixels touched by the points of path, even when they span no area; returns
+ * whether they do
+ */
+static bool _twin_path_extents(twin_path_t *path, twin_rect_t *rect)
 {
     twin_sfixed_t left = TWIN_SFIXED_MAX;
     twin_sfixed_t top = TWIN_SFIXED_MAX;
@@ -547,12 +596,19 @@ void twin_path_bounds(twin_path_t *path, twin_rect_t *rect)
         if (y > bottom)
             bottom = y;
     }
-    if (left >= right || top >= bottom)
+    if (left > right || top > bottom)
         left = right = top = bottom = 0;
     rect->left = twin_sfixed_trunc(left);
     rect->top = twin_sfixed_trunc(top);
     rect->right = twin_sfixed_trunc(twin_sfixed_ceil(right));
     rect->bottom = twin_sfixed_trunc(twin_sfixed_ceil(bottom));
+    return left < right && top < bottom;
+}
+
+void twin_path_bounds(twin_path_t *path, twin_rect_t *rect)
+{
+    if (!_twin_path_extents(path, rect))
+        rect->left = rect->right = rect->top = rect->bottom = 0;
 }
 
 void twin_path_append(twin_path_t *dst, twin_path_t *src)
@@ -576,11 +632,8 @@ void twin_path_restore(twin_path_t *path, twin_state_t *state)
     path->state = *state;
 }
 
-twin_path_t *twin_path_create(void)
+static void _twin_path_init(twin_path_t *path, bool scratch)
 {
-    twin_path_t *path;
-
-    path = malloc(sizeof(twin_path_t));
     path->npoints = path->size_points = 0;
     path->nsublen = path->size_sublen = 0;
     path->points = 0;
@@ -589,9 +642,25 @@ twin_path_t *twin_path_create(void)
     path->state.font_size = TWIN_FIXED_ONE * 15;
     path->state.font_style = TwinStyleRoman;
     path->state.cap_style = TwinCapRound;
+    path->state.join_style = TwinJoinRound;
+    path->state.tolerance = twin_sfixed_to_fixed(TWIN_SFIXED_TOLERANCE);
+    path->scratch = scratch;
+}
+
+twin_path_t *twin_path_create(void)
+{
+    twin_path_t *path;
+
+    path = malloc(sizeof(twin_path_t));
+    _twin_path_init(path, false);
     return path;
 }
 
+void _twin_path_init_scratch(twin_path_t *path)
+{
+    _twin_path_init(path, true);
+}
+
 void twin_path_destroy(twin_path_t *path)
 {
     free(path->points);
@@ -599,6 +668,149 @@ void twin_path_destroy(twin_path_t *path)
     free(path);
 }
 
+/* Outlines longer than this are not worth keeping around for reuse */
+#define TWIN_PATH_KEEP 16384
+
+twin_path_t *_twin_path_reuse(twin_path_t **path)
+{
+    if (!*path)
+        *path = twin_path_create();
+    else
+        twin_path_empty(*path);
+    return *path;
+}
+
+void _twin_path_trim(twin_path_t **path)
+{
+    if (*path && (*path)->size_points > TWIN_PATH_KEEP) {
+        twin_path_destroy(*path);
+        *path = NULL;
+    }
+}
+
+typedef struct _twin_composite_sink {
+    twin_span_sink_t sink;
+    /* coverage row indexed by destination column, all zero between rows */
+    twin_a8_t *cover;
+    twin_pixmap_t *dst;
+    twin_src_msk_op op;
+    twin_operand_t *src;
+    twin_coord_t sdx, sdy; /* source offset from destination, in pixmaps */
+    twin_rect_t damage;
+} twin_composite_sink_t;
+
+static twin_a8_t *_twin_composite_sink_begin(twin_span_sink_t *sink,
+                                             twin_coord_t y)
+{
+    (void) y;
+    return ((twin_composite_sink_t *) sink)->cover;
+}
+
+static void _twin_composite_sink_end(twin_span_sink_t *sink,
+                                     twin_coord_t y,
+                                     twin_coord_t left,
+                                     twin_coord_t right)
+{
+    twin_composite_sink_t *cs = (twin_composite_sink_t *) sink;
+    twin_source_u s, m;
+
+    if (left >= right)
+        return;
+    if (cs->src->source_kind == TWIN_PIXMAP)
+        s.p = twin_pixmap_pointer(cs->src->u.pixmap, left + cs->sdx,
+                                  y + cs->sdy);
+    else
+        s.c = cs->src->u.argb;
+    m.p.a8 = cs->cover + left;
+    cs->op(twin_pixmap_pointer(cs->dst, left, y), s, m, right - left);
+    memset(cs->cover + left, 0, right - left);
+
+    if (cs->damage.left >= cs->damage.right) {
+        cs->damage = (twin_rect_t){left, right, y, y + 1};
+    } else {
+        cs->damage.left = min(cs->damage.left, left);
+        cs->damage.right = max(cs->damage.right, right);
+        cs->damage.bottom = y + 1;
+    }
+}
+
+/*
+ * Intersect bounds, in destination coordinates, with the destination clip;
+ * false when nothing is left to paint
+ */
+static bool _twin_path_clip_bounds(twin_pixmap_t *dst, twin_rect_t *bounds)
+{
+    twin_coord_t left = dst->clip.left - dst->origin_x;
+    twin_coord_t top = dst->clip.top - dst->origin_y;
+    twin_coord_t right = dst->clip.right - dst->origin_x;
+    twin_coord_t bottom = dst->clip.bottom - dst->origin_y;
+
+    if (bounds->left < left)
+        bounds->left = left;
+    if (bounds->top < top)
+        bounds->top = top;
+    if (bounds->right > right)
+        bounds->right = right;
+    if (bounds->bottom > bottom)
+        bounds->bottom = bottom;
+    return bounds->left < bounds->right && bounds->top < bounds->bottom;
+}
+
+/*
+ * Composite straight from the rasterizer, one coverage row at a time. Only
+ * OVER leaves the pixels a path does not cover alone, so the other operators
+ * still go through a mask the size of the path bounds.
+ */
+static bool _twin_composite_path_spans(twin_pixmap_t *dst,
+                                       twin_operand_t *src,
+                                       twin_coord_t src_x,
+                                       twin_coord_t src_y,
+                                       twin_path_t *path,
+                                       twin_operator_t operator,
+                                       twin_rect_t *bounds)
+{
+    twin_composite_sink_t cs = {
+        .sink = {.begin = _twin_composite_sink_begin,
+                 .end = _twin_composite_sink_end},
+        .dst = dst,
+        .src = src,
+    };
+    twin_arena_mark_t mark;
+
+    if (operator != TWIN_OVER)
+        return false;
+    cs.op = _twin_composite_span_op(dst, src, operator);
+    if (!cs.op)
+        return false;
+
+    cs.sink.clip = (twin_rect_t){
+        .left = bounds->left + dst->origin_x,
+        .right = bounds->right + dst->origin_x,
+        .top = bounds->top + dst->origin_y,
+        .bottom = bounds->bottom + dst->origin_y,
+    };
+    mark = _twin_arena_mark();
+    cs.cover = _twin_arena_alloc(cs.sink.clip.right * sizeof(twin_a8_t));
+    if (!cs.cover) {
+        _twin_arena_release(mark);
+        return false;
+    }
+    memset(cs.cover + cs.sink.clip.left, 0,
+           cs.sink.clip.right - cs.sink.clip.left);
+
+    if (src->source_kind == TWIN_PIXMAP) {
+        cs.sdx = src_x + src->u.pixmap->origin_x - dst->origin_x;
+        cs.sdy = src_y + src->u.pixmap->origin_y - dst->origin_y;
+    }
+    _twin_fill_path_sink(&cs.sink, path, twin_int_to_sfixed(dst->origin_x),
+                         twin_int_to_sfixed(dst->origin_y));
+    _twin_arena_release(mark);
+    if (cs.damage.left < cs.damage.right)
+        twin_pixmap_damage(dst, cs.damage.left, cs.damage.top,
+                           cs.damage.right, cs.damage.bottom);
+    return true;
+}
+
 void twin_composite_path(twin_pixmap_t *dst,
                          twin_operand_t *src,
                          twin_coord_t src_x,
@@ -611,6 +823,14 @@ void twin_composite_path(twin_pixmap_t *dst,
     if (bounds.left >= bounds.right || bounds.top >= bounds.bottom)
         return;
 
+    /* only the part of the path inside the clip is worth rasterizing */
+    if (!_twin_path_clip_bounds(dst, &bounds))
+        return;
+
+    if (_twin_composite_path_spans(dst, src, src_x, src_y, path, operator,
+                                   &bounds))
+        return;
+
     twin_coord_t width = bounds.right - bounds.left;
     twin_coord_t height = bounds.bottom - bounds.top;
     twin_pixmap_t *mask = twin_pixmap_create(TWIN_A8, width, height);
@@ -630,6 +850,27 @@ void twin_paint_path(twin_pixmap_t *dst, twin_argb32_t argb, twin_path_t *path)
     twin_composite_path(dst, &src, 0, 0, path, TWIN_OVER);
 }
 
+#if defined(CONFIG_STROKE_OFFSET_DEFAULT)
+static twin_stroker_t stroker = TWIN_STROKE_OFFSET;
+#else
+static twin_stroker_t stroker = TWIN_STROKE_CONVOLVE;
+#endif
+
+bool twin_set_stroker(twin_stroker_t kind)
+{
+#if !defined(CONFIG_STROKE_OFFSET)
+    if (kind == TWIN_STROKE_OFFSET)
+        return false;
+#endif
+    stroker = kind;
+    return true;
+}
+
+twin_stroker_t twin_get_stroker(void)
+{
+    return stroker;
+}
+
 void twin_composite_stroke(twin_pixmap_t *dst,
                            twin_operand_t *src,
                            twin_coord_t src_x,
@@ -638,19 +879,57 @@ void twin_composite_stroke(twin_pixmap_t *dst,
                            twin_fixed_t pen_width,
                            twin_operator_t operator)
 {
-    twin_path_t *pen = twin_path_create();
-    twin_path_t *path = twin_path_create();
+    /* the outline grows while stroking, so it cannot be scratch */
+    static _Thread_local twin_path_t *outline;
+    twin_arena_mark_t mark;
+    twin_path_t *path, pen;
     twin_matrix_t m = twin_path_current_matrix(stroke);
+    twin_rect_t bounds, pen_bounds;
+
+    if (!(path = _twin_path_reuse(&outline)))
+        return;
+
+    _twin_path_extents(stroke, &bounds);
+#if defined(CONFIG_STROKE_OFFSET)
+    if (stroker == TWIN_STROKE_OFFSET) {
+        twin_coord_t reach = _twin_path_stroke_reach(stroke, pen_width);
+
+        bounds.left -= reach;
+        bounds.top -= reach;
+        bounds.right += reach;
+        bounds.bottom += reach;
+        if (_twin_path_clip_bounds(dst, &bounds)) {
+            twin_path_stroke(path, stroke, pen_width);
+            twin_composite_path(dst, src, src_x, src_y, path, operator);
+        }
+        _twin_path_trim(&outline);
+        return;
+    }
+#endif
 
+    mark = _twin_arena_mark();
+    _twin_path_init_scratch(&pen);
     m.m[2][0] = 0;
     m.m[2][1] = 0;
-    twin_path_set_matrix(pen, m);
-    twin_path_set_cap_style(path, twin_path_current_cap_style(stroke));
-    twin_path_circle(pen, 0, 0, pen_width / 2);
-    twin_path_convolve(path, stroke, pen);
-    twin_composite_path(dst, src, src_x, src_y, path, operator);
-    twin_path_destroy(path);
-    twin_path_destroy(pen);
+    twin_path_set_matrix(&pen, m);
+    twin_path_circle(&pen, 0, 0, pen_width / 2);
+
+    /*
+     * Skip the convolution when the stroke cannot reach the clip. Square caps
+     * reach past the pen bounds by up to a factor of sqrt(2), so allow twice.
+     */
+    _twin_path_extents(&pen, &pen_bounds);
+    bounds.left += 2 * pen_bounds.left;
+    bounds.top += 2 * pen_bounds.top;
+    bounds.right += 2 * pen_bounds.right;
+    bounds.bottom += 2 * pen_bounds.bottom;
+    if (_twin_path_clip_bounds(dst, &bounds)) {
+        twin_path_set_cap_style(path, twin_path_current_cap_style(stroke));
+        twin_path_convolve(path, stroke, &pen);
+        twin_composite_path(dst, src, src_x, src_y, path, operator);
+    }
+    _twin_arena_release(mark);
+    _twin_path_trim(&outline);
 }
 
 void twin_paint_stroke(twin_pixmap_t *dst,
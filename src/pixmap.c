@@ -44,6 +44,10 @@ twin_pixmap_t *twin_pixmap_create(twin_format_t format,
     pixmap->origin_x = pixmap->origin_y = 0;
     pixmap->stride = stride;
     pixmap->disable = 0;
+    if (format == TWIN_RGB16)
+        twin_pixmap_set_opaque(pixmap, 0, 0, width, height);
+    else
+        twin_pixmap_set_opaque(pixmap, 0, 0, 0, 0);
     pixmap->animation = NULL;
 #if defined(CONFIG_DROP_SHADOW)
     pixmap->shadow = false;
@@ -77,6 +81,10 @@ twin_pixmap_t *twin_pixmap_create_const(twin_format_t format,
     pixmap->origin_x = pixmap->origin_y = 0;
     pixmap->stride = stride;
     pixmap->disable = 0;
+    if (format == TWIN_RGB16)
+        twin_pixmap_set_opaque(pixmap, 0, 0, width, height);
+    else
+        twin_pixmap_set_opaque(pixmap, 0, 0, 0, 0);
     pixmap->p = pixels;
     return pixmap;
 }
@@ -289,6 +297,34 @@ void twin_pixmap_damage(twin_pixmap_t *pixmap,
                            right + pixmap->x, bottom + pixmap->y);
 }
 
+/*
+ * Declare the given area, in pixmap coordinates, to hold only fully opaque
+ * pixels. The screen compositor does not draw anything underneath it, so the
+ * caller must keep the promise for as long as the hint is set.
+ */
+void twin_pixmap_set_opaque(twin_pixmap_t *pixmap,
+                            twin_coord_t left,
+                            twin_coord_t top,
+                            twin_coord_t right,
+                            twin_coord_t bottom)
+{
+    if (left < 0)
+        left = 0;
+    if (top < 0)
+        top = 0;
+    if (right > pixmap->width)
+        right = pixmap->width;
+    if (bottom > pixmap->height)
+        bottom = pixmap->height;
+    if (left >= right || top >= bottom)
+        left = right = top = bottom = 0;
+
+    pixmap->opaque.left = left;
+    pixmap->opaque.top = top;
+    pixmap->opaque.right = right;
+    pixmap->opaque.bottom = bottom;
+}
+
 static twin_argb32_t _twin_pixmap_fetch(twin_pixmap_t *pixmap,
                                         twin_coord_t x,
                                         twin_coord_t y)
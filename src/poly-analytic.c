@@ -0,0 +1,283 @@
+/*
+ * Twin - A Tiny Window System
+ * Copyright (c) 2025 National Cheng Kung University, Taiwan
+ * All rights reserved.
+ */
+
+#include <stdlib.h>
+
+#include "twin_private.h"
+
+/*
+ * Analytic coverage rasterizer
+ *
+ * Instead of sampling a grid inside each pixel, every edge adds the exact
+ * signed area it sweeps to the cells of the scanline it crosses. A running sum
+ * along the scanline then yields the winding-weighted area covered in each
+ * pixel, clamped to one for the non-zero rule. Only one scanline of cells is
+ * kept, and only the cells between the leftmost and rightmost edge touched on
+ * that scanline are visited and cleared again; beyond them the sum is zero.
+ *
+ * Like every area accumulating rasterizer, it cannot tell where within a pixel
+ * the area lies: where contours of opposite winding, or overlapping ones, meet
+ * inside a single pixel, the clamped sum only approximates its coverage.
+ */
+
+typedef struct _twin_line {
+    float x0, y0; /* top end */
+    float y1;     /* bottom end */
+    float dxdy;
+    float dir; /* +1 for downward edges, -1 for upward ones */
+} twin_line_t;
+
+/* float rounding without libm, which the core does not link against */
+static inline int _twin_floorf(float f)
+{
+    int i = (int) f;
+
+    return i - (f < i);
+}
+
+static inline int _twin_ceilf(float f)
+{
+    int i = (int) f;
+
+    return i + (f > i);
+}
+
+static int _line_compare_y(const void *a, const void *b)
+{
+    const twin_line_t *al = a;
+    const twin_line_t *bl = b;
+
+    return (al->y0 > bl->y0) - (al->y0 < bl->y0);
+}
+
+static int _twin_line_build(const twin_spoint_t *vertices,
+                            int nvertices,
+                            twin_line_t *lines,
+                            twin_sfixed_t dx,
+                            twin_sfixed_t dy,
+                            const twin_rect_t *clip)
+{
+    float left = clip->left, right = clip->right;
+    float top = clip->top, bottom = clip->bottom;
+    int n = 0;
+
+    for (int v = 0; v < nvertices; v++) {
+        const twin_spoint_t *a = &vertices[v];
+        const twin_spoint_t *b = &vertices[v + 1 == nvertices ? 0 : v + 1];
+        float ax, ay, bx, by;
+
+        /* horizontal edges cover no area */
+        if (a->y == b->y)
+            continue;
+
+        ax = (float) (a->x + dx) / TWIN_SFIXED_ONE;
+        ay = (float) (a->y + dy) / TWIN_SFIXED_ONE;
+        bx = (float) (b->x + dx) / TWIN_SFIXED_ONE;
+        by = (float) (b->y + dy) / TWIN_SFIXED_ONE;
+        if (ay < by) {
+            lines[n].dir = 1;
+        } else {
+            float t;
+
+            lines[n].dir = -1;
+            t = ax, ax = bx, bx = t;
+            t = ay, ay = by, by = t;
+        }
+
+        if (by <= top || ay >= bottom)
+            continue;
+        /* edges beside the clip reach the cells within as vertical runs */
+        if (max(ax, bx) <= left)
+            ax = bx = left;
+        else if (min(ax, bx) >= right)
+            ax = bx = right;
+        lines[n].x0 = ax;
+        lines[n].y0 = ay;
+        lines[n].y1 = by;
+        lines[n].dxdy = (bx - ax) / (by - ay);
+        n++;
+    }
+    return n;
+}
+
+/*
+ * Add the area swept by the part of an edge from (xa, ya) to (xb, yb) within
+ * one scanline, d = yb - ya signed by the edge direction, to the cells it
+ * crosses and the ones to their right.
+ */
+static void _twin_line_accumulate(float *acc, float xa, float xb, float d)
+{
+    float x0 = min(xa, xb), x1 = max(xa, xb);
+    int x0i = (int) x0;
+    int x1i = _twin_ceilf(x1);
+
+    if (x1i <= x0i + 1) {
+        float xm = 0.5f * (xa + xb) - x0i;
+
+        acc[x0i] += d - d * xm;
+        acc[x0i + 1] += d * xm;
+    } else {
+        float s = 1 / (x1 - x0);
+        float x0f = x0 - x0i;
+        float a0 = 0.5f * s * (1 - x0f) * (1 - x0f);
+        float x1f = x1 - x1i + 1;
+        float am = 0.5f * s * x1f * x1f;
+
+        acc[x0i] += d * a0;
+        if (x1i == x0i + 2) {
+            acc[x0i + 1] += d * (1 - a0 - am);
+        } else {
+            float a1 = s * (1.5f - x0f);
+            float a2 = a1 + (x1i - x0i - 3) * s;
+
+            acc[x0i + 1] += d * (a1 - a0);
+            for (int xi = x0i + 2; xi < x1i - 1; xi++)
+                acc[xi] += d * s;
+            acc[x1i - 1] += d * (1 - a2 - am);
+        }
+        acc[x1i] += d * am;
+    }
+}
+
+/*
+ * Same for an edge that may leave the row of cells: the parts beyond either
+ * end are pushed against it as vertical runs, which is all the cells within
+ * can tell of them.
+ */
+static void _twin_line_accumulate_clipped(float *acc,
+                                          float xa,
+                                          float xb,
+                                          float d,
+                                          float width)
+{
+    float x0 = min(xa, xb), x1 = max(xa, xb);
+    float t0, t1;
+
+    if (x1 <= 0 || x0 >= width) {
+        float x = x1 <= 0 ? 0 : width;
+
+        _twin_line_accumulate(acc, x, x, d);
+        return;
+    }
+    t0 = x0 < 0 ? -x0 / (x1 - x0) : 0;
+    t1 = x1 > width ? (width - x0) / (x1 - x0) : 1;
+    if (t0 > 0)
+        _twin_line_accumulate(acc, 0, 0, d * t0);
+    _twin_line_accumulate(acc, max(x0, 0.0f), min(x1, width), d * (t1 - t0));
+    if (t1 < 1)
+        _twin_line_accumulate(acc, width, width, d * (1 - t1));
+}
+
+static void _twin_line_fill(twin_span_sink_t *sink, twin_line_t *lines, int n)
+{
+    int left = sink->clip.left, width = sink->clip.right - left;
+    float fwidth = width;
+    twin_line_t **active;
+    float *acc;
+    int nactive = 0, e = 0;
+
+    if (!n || width <= 0)
+        return;
+
+    /* two spare cells take what edges on the right clip add past it */
+    acc = _twin_arena_alloc((width + 2) * sizeof(float));
+    active = _twin_arena_alloc(n * sizeof(twin_line_t *));
+    if (!acc || !active)
+        return;
+    memset(acc, 0, (width + 2) * sizeof(float));
+
+    qsort(lines, n, sizeof(twin_line_t), _line_compare_y);
+    for (int y = max((int) sink->clip.top, _twin_floorf(lines[0].y0));
+         y < sink->clip.bottom; y++) {
+        float fy = y, fy1 = y + 1;
+        int xmin = width + 1, xmax = -1;
+        int touched_left = width, touched_right = 0;
+        twin_a8_t *span;
+        float sum = 0;
+
+        /* skip scanlines that no edge crosses */
+        if (!nactive) {
+            if (e == n)
+                break;
+            if (lines[e].y0 >= fy1)
+                y = _twin_floorf(lines[e].y0), fy = y, fy1 = y + 1;
+        }
+
+        for (; e < n && lines[e].y0 < fy1; e++)
+            active[nactive++] = &lines[e];
+
+        for (int i = 0; i < nactive;) {
+            twin_line_t *l = active[i];
+            float ya = max(l->y0, fy), yb = min(l->y1, fy1);
+            float xa, xb;
+
+            if (yb > ya) {
+                xa = l->x0 + (ya - l->y0) * l->dxdy - left;
+                xb = l->x0 + (yb - l->y0) * l->dxdy - left;
+                /* edges beyond the clip still count for the cells within */
+                _twin_line_accumulate_clipped(acc, xa, xb, (yb - ya) * l->dir,
+                                              fwidth);
+                xa = min(max(xa, 0.0f), fwidth);
+                xb = min(max(xb, 0.0f), fwidth);
+                xmin = min(xmin, (int) min(xa, xb));
+                xmax = max(xmax, _twin_ceilf(max(xa, xb)) + 1);
+            }
+            if (l->y1 <= fy1)
+                active[i] = active[--nactive];
+            else
+                i++;
+        }
+
+        span = sink->begin(sink, y) + left;
+        for (int x = xmin; x <= xmax; x++) {
+            twin_a16_t a;
+            float c;
+
+            sum += acc[x];
+            acc[x] = 0;
+            if (x >= width)
+                continue;
+            c = sum < 0 ? -sum : sum;
+            if (c < 0.5f / 255)
+                continue;
+            a = span[x] + (c >= 1 ? 0xff : (twin_a16_t) (c * 255 + 0.5f));
+            span[x] = twin_sat(a);
+            touched_left = min(touched_left, x);
+            touched_right = x + 1;
+        }
+        if (sink->end)
+            sink->end(sink, y, left + touched_left, left + touched_right);
+    }
+}
+
+void _twin_fill_path_analytic(twin_span_sink_t *sink,
+                              twin_path_t *path,
+                              twin_sfixed_t dx,
+                              twin_sfixed_t dy)
+{
+    twin_arena_mark_t mark = _twin_arena_mark();
+    twin_line_t *lines;
+    int p = 0, n = 0;
+
+    lines = _twin_arena_alloc(sizeof(twin_line_t) *
+                              (path->npoints + path->nsublen + 1));
+    if (!lines) {
+        _twin_arena_release(mark);
+        return;
+    }
+    for (int s = 0; s <= path->nsublen; s++) {
+        int sublen = s == path->nsublen ? path->npoints : path->sublen[s];
+
+        if (sublen - p > 1) {
+            n += _twin_line_build(path->points + p, sublen - p, lines + n, dx,
+                                  dy, &sink->clip);
+            p = sublen;
+        }
+    }
+    _twin_line_fill(sink, lines, n);
+    _twin_arena_release(mark);
+    _twin_profile_count(TWIN_PROFILE_EDGES, n);
+}
@@ -63,8 +63,11 @@ static int _twin_edge_build(twin_spoint_t *vertices,
                             twin_edge_t *edges,
                             twin_sfixed_t dx,
                             twin_sfixed_t dy,
-                            twin_sfixed_t top_y)
+                            const twin_rect_t *clip)
 {
+    twin_sfixed_t top_y = twin_int_to_sfixed(clip->top);
+    int left_x = clip->left * TWIN_SFIXED_ONE;
+    int right_x = clip->right * TWIN_SFIXED_ONE;
     int tv, bv;
 
     int e = 0;
@@ -97,6 +100,31 @@ static int _twin_edge_build(twin_spoint_t *vertices,
         if (y >= vertices[bv].y + dy)
             continue;
 
+        /* skip edges starting below the clip */
+        if (twin_sfixed_trunc(y) >= clip->bottom)
+            continue;
+
+        edges[e].top = vertices[tv].y + dy;
+        edges[e].bot = vertices[bv].y + dy;
+
+        /*
+         * Edges entirely beside the clip only matter for the winding, so
+         * stand them up along its side, where they need no stepping
+         */
+        if (max(vertices[tv].x, vertices[bv].x) + dx <= left_x ||
+            min(vertices[tv].x, vertices[bv].x) + dx >= right_x) {
+            edges[e].x = vertices[tv].x + dx <= left_x
+                             ? left_x
+                             : min(right_x, TWIN_SFIXED_MAX);
+            edges[e].dx = edges[e].e = 0;
+            edges[e].dy = 1;
+            edges[e].inc_x = 1;
+            edges[e].step_x = 0;
+            edges[e].top = y;
+            e++;
+            continue;
+        }
+
         /* Compute bresenham terms */
         edges[e].dx = vertices[bv].x - vertices[tv].x;
         edges[e].dy = vertices[bv].y - vertices[tv].y;
@@ -109,9 +137,6 @@ static int _twin_edge_build(twin_spoint_t *vertices,
         edges[e].step_x = edges[e].inc_x * (edges[e].dx / edges[e].dy);
         edges[e].dx = edges[e].dx % edges[e].dy;
 
-        edges[e].top = vertices[tv].y + dy;
-        edges[e].bot = vertices[bv].y + dy;
-
         edges[e].x = vertices[tv].x + dx;
         edges[e].e = 0;
 
@@ -124,10 +149,13 @@ static int _twin_edge_build(twin_spoint_t *vertices,
     return e;
 }
 
-static void _span_fill(twin_pixmap_t *pixmap,
+static void _span_fill(twin_span_sink_t *sink,
+                       twin_a8_t *span,
                        twin_sfixed_t y,
                        twin_sfixed_t left,
-                       twin_sfixed_t right)
+                       twin_sfixed_t right,
+                       twin_coord_t *touched_left,
+                       twin_coord_t *touched_right)
 {
 #if TWIN_POLY_SHIFT == 0
     /* 1x1 */
@@ -162,20 +190,18 @@ static void _span_fill(twin_pixmap_t *pixmap,
 #endif
     const twin_a8_t *cover =
         coverage[(y >> TWIN_POLY_FIXED_SHIFT) & TWIN_POLY_MASK];
-    int row = twin_sfixed_trunc(y);
-    twin_a8_t *span = pixmap->p.a8 + row * pixmap->stride;
     twin_a8_t *s;
     twin_sfixed_t x;
     twin_a16_t a;
     twin_a16_t w;
     int col;
 
-    /* clip to pixmap */
-    if (left < twin_int_to_sfixed(pixmap->clip.left))
-        left = twin_int_to_sfixed(pixmap->clip.left);
+    /* clip to sink */
+    if (left < twin_int_to_sfixed(sink->clip.left))
+        left = twin_int_to_sfixed(sink->clip.left);
 
-    if (right > twin_int_to_sfixed(pixmap->clip.right))
-        right = twin_int_to_sfixed(pixmap->clip.right);
+    if (right > twin_int_to_sfixed(sink->clip.right))
+        right = twin_int_to_sfixed(sink->clip.right);
 
     /* convert to sample grid */
     left = _twin_sfixed_grid_ceil(left) >> TWIN_POLY_FIXED_SHIFT;
@@ -189,6 +215,10 @@ static void _span_fill(twin_pixmap_t *pixmap,
 
     /* starting address */
     s = span + (x >> TWIN_POLY_SHIFT);
+    if (x >> TWIN_POLY_SHIFT < *touched_left)
+        *touched_left = x >> TWIN_POLY_SHIFT;
+    if ((right + TWIN_POLY_MASK) >> TWIN_POLY_SHIFT > *touched_right)
+        *touched_right = (right + TWIN_POLY_MASK) >> TWIN_POLY_SHIFT;
 
     /* first pixel */
     if (x & TWIN_POLY_MASK) {
@@ -226,18 +256,39 @@ static void _span_fill(twin_pixmap_t *pixmap,
     }
 }
 
-static void _twin_edge_fill(twin_pixmap_t *pixmap,
+static void _twin_edge_fill(twin_span_sink_t *sink,
                             twin_edge_t *edges,
                             int nedges)
 {
     twin_edge_t *active, *a, *n, **prev;
     twin_sfixed_t x0 = 0;
+    twin_a8_t *span;
+    twin_coord_t row, touched_left, touched_right;
+
+    if (!nedges)
+        return;
 
     qsort(edges, nedges, sizeof(twin_edge_t), _edge_compare_y);
     int e = 0;
     twin_sfixed_t y = edges[0].top;
     active = 0;
+    row = twin_sfixed_trunc(y);
+    if (row >= sink->clip.bottom)
+        return;
+    span = sink->begin(sink, row);
+    touched_left = sink->clip.right;
+    touched_right = sink->clip.left;
     for (;;) {
+        /* hand over each row once all its sample rows are in */
+        if (twin_sfixed_trunc(y) != row) {
+            if (sink->end)
+                sink->end(sink, row, touched_left, touched_right);
+            row = twin_sfixed_trunc(y);
+            span = sink->begin(sink, row);
+            touched_left = sink->clip.right;
+            touched_right = sink->clip.left;
+        }
+
         /* add in new edges */
         for (; e < nedges && edges[e].top <= y; e++) {
             for (prev = &active; (a = *prev); prev = &(a->next))
@@ -254,13 +305,14 @@ static void _twin_edge_fill(twin_pixmap_t *pixmap,
                 x0 = a->x;
             w += a->winding;
             if (w == 0)
-                _span_fill(pixmap, y, x0, a->x);
+                _span_fill(sink, span, y, x0, a->x, &touched_left,
+                           &touched_right);
         }
 
-        /* step down, clipping to pixmap */
+        /* step down, clipping to sink */
         y += TWIN_POLY_STEP;
 
-        if (twin_sfixed_trunc(y) >= pixmap->clip.bottom)
+        if (twin_sfixed_trunc(y) >= sink->clip.bottom)
             break;
 
         /* strip out dead edges */
@@ -290,19 +342,51 @@ static void _twin_edge_fill(twin_pixmap_t *pixmap,
                 prev = &a->next;
         }
     }
+    if (sink->end)
+        sink->end(sink, row, touched_left, touched_right);
 }
 
-void twin_fill_path(twin_pixmap_t *pixmap,
-                    twin_path_t *path,
-                    twin_coord_t dx,
-                    twin_coord_t dy)
+#if defined(CONFIG_RASTER_ANALYTIC_DEFAULT)
+static twin_rasterizer_t rasterizer = TWIN_RASTER_ANALYTIC;
+#else
+static twin_rasterizer_t rasterizer = TWIN_RASTER_SAMPLED;
+#endif
+
+bool twin_set_rasterizer(twin_rasterizer_t kind)
 {
-    twin_sfixed_t sdx = twin_int_to_sfixed(dx + pixmap->origin_x);
-    twin_sfixed_t sdy = twin_int_to_sfixed(dy + pixmap->origin_y);
+#if !defined(CONFIG_RASTER_ANALYTIC)
+    if (kind == TWIN_RASTER_ANALYTIC)
+        return false;
+#endif
+    rasterizer = kind;
+    return true;
+}
 
+twin_rasterizer_t twin_get_rasterizer(void)
+{
+    return rasterizer;
+}
+
+void _twin_fill_path_sink(twin_span_sink_t *sink,
+                          twin_path_t *path,
+                          twin_sfixed_t dx,
+                          twin_sfixed_t dy)
+{
+#if defined(CONFIG_RASTER_ANALYTIC)
+    if (rasterizer == TWIN_RASTER_ANALYTIC) {
+        _twin_fill_path_analytic(sink, path, dx, dy);
+        return;
+    }
+#endif
+
+    twin_arena_mark_t mark = _twin_arena_mark();
     int nalloc = path->npoints + path->nsublen + 1;
-    twin_edge_t *edges = malloc(sizeof(twin_edge_t) * nalloc);
+    twin_edge_t *edges = _twin_arena_alloc(sizeof(twin_edge_t) * nalloc);
     int p = 0;
+    if (!edges) {
+        _twin_arena_release(mark);
+        return;
+    }
     int nedges = 0;
     for (int s = 0; s <= path->nsublen; s++) {
         int sublen;
@@ -312,13 +396,41 @@ void twin_fill_path(twin_pixmap_t *pixmap,
             sublen = path->sublen[s];
         int npoints = sublen - p;
         if (npoints > 1) {
-            int n =
-                _twin_edge_build(path->points + p, npoints, edges + nedges, sdx,
-                                 sdy, twin_int_to_sfixed(pixmap->clip.top));
+            int n = _twin_edge_build(path->points + p, npoints, edges + nedges,
+                                     dx, dy, &sink->clip);
             p = sublen;
             nedges += n;
         }
     }
-    _twin_edge_fill(pixmap, edges, nedges);
-    free(edges);
+    _twin_edge_fill(sink, edges, nedges);
+    _twin_arena_release(mark);
+    _twin_profile_count(TWIN_PROFILE_EDGES, nedges);
+}
+
+typedef struct _twin_pixmap_sink {
+    twin_span_sink_t sink;
+    twin_pixmap_t *pixmap;
+} twin_pixmap_sink_t;
+
+static twin_a8_t *_twin_pixmap_sink_begin(twin_span_sink_t *sink,
+                                          twin_coord_t y)
+{
+    twin_pixmap_t *pixmap = ((twin_pixmap_sink_t *) sink)->pixmap;
+
+    return pixmap->p.a8 + y * pixmap->stride;
+}
+
+void twin_fill_path(twin_pixmap_t *pixmap,
+                    twin_path_t *path,
+                    twin_coord_t dx,
+                    twin_coord_t dy)
+{
+    twin_pixmap_sink_t ps = {
+        .sink = {.clip = pixmap->clip, .begin = _twin_pixmap_sink_begin},
+        .pixmap = pixmap,
+    };
+
+    _twin_fill_path_sink(&ps.sink, path,
+                         twin_int_to_sfixed(dx + pixmap->origin_x),
+                         twin_int_to_sfixed(dy + pixmap->origin_y));
 }
@@ -0,0 +1,454 @@
+/*
+ * Twin - A Tiny Window System
+ * Copyright (c) 2025 National Cheng Kung University, Taiwan
+ * All rights reserved.
+ */
+
+#include "twin_private.h"
+
+/*
+ * SIMD versions of the hottest compositing primitives
+ *
+ * The scalar functions generated in primitive.c stay the reference; every
+ * kernel here produces bit-identical output. The per-channel multiply
+ *
+ *   t = x * a + 0x80;  x' = ((t >> 8) + t) >> 8
+ *
+ * fits in 16 bits, and the OVER operator's special cases (transparent or
+ * opaque source, zero or full mask) are all exact instances of the general
+ * formula, so a vector kernel can apply it to every pixel. Tails shorter than
+ * a vector go through the scalar reference.
+ *
+ * The best kernel for the running CPU is picked once at startup. The
+ * _twin_vec_* entry points used by the compositor dispatch through it.
+ */
+
+#if defined(CONFIG_SIMD) && (defined(__x86_64__) || defined(__i386__)) && \
+    (defined(__GNUC__) || defined(__clang__))
+#define TWIN_SIMD_X86 1
+#include <immintrin.h>
+#elif defined(CONFIG_SIMD) && defined(__ARM_NEON)
+#define TWIN_SIMD_NEON 1
+#include <arm_neon.h>
+#endif
+
+#if defined(TWIN_SIMD_X86)
+#if defined(__x86_64__) || defined(__SSE2__)
+#define SSE2_TARGET
+#else
+#define SSE2_TARGET __attribute__((target("sse2")))
+#endif
+#define AVX2_TARGET __attribute__((target("avx2")))
+
+/* x * a / 255 on 16-bit lanes, rounded like twin_int_mult() */
+static inline SSE2_TARGET __m128i _sse2_mult(__m128i x, __m128i a)
+{
+    __m128i t = _mm_add_epi16(_mm_mullo_epi16(x, a), _mm_set1_epi16(0x80));
+    return _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+}
+
+/* dst OVER src for 4 pixels */
+static inline SSE2_TARGET __m128i _sse2_over(__m128i d, __m128i s)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i ff = _mm_set1_epi16(0xff);
+    __m128i s_lo = _mm_unpacklo_epi8(s, zero);
+    __m128i s_hi = _mm_unpackhi_epi8(s, zero);
+    /* 255 - source alpha, spread over the 4 channels of each pixel */
+    __m128i a_lo = _mm_xor_si128(
+        _mm_shufflehi_epi16(_mm_shufflelo_epi16(s_lo, 0xff), 0xff), ff);
+    __m128i a_hi = _mm_xor_si128(
+        _mm_shufflehi_epi16(_mm_shufflelo_epi16(s_hi, 0xff), 0xff), ff);
+    __m128i d_lo = _sse2_mult(_mm_unpacklo_epi8(d, zero), a_lo);
+    __m128i d_hi = _sse2_mult(_mm_unpackhi_epi8(d, zero), a_hi);
+
+    return _mm_adds_epu8(_mm_packus_epi16(d_lo, d_hi), s);
+}
+
+static SSE2_TARGET void _twin_sse2_argb32_over_argb32(twin_pointer_t dst,
+                                                      twin_source_u src,
+                                                      int width)
+{
+    for (; width >= 4; width -= 4) {
+        __m128i s = _mm_loadu_si128((const __m128i *) src.p.argb32);
+        int alpha = _mm_movemask_epi8(
+            _mm_cmpeq_epi8(_mm_srli_epi32(s, 24), _mm_set1_epi32(0xff)));
+
+        if (alpha == 0xffff)
+            _mm_storeu_si128((__m128i *) dst.argb32, s);
+        else if (_mm_movemask_epi8(_mm_cmpeq_epi8(s, _mm_setzero_si128())) !=
+                 0xffff)
+            _mm_storeu_si128(
+                (__m128i *) dst.argb32,
+                _sse2_over(_mm_loadu_si128((const __m128i *) dst.argb32), s));
+        dst.argb32 += 4;
+        src.p.argb32 += 4;
+    }
+    if (width)
+        _twin_argb32_over_argb32(dst, src, width);
+}
+
+static SSE2_TARGET void _twin_sse2_c_in_a8_over_argb32(twin_pointer_t dst,
+                                                       twin_source_u src,
+                                                       twin_source_u msk,
+                                                       int width)
+{
+    const __m128i zero = _mm_setzero_si128();
+    __m128i s16 = _mm_unpacklo_epi8(_mm_set1_epi32(src.c), zero);
+
+    for (; width >= 4; width -= 4) {
+        uint32_t m4;
+
+        memcpy(&m4, msk.p.a8, sizeof(m4));
+        if (m4) {
+            __m128i m = _mm_cvtsi32_si128(m4);
+            __m128i s;
+
+            /* replicate each mask byte over the 4 channels of its pixel */
+            m = _mm_unpacklo_epi8(m, m);
+            m = _mm_unpacklo_epi16(m, m);
+            s = _mm_packus_epi16(
+                _sse2_mult(s16, _mm_unpacklo_epi8(m, zero)),
+                _sse2_mult(s16, _mm_unpackhi_epi8(m, zero)));
+            _mm_storeu_si128(
+                (__m128i *) dst.argb32,
+                _sse2_over(_mm_loadu_si128((const __m128i *) dst.argb32), s));
+        }
+        dst.argb32 += 4;
+        msk.p.a8 += 4;
+    }
+    if (width)
+        _twin_c_in_a8_over_argb32(dst, src, msk, width);
+}
+
+static SSE2_TARGET void _twin_sse2_rgb16_source_argb32(twin_pointer_t dst,
+                                                       twin_source_u src,
+                                                       int width)
+{
+    const __m128i m3 = _mm_set1_epi16(0x3);
+    const __m128i m7 = _mm_set1_epi16(0x7);
+    const __m128i mf8 = _mm_set1_epi16(0xf8);
+    const __m128i mfc = _mm_set1_epi16(0xfc);
+    const __m128i alpha = _mm_set1_epi16((short) 0xff00);
+
+    for (; width >= 8; width -= 8) {
+        __m128i s = _mm_loadu_si128((const __m128i *) src.p.rgb16);
+        /* widen 5/6-bit channels by replicating their top bits */
+        __m128i b = _mm_or_si128(_mm_and_si128(_mm_slli_epi16(s, 3), mf8),
+                                 _mm_and_si128(_mm_srli_epi16(s, 2), m7));
+        __m128i g = _mm_or_si128(_mm_and_si128(_mm_srli_epi16(s, 3), mfc),
+                                 _mm_and_si128(_mm_srli_epi16(s, 9), m3));
+        __m128i r = _mm_or_si128(_mm_and_si128(_mm_srli_epi16(s, 8), mf8),
+                                 _mm_srli_epi16(s, 13));
+        __m128i gb = _mm_or_si128(b, _mm_slli_epi16(g, 8));
+        __m128i ar = _mm_or_si128(r, alpha);
+
+        _mm_storeu_si128((__m128i *) dst.argb32, _mm_unpacklo_epi16(gb, ar));
+        _mm_storeu_si128((__m128i *) (dst.argb32 + 4),
+                         _mm_unpackhi_epi16(gb, ar));
+        dst.argb32 += 8;
+        src.p.rgb16 += 8;
+    }
+    if (width)
+        _twin_rgb16_source_argb32(dst, src, width);
+}
+
+static inline AVX2_TARGET __m256i _avx2_mult(__m256i x, __m256i a)
+{
+    __m256i t =
+        _mm256_add_epi16(_mm256_mullo_epi16(x, a), _mm256_set1_epi16(0x80));
+    return _mm256_srli_epi16(_mm256_add_epi16(t, _mm256_srli_epi16(t, 8)), 8);
+}
+
+/* dst OVER src for 8 pixels; unpack and pack stay within 128-bit lanes */
+static inline AVX2_TARGET __m256i _avx2_over(__m256i d, __m256i s)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i ff = _mm256_set1_epi16(0xff);
+    __m256i s_lo = _mm256_unpacklo_epi8(s, zero);
+    __m256i s_hi = _mm256_unpackhi_epi8(s, zero);
+    __m256i a_lo = _mm256_xor_si256(
+        _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(s_lo, 0xff), 0xff), ff);
+    __m256i a_hi = _mm256_xor_si256(
+        _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(s_hi, 0xff), 0xff), ff);
+    __m256i d_lo = _avx2_mult(_mm256_unpacklo_epi8(d, zero), a_lo);
+    __m256i d_hi = _avx2_mult(_mm256_unpackhi_epi8(d, zero), a_hi);
+
+    return _mm256_adds_epu8(_mm256_packus_epi16(d_lo, d_hi), s);
+}
+
+static AVX2_TARGET void _twin_avx2_argb32_over_argb32(twin_pointer_t dst,
+                                                      twin_source_u src,
+                                                      int width)
+{
+    for (; width >= 8; width -= 8) {
+        __m256i s = _mm256_loadu_si256((const __m256i *) src.p.argb32);
+        int alpha = _mm256_movemask_epi8(_mm256_cmpeq_epi8(
+            _mm256_srli_epi32(s, 24), _mm256_set1_epi32(0xff)));
+
+        if (alpha == -1)
+            _mm256_storeu_si256((__m256i *) dst.argb32, s);
+        else if (!_mm256_testz_si256(s, s))
+            _mm256_storeu_si256(
+                (__m256i *) dst.argb32,
+                _avx2_over(_mm256_loadu_si256((const __m256i *) dst.argb32),
+                           s));
+        dst.argb32 += 8;
+        src.p.argb32 += 8;
+    }
+    if (width)
+        _twin_sse2_argb32_over_argb32(dst, src, width);
+}
+
+static AVX2_TARGET void _twin_avx2_c_in_a8_over_argb32(twin_pointer_t dst,
+                                                       twin_source_u src,
+                                                       twin_source_u msk,
+                                                       int width)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i s16 = _mm256_unpacklo_epi8(_mm256_set1_epi32(src.c), zero);
+
+    for (; width >= 8; width -= 8) {
+        __m128i m8 = _mm_loadl_epi64((const __m128i *) msk.p.a8);
+
+        if (!_mm_testz_si128(m8, m8)) {
+            /* replicate each mask byte over the 4 channels of its pixel */
+            __m256i m = _mm256_mullo_epi32(_mm256_cvtepu8_epi32(m8),
+                                           _mm256_set1_epi32(0x01010101));
+            __m256i s = _mm256_packus_epi16(
+                _avx2_mult(s16, _mm256_unpacklo_epi8(m, zero)),
+                _avx2_mult(s16, _mm256_unpackhi_epi8(m, zero)));
+            _mm256_storeu_si256(
+                (__m256i *) dst.argb32,
+                _avx2_over(_mm256_loadu_si256((const __m256i *) dst.argb32),
+                           s));
+        }
+        dst.argb32 += 8;
+        msk.p.a8 += 8;
+    }
+    if (width)
+        _twin_sse2_c_in_a8_over_argb32(dst, src, msk, width);
+}
+
+static AVX2_TARGET void _twin_avx2_rgb16_source_argb32(twin_pointer_t dst,
+                                                       twin_source_u src,
+                                                       int width)
+{
+    const __m256i m3 = _mm256_set1_epi32(0x3);
+    const __m256i m7 = _mm256_set1_epi32(0x7);
+    const __m256i mf8 = _mm256_set1_epi32(0xf8);
+    const __m256i mfc = _mm256_set1_epi32(0xfc);
+    const __m256i alpha = _mm256_set1_epi32((int) 0xff000000);
+
+    for (; width >= 8; width -= 8) {
+        __m256i s = _mm256_cvtepu16_epi32(
+            _mm_loadu_si128((const __m128i *) src.p.rgb16));
+        __m256i b =
+            _mm256_or_si256(_mm256_and_si256(_mm256_slli_epi32(s, 3), mf8),
+                            _mm256_and_si256(_mm256_srli_epi32(s, 2), m7));
+        __m256i g =
+            _mm256_or_si256(_mm256_and_si256(_mm256_srli_epi32(s, 3), mfc),
+                            _mm256_and_si256(_mm256_srli_epi32(s, 9), m3));
+        __m256i r =
+            _mm256_or_si256(_mm256_and_si256(_mm256_srli_epi32(s, 8), mf8),
+                            _mm256_srli_epi32(s, 13));
+        __m256i p = _mm256_or_si256(
+            _mm256_or_si256(b, _mm256_slli_epi32(g, 8)),
+            _mm256_or_si256(_mm256_slli_epi32(r, 16), alpha));
+
+        _mm256_storeu_si256((__m256i *) dst.argb32, p);
+        dst.argb32 += 8;
+        src.p.rgb16 += 8;
+    }
+    if (width)
+        _twin_sse2_rgb16_source_argb32(dst, src, width);
+}
+#endif /* TWIN_SIMD_X86 */
+
+#if defined(TWIN_SIMD_NEON)
+/*
+ * x * a / 255 rounded like twin_int_mult():
+ * (p + ((p + 128) >> 8) + 128) >> 8
+ */
+static inline uint8x8_t _neon_mult(uint8x8_t x, uint8x8_t a)
+{
+    uint16x8_t p = vmull_u8(x, a);
+    return vrshrn_n_u16(vrsraq_n_u16(p, p, 8), 8);
+}
+
+/* dst OVER src for 8 pixels split into b, g, r, a planes */
+static inline uint8x8x4_t _neon_over(uint8x8x4_t d, uint8x8x4_t s)
+{
+    uint8x8_t a = vmvn_u8(s.val[3]);
+    int i;
+
+    for (i = 0; i < 4; i++)
+        d.val[i] = vqadd_u8(_neon_mult(d.val[i], a), s.val[i]);
+    return d;
+}
+
+static void _twin_neon_argb32_over_argb32(twin_pointer_t dst,
+                                          twin_source_u src,
+                                          int width)
+{
+    for (; width >= 8; width -= 8) {
+        uint8x8x4_t s = vld4_u8((const uint8_t *) src.p.argb32);
+
+        if (vget_lane_u64(vreinterpret_u64_u8(vmvn_u8(s.val[3])), 0) == 0)
+            vst4_u8((uint8_t *) dst.argb32, s);
+        else
+            vst4_u8((uint8_t *) dst.argb32,
+                    _neon_over(vld4_u8((const uint8_t *) dst.argb32), s));
+        dst.argb32 += 8;
+        src.p.argb32 += 8;
+    }
+    if (width)
+        _twin_argb32_over_argb32(dst, src, width);
+}
+
+static void _twin_neon_c_in_a8_over_argb32(twin_pointer_t dst,
+                                           twin_source_u src,
+                                           twin_source_u msk,
+                                           int width)
+{
+    uint8x8x4_t c;
+    int i;
+
+    for (i = 0; i < 4; i++)
+        c.val[i] = vdup_n_u8((uint8_t) (src.c >> (i * 8)));
+
+    for (; width >= 8; width -= 8) {
+        uint8x8_t m = vld1_u8(msk.p.a8);
+
+        if (vget_lane_u64(vreinterpret_u64_u8(m), 0)) {
+            uint8x8x4_t s;
+
+            for (i = 0; i < 4; i++)
+                s.val[i] = _neon_mult(c.val[i], m);
+            vst4_u8((uint8_t *) dst.argb32,
+                    _neon_over(vld4_u8((const uint8_t *) dst.argb32), s));
+        }
+        dst.argb32 += 8;
+        msk.p.a8 += 8;
+    }
+    if (width)
+        _twin_c_in_a8_over_argb32(dst, src, msk, width);
+}
+
+static void _twin_neon_rgb16_source_argb32(twin_pointer_t dst,
+                                           twin_source_u src,
+                                           int width)
+{
+    for (; width >= 8; width -= 8) {
+        uint16x8_t s = vld1q_u16(src.p.rgb16);
+        uint8x8x4_t p;
+
+        /* widen 5/6-bit channels by replicating their top bits */
+        p.val[0] = vmovn_u16(vorrq_u16(
+            vandq_u16(vshlq_n_u16(s, 3), vdupq_n_u16(0xf8)),
+            vandq_u16(vshrq_n_u16(s, 2), vdupq_n_u16(0x7))));
+        p.val[1] = vmovn_u16(vorrq_u16(
+            vandq_u16(vshrq_n_u16(s, 3), vdupq_n_u16(0xfc)),
+            vandq_u16(vshrq_n_u16(s, 9), vdupq_n_u16(0x3))));
+        p.val[2] = vmovn_u16(
+            vorrq_u16(vandq_u16(vshrq_n_u16(s, 8), vdupq_n_u16(0xf8)),
+                      vshrq_n_u16(s, 13)));
+        p.val[3] = vdup_n_u8(0xff);
+        vst4_u8((uint8_t *) dst.argb32, p);
+        dst.argb32 += 8;
+        src.p.rgb16 += 8;
+    }
+    if (width)
+        _twin_rgb16_source_argb32(dst, src, width);
+}
+#endif /* TWIN_SIMD_NEON */
+
+static struct {
+    twin_op_func *argb32_over_argb32;
+    twin_op_func *rgb16_source_argb32;
+    twin_in_op_func *c_in_a8_over_argb32;
+} _twin_vec = {
+#if defined(TWIN_SIMD_NEON)
+    .argb32_over_argb32 = _twin_neon_argb32_over_argb32,
+    .rgb16_source_argb32 = _twin_neon_rgb16_source_argb32,
+    .c_in_a8_over_argb32 = _twin_neon_c_in_a8_over_argb32,
+#else
+    .argb32_over_argb32 = _twin_argb32_over_argb32,
+    .rgb16_source_argb32 = _twin_rgb16_source_argb32,
+    .c_in_a8_over_argb32 = _twin_c_in_a8_over_argb32,
+#endif
+};
+
+bool _twin_vec_select(const char *isa)
+{
+    if (isa && !strcmp(isa, "scalar")) {
+        _twin_vec.argb32_over_argb32 = _twin_argb32_over_argb32;
+        _twin_vec.rgb16_source_argb32 = _twin_rgb16_source_argb32;
+        _twin_vec.c_in_a8_over_argb32 = _twin_c_in_a8_over_argb32;
+        return true;
+    }
+#if defined(TWIN_SIMD_X86)
+    __builtin_cpu_init();
+    if ((!isa || !strcmp(isa, "avx2")) && __builtin_cpu_supports("avx2")) {
+        _twin_vec.argb32_over_argb32 = _twin_avx2_argb32_over_argb32;
+        _twin_vec.rgb16_source_argb32 = _twin_avx2_rgb16_source_argb32;
+        _twin_vec.c_in_a8_over_argb32 = _twin_avx2_c_in_a8_over_argb32;
+        return true;
+    }
+    if ((!isa || !strcmp(isa, "sse2")) && __builtin_cpu_supports("sse2")) {
+        _twin_vec.argb32_over_argb32 = _twin_sse2_argb32_over_argb32;
+        _twin_vec.rgb16_source_argb32 = _twin_sse2_rgb16_source_argb32;
+        _twin_vec.c_in_a8_over_argb32 = _twin_sse2_c_in_a8_over_argb32;
+        return true;
+    }
+#elif defined(TWIN_SIMD_NEON)
+    if (!isa || !strcmp(isa, "neon")) {
+        _twin_vec.argb32_over_argb32 = _twin_neon_argb32_over_argb32;
+        _twin_vec.rgb16_source_argb32 = _twin_neon_rgb16_source_argb32;
+        _twin_vec.c_in_a8_over_argb32 = _twin_neon_c_in_a8_over_argb32;
+        return true;
+    }
+#endif
+    return !isa;
+}
+
+#if defined(TWIN_SIMD_X86)
+/* Pick the kernels for the running CPU before main() */
+__attribute__((constructor)) static void _twin_vec_init(void)
+{
+    _twin_vec_select(NULL);
+}
+#endif
+
+void _twin_vec_argb32_over_argb32(twin_pointer_t dst,
+                                  twin_source_u src,
+                                  int width)
+{
+    _twin_vec.argb32_over_argb32(dst, src, width);
+}
+
+/*
+ * A plain copy; the C library already ships vectorized memmove variants.
+ * Compositing a pixmap onto itself hands in overlapping rows.
+ */
+void _twin_vec_argb32_source_argb32(twin_pointer_t dst,
+                                    twin_source_u src,
+                                    int width)
+{
+    memmove(dst.argb32, src.p.argb32, width * sizeof(twin_argb32_t));
+}
+
+void _twin_vec_rgb16_source_argb32(twin_pointer_t dst,
+                                   twin_source_u src,
+                                   int width)
+{
+    _twin_vec.rgb16_source_argb32(dst, src, width);
+}
+
+void _twin_vec_c_in_a8_over_argb32(twin_pointer_t dst,
+                                   twin_source_u src,
+                                   twin_source_u msk,
+                                   int width)
+{
+    _twin_vec.c_in_a8_over_argb32(dst, src, msk, width);
+}
@@ -0,0 +1,248 @@
+/*
+ * Twin - A Tiny Window System
+ * Copyright (c) 2025 National Cheng Kung University, Taiwan
+ * All rights reserved.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "twin_private.h"
+
+/*
+ * Frame profiling
+ *
+ * Stages are timed on a small stack so that each one is charged only its own
+ * time: the work queue, for instance, runs window repaints and screen updates,
+ * which are accounted separately. Counters and stage times accumulate into the
+ * pending frame until the outermost stage that updated a screen ends; the frame
+ * is then appended to the ring of that screen.
+ *
+ * Every timed stage except put_span, which runs once per scanline, is also
+ * recorded as a trace event in a global ring for the Chrome trace dump.
+ */
+
+#define PROFILE_DEPTH 16
+#define PROFILE_EVENTS 16384
+
+struct _twin_screen_profile {
+    twin_frame_stats_t frames[CONFIG_PROFILE_FRAMES];
+    uint32_t n_frames; /* frames recorded so far */
+};
+
+typedef struct {
+    twin_profile_stage_t stage;
+    uint64_t start;
+    uint64_t nested; /* time spent in stages nested in this one */
+} twin_profile_level_t;
+
+typedef struct {
+    uint64_t start, duration;
+    twin_profile_stage_t stage;
+} twin_profile_event_t;
+
+static struct {
+    twin_profile_level_t stack[PROFILE_DEPTH];
+    int depth;
+
+    twin_frame_stats_t pending;
+    twin_screen_t *screen; /* screen updated in the pending frame */
+    uint64_t last_end;
+
+    twin_profile_event_t events[PROFILE_EVENTS];
+    uint32_t n_events; /* events recorded so far */
+} profile;
+
+static const char *const stage_names[TWIN_PROFILE_STAGES] = {
+    [TWIN_PROFILE_TIMEOUT] = "timeout",   [TWIN_PROFILE_WORK] = "work",
+    [TWIN_PROFILE_DRAW] = "draw",         [TWIN_PROFILE_COMPOSE] = "compose",
+    [TWIN_PROFILE_PUT_SPAN] = "put_span",
+};
+
+static const char *const counter_names[TWIN_PROFILE_COUNTERS] = {
+    [TWIN_PROFILE_PIXELS] = "pixels",
+    [TWIN_PROFILE_SPANS] = "spans",
+    [TWIN_PROFILE_EDGES] = "edges",
+    [TWIN_PROFILE_GLYPHS] = "glyphs",
+};
+
+static uint64_t _twin_profile_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+const char *twin_profile_stage_name(twin_profile_stage_t stage)
+{
+    return stage < TWIN_PROFILE_STAGES ? stage_names[stage] : NULL;
+}
+
+const char *twin_profile_counter_name(twin_profile_counter_t counter)
+{
+    return counter < TWIN_PROFILE_COUNTERS ? counter_names[counter] : NULL;
+}
+
+static void _twin_profile_commit(uint64_t now)
+{
+    twin_screen_t *screen = profile.screen;
+    struct _twin_screen_profile *p = screen->profile;
+
+    if (!p) {
+        p = screen->profile = calloc(1, sizeof(*p));
+        if (!p) {
+            profile.screen = NULL;
+            return;
+        }
+    }
+
+    profile.pending.frame = p->n_frames;
+    profile.pending.start = profile.last_end ? profile.last_end : now;
+    profile.pending.end = now;
+    p->frames[p->n_frames++ % CONFIG_PROFILE_FRAMES] = profile.pending;
+
+    memset(&profile.pending, 0, sizeof(profile.pending));
+    profile.screen = NULL;
+    profile.last_end = now;
+}
+
+void _twin_profile_begin(twin_profile_stage_t stage)
+{
+    twin_profile_level_t *level;
+
+    /* stages nested too deeply are not timed, but still pair up */
+    if (profile.depth++ >= PROFILE_DEPTH)
+        return;
+    level = &profile.stack[profile.depth - 1];
+    level->stage = stage;
+    level->nested = 0;
+    level->start = _twin_profile_now();
+}
+
+void _twin_profile_end(twin_profile_stage_t stage)
+{
+    twin_profile_level_t *level;
+    uint64_t now, duration;
+
+    if (!profile.depth || --profile.depth >= PROFILE_DEPTH)
+        return;
+
+    now = _twin_profile_now();
+    level = &profile.stack[profile.depth];
+    duration = now - level->start;
+    profile.pending.stage[stage] += duration - level->nested;
+    if (profile.depth)
+        profile.stack[profile.depth - 1].nested += duration;
+
+    if (stage != TWIN_PROFILE_PUT_SPAN) {
+        twin_profile_event_t *e =
+            &profile.events[profile.n_events++ % PROFILE_EVENTS];
+
+        e->start = level->start;
+        e->duration = duration;
+        e->stage = stage;
+    }
+
+    if (!profile.depth && profile.screen)
+        _twin_profile_commit(now);
+}
+
+void _twin_profile_count(twin_profile_counter_t counter, uint64_t n)
+{
+    profile.pending.counter[counter] += n;
+}
+
+void _twin_profile_frame(twin_screen_t *screen)
+{
+    if (profile.screen && profile.screen != screen)
+        _twin_profile_commit(_twin_profile_now());
+    profile.screen = screen;
+    if (!profile.depth)
+        _twin_profile_commit(_twin_profile_now());
+}
+
+void _twin_profile_destroy(twin_screen_t *screen)
+{
+    if (profile.screen == screen)
+        profile.screen = NULL;
+    free(screen->profile);
+    screen->profile = NULL;
+}
+
+bool twin_screen_frame_stats(twin_screen_t *screen,
+                             int age,
+                             twin_frame_stats_t *stats)
+{
+    struct _twin_screen_profile *p = screen->profile;
+
+    if (!p || age < 0 || (uint32_t) age >= p->n_frames ||
+        age >= CONFIG_PROFILE_FRAMES)
+        return false;
+    *stats = p->frames[(p->n_frames - 1 - age) % CONFIG_PROFILE_FRAMES];
+    return true;
+}
+
+bool twin_screen_write_trace(twin_screen_t *screen, const char *path)
+{
+    struct _twin_screen_profile *p = screen->profile;
+    uint32_t i, first;
+    const char *sep = "";
+    FILE *file;
+    bool ok;
+
+    file = fopen(path, "w");
+    if (!file) {
+        log_error("Failed to open %s", path);
+        return false;
+    }
+
+    /* timestamps and durations are in microseconds */
+    fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+    first = profile.n_events > PROFILE_EVENTS
+                ? profile.n_events - PROFILE_EVENTS
+                : 0;
+    for (i = first; i < profile.n_events; i++) {
+        twin_profile_event_t *e = &profile.events[i % PROFILE_EVENTS];
+
+        fprintf(file,
+                "%s\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":1,"
+                "\"ts\":%.3f,\"dur\":%.3f}",
+                sep, stage_names[e->stage], e->start / 1e3, e->duration / 1e3);
+        sep = ",";
+    }
+
+    first = p && p->n_frames > CONFIG_PROFILE_FRAMES
+                ? p->n_frames - CONFIG_PROFILE_FRAMES
+                : 0;
+    for (i = first; p && i < p->n_frames; i++) {
+        twin_frame_stats_t *f = &p->frames[i % CONFIG_PROFILE_FRAMES];
+        int c;
+
+        fprintf(file,
+                "%s\n{\"name\":\"frame\",\"ph\":\"C\",\"pid\":1,\"ts\":%.3f,"
+                "\"args\":{",
+                sep, f->end / 1e3);
+        for (c = 0; c < TWIN_PROFILE_COUNTERS; c++)
+            fprintf(file, "%s\"%s\":%llu", c ? "," : "", counter_names[c],
+                    (unsigned long long) f->counter[c]);
+        fprintf(file,
+                "}},\n{\"name\":\"stages (ms)\",\"ph\":\"C\",\"pid\":1,"
+                "\"ts\":%.3f,\"args\":{",
+                f->end / 1e3);
+        for (c = 0; c < TWIN_PROFILE_STAGES; c++)
+            fprintf(file, "%s\"%s\":%.3f", c ? "," : "", stage_names[c],
+                    f->stage[c] / 1e6);
+        fprintf(file, "}}");
+        sep = ",";
+    }
+    fprintf(file, "\n]}\n");
+
+    ok = !ferror(file);
+    if (fclose(file) != 0)
+        ok = false;
+    if (!ok)
+        log_error("Failed to write %s", path);
+    return ok;
+}
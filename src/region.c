@@ -0,0 +1,108 @@
+/*
+ * Twin - A Tiny Window System
+ * Copyright (c) 2025 National Cheng Kung University, Taiwan
+ * All rights reserved.
+ */
+
+#include "twin_private.h"
+
+static int64_t _twin_rect_area(const twin_rect_t *r)
+{
+    return (int64_t) (r->right - r->left) * (r->bottom - r->top);
+}
+
+static bool _twin_rect_overlaps(const twin_rect_t *a, const twin_rect_t *b)
+{
+    return a->left < b->right && b->left < a->right && a->top < b->bottom &&
+           b->top < a->bottom;
+}
+
+static bool _twin_rect_contains(const twin_rect_t *a, const twin_rect_t *b)
+{
+    return a->left <= b->left && b->right <= a->right && a->top <= b->top &&
+           b->bottom <= a->bottom;
+}
+
+static twin_rect_t _twin_rect_union(const twin_rect_t *a, const twin_rect_t *b)
+{
+    return (twin_rect_t){
+        .left = min(a->left, b->left),
+        .right = max(a->right, b->right),
+        .top = min(a->top, b->top),
+        .bottom = max(a->bottom, b->bottom),
+    };
+}
+
+static void _twin_region_remove(twin_region_t *region, int i)
+{
+    region->rects[i] = region->rects[--region->n_rects];
+}
+
+void _twin_region_clear(twin_region_t *region)
+{
+    region->n_rects = 0;
+}
+
+bool _twin_region_is_empty(const twin_region_t *region)
+{
+    return region->n_rects == 0;
+}
+
+/*
+ * Add a rectangle to the region, keeping the rectangles disjoint.
+ *
+ * Overlapping rectangles are always folded into their bounding box. Disjoint
+ * ones are folded too when at least half of the bounding box is real damage,
+ * since recomposing a few extra pixels is cheaper than another pass over the
+ * pixmap stack. When the set is full, the new rectangle is folded into the
+ * entry whose bounding box grows the least. Every fold removes one entry, so
+ * the loop terminates.
+ */
+void _twin_region_union_rect(twin_region_t *region,
+                             twin_coord_t left,
+                             twin_coord_t top,
+                             twin_coord_t right,
+                             twin_coord_t bottom)
+{
+    twin_rect_t rect = {
+        .left = left, .right = right, .top = top, .bottom = bottom};
+    int i;
+
+    if (left >= right || top >= bottom)
+        return;
+
+    for (;;) {
+        int best = -1;
+        int64_t best_growth = 0;
+
+        for (i = 0; i < region->n_rects; i++) {
+            twin_rect_t *r = &region->rects[i];
+            twin_rect_t u;
+
+            if (_twin_rect_contains(r, &rect))
+                return;
+            u = _twin_rect_union(r, &rect);
+            if (_twin_rect_overlaps(r, &rect) ||
+                _twin_rect_area(&u) <=
+                    2 * (_twin_rect_area(r) + _twin_rect_area(&rect)))
+                break;
+            if (best < 0 || _twin_rect_area(&u) - _twin_rect_area(r) <
+                                best_growth) {
+                best = i;
+                best_growth = _twin_rect_area(&u) - _twin_rect_area(r);
+            }
+        }
+
+        if (i == region->n_rects) {
+            if (region->n_rects < TWIN_REGION_MAX_RECTS) {
+                region->rects[region->n_rects++] = rect;
+                return;
+            }
+            i = best;
+        }
+
+        /* fold entry i into the new rectangle and retry against the rest */
+        rect = _twin_rect_union(&region->rects[i], &rect);
+        _twin_region_remove(region, i);
+    }
+}
@@ -0,0 +1,234 @@
+/*
+ * Twin - A Tiny Window System
+ * Copyright (c) 2025 National Cheng Kung University, Taiwan
+ * All rights reserved.
+ */
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "twin_private.h"
+
+/*
+ * Band-parallel screen update
+ *
+ * A damaged rectangle is cut into horizontal bands of
+ * CONFIG_SCREEN_THREADS_BAND scanlines. Workers claim bands in order and
+ * compose them into a ring of slot buffers, while the updating thread hands
+ * finished bands to put_span strictly from top to bottom, so backends still
+ * see one scanline at a time in order and need no locking. The updating
+ * thread composes bands itself while it waits, and a slot is only reused once
+ * its band has been emitted.
+ */
+
+#define BAND_ROWS CONFIG_SCREEN_THREADS_BAND
+
+struct _twin_screen_threads {
+    twin_screen_t *screen;
+    pthread_t workers[CONFIG_SCREEN_THREADS_MAX - 1];
+    int n_workers;
+    pthread_mutex_t lock;
+    pthread_cond_t work_ready; /* a band may be claimed, or quit is set */
+    pthread_cond_t band_done;  /* a band was composed */
+    bool quit;
+
+    /* current job, guarded by lock */
+    twin_coord_t left, right, top, bottom;
+    int n_bands; /* bands in the job */
+    int next;    /* next band to claim */
+    int emitted; /* bands already passed to put_span */
+
+    /* slot ring */
+    int n_slots;
+    int *slot_band; /* band held by each slot, -1 while composing */
+    twin_argb32_t *pixels;
+    twin_coord_t capacity; /* pixels per slot row */
+};
+
+typedef struct _twin_screen_threads twin_screen_threads_t;
+
+/* Called with the lock held */
+static bool twin_screen_threads_claim(twin_screen_threads_t *t, int *band)
+{
+    if (t->next >= t->n_bands || t->next >= t->emitted + t->n_slots)
+        return false;
+    *band = t->next++;
+    t->slot_band[*band % t->n_slots] = -1;
+    return true;
+}
+
+static twin_argb32_t *twin_screen_threads_slot(twin_screen_threads_t *t,
+                                               int band)
+{
+    return t->pixels + (twin_area_t) (band % t->n_slots) * BAND_ROWS *
+                           t->capacity;
+}
+
+/* Called with the lock held; drops it while composing */
+static void twin_screen_threads_compose(twin_screen_threads_t *t, int band)
+{
+    twin_argb32_t *span = twin_screen_threads_slot(t, band);
+    twin_coord_t y = t->top + band * BAND_ROWS;
+    twin_coord_t bottom = t->bottom;
+
+    if (bottom > y + BAND_ROWS)
+        bottom = y + BAND_ROWS;
+
+    pthread_mutex_unlock(&t->lock);
+    for (; y < bottom; y++, span += t->capacity)
+        _twin_screen_compose_span(t->screen, span, y, t->left, t->right);
+    pthread_mutex_lock(&t->lock);
+
+    t->slot_band[band % t->n_slots] = band;
+    pthread_cond_signal(&t->band_done);
+}
+
+static void *twin_screen_threads_worker(void *arg)
+{
+    twin_screen_threads_t *t = arg;
+    int band;
+
+    pthread_mutex_lock(&t->lock);
+    while (!t->quit) {
+        if (twin_screen_threads_claim(t, &band))
+            twin_screen_threads_compose(t, band);
+        else
+            pthread_cond_wait(&t->work_ready, &t->lock);
+    }
+    pthread_mutex_unlock(&t->lock);
+    return NULL;
+}
+
+static twin_screen_threads_t *twin_screen_threads_create(twin_screen_t *screen)
+{
+    twin_screen_threads_t *t = calloc(1, sizeof(twin_screen_threads_t));
+    long n_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    int i;
+
+    if (!t)
+        return NULL;
+    t->screen = screen;
+
+    if (n_cpus > CONFIG_SCREEN_THREADS_MAX)
+        n_cpus = CONFIG_SCREEN_THREADS_MAX;
+    /* A single core keeps the serial path; the pool stays empty. */
+    if (n_cpus < 2)
+        return t;
+
+    t->n_slots = 2 * n_cpus;
+    t->slot_band = malloc(t->n_slots * sizeof(int));
+    if (!t->slot_band)
+        return t;
+
+    pthread_mutex_init(&t->lock, NULL);
+    pthread_cond_init(&t->work_ready, NULL);
+    pthread_cond_init(&t->band_done, NULL);
+    for (i = 0; i < n_cpus - 1; i++) {
+        if (pthread_create(&t->workers[i], NULL, twin_screen_threads_worker,
+                           t)) {
+            log_warn("Failed to start screen update thread %d", i);
+            break;
+        }
+    }
+    t->n_workers = i;
+    return t;
+}
+
+void _twin_screen_threads_destroy(twin_screen_t *screen)
+{
+    twin_screen_threads_t *t = screen->threads;
+    int i;
+
+    if (!t)
+        return;
+    if (t->slot_band) {
+        pthread_mutex_lock(&t->lock);
+        t->quit = true;
+        pthread_cond_broadcast(&t->work_ready);
+        pthread_mutex_unlock(&t->lock);
+        for (i = 0; i < t->n_workers; i++)
+            pthread_join(t->workers[i], NULL);
+        pthread_cond_destroy(&t->band_done);
+        pthread_cond_destroy(&t->work_ready);
+        pthread_mutex_destroy(&t->lock);
+    }
+    free(t->pixels);
+    free(t->slot_band);
+    free(t);
+    screen->threads = NULL;
+}
+
+bool _twin_screen_threads_update(twin_screen_t *screen,
+                                 twin_coord_t left,
+                                 twin_coord_t top,
+                                 twin_coord_t right,
+                                 twin_coord_t bottom)
+{
+    twin_screen_threads_t *t = screen->threads;
+    twin_coord_t width = right - left;
+    int n_bands = (bottom - top + BAND_ROWS - 1) / BAND_ROWS;
+    int band, i;
+
+    if (!t) {
+        t = screen->threads = twin_screen_threads_create(screen);
+        if (!t)
+            return false;
+    }
+    if (!t->n_workers || n_bands < 2)
+        return false;
+
+    /* No worker is composing between jobs, so the ring may be resized */
+    if (t->capacity < width) {
+        twin_argb32_t *pixels =
+            realloc(t->pixels, (twin_area_t) t->n_slots * BAND_ROWS * width *
+                                   sizeof(twin_argb32_t));
+        if (!pixels)
+            return false;
+        t->pixels = pixels;
+        t->capacity = width;
+    }
+
+    pthread_mutex_lock(&t->lock);
+    t->left = left;
+    t->right = right;
+    t->top = top;
+    t->bottom = bottom;
+    t->n_bands = n_bands;
+    t->next = 0;
+    t->emitted = 0;
+    for (i = 0; i < t->n_slots; i++)
+        t->slot_band[i] = -1;
+    pthread_cond_broadcast(&t->work_ready);
+
+    for (i = 0; i < n_bands; i++) {
+        twin_argb32_t *span;
+        twin_coord_t y, y_end;
+
+        /* help out until the next band in order is ready */
+        while (t->slot_band[i % t->n_slots] != i) {
+            if (twin_screen_threads_claim(t, &band))
+                twin_screen_threads_compose(t, band);
+            else
+                pthread_cond_wait(&t->band_done, &t->lock);
+        }
+        pthread_mutex_unlock(&t->lock);
+
+        span = twin_screen_threads_slot(t, i);
+        y = top + i * BAND_ROWS;
+        y_end = bottom;
+        if (y_end > y + BAND_ROWS)
+            y_end = y + BAND_ROWS;
+        _twin_profile_begin(TWIN_PROFILE_PUT_SPAN);
+        for (; y < y_end; y++, span += t->capacity)
+            (*screen->put_span)(left, y, right, span, screen->closure);
+        _twin_profile_end(TWIN_PROFILE_PUT_SPAN);
+
+        pthread_mutex_lock(&t->lock);
+        t->emitted++;
+        pthread_cond_broadcast(&t->work_ready);
+    }
+    t->n_bands = 0;
+    pthread_mutex_unlock(&t->lock);
+    return true;
+}
@@ -23,8 +23,7 @@ twin_screen_t *twin_screen_create(twin_coord_t width,
     screen->bottom = 0;
     screen->width = width;
     screen->height = height;
-    screen->damage.left = screen->damage.right = 0;
-    screen->damage.top = screen->damage.bottom = 0;
+    _twin_region_clear(&screen->damage);
     screen->damaged = NULL;
     screen->damaged_closure = NULL;
     screen->disable = 0;
@@ -41,6 +40,10 @@ void twin_screen_destroy(twin_screen_t *screen)
 {
     while (screen->bottom)
         twin_pixmap_hide(screen->bottom);
+#if defined(CONFIG_SCREEN_THREADS)
+    _twin_screen_threads_destroy(screen);
+#endif
+    _twin_profile_destroy(screen);
     free(screen);
 }
 
@@ -55,8 +58,7 @@ void twin_screen_register_damaged(twin_screen_t *screen,
 void twin_screen_enable_update(twin_screen_t *screen)
 {
     if (--screen->disable == 0) {
-        if (screen->damage.left < screen->damage.right &&
-            screen->damage.top < screen->damage.bottom) {
+        if (!_twin_region_is_empty(&screen->damage)) {
             if (screen->damaged)
                 (*screen->damaged)(screen->damaged_closure);
         }
@@ -83,21 +85,7 @@ void twin_screen_damage(twin_screen_t *screen,
     if (bottom > screen->height)
         bottom = screen->height;
 
-    if (screen->damage.left == screen->damage.right) {
-        screen->damage.left = left;
-        screen->damage.right = right;
-        screen->damage.top = top;
-        screen->damage.bottom = bottom;
-    } else {
-        if (left < screen->damage.left)
-            screen->damage.left = left;
-        if (top < screen->damage.top)
-            screen->damage.top = top;
-        if (screen->damage.right < right)
-            screen->damage.right = right;
-        if (screen->damage.bottom < bottom)
-            screen->damage.bottom = bottom;
-    }
+    _twin_region_union_rect(&screen->damage, left, top, right, bottom);
     if (screen->damaged && !screen->disable)
         (*screen->damaged)(screen->damaged_closure);
 }
@@ -113,8 +101,7 @@ void twin_screen_resize(twin_screen_t *screen,
 
 bool twin_screen_damaged(twin_screen_t *screen)
 {
-    return (screen->damage.left < screen->damage.right &&
-            screen->damage.top < screen->damage.bottom);
+    return !_twin_region_is_empty(&screen->damage);
 }
 
 static void twin_screen_span_pixmap(twin_screen_t maybe_unused *screen,
@@ -152,75 +139,199 @@ static void twin_screen_span_pixmap(twin_screen_t maybe_unused *screen,
         op32(dst, src, p_right - p_left);
 }
 
-void twin_screen_update(twin_screen_t *screen)
+static void twin_screen_span_background(twin_screen_t *screen,
+                                       twin_argb32_t *span,
+                                       twin_coord_t y,
+                                       twin_coord_t left,
+                                       twin_coord_t right)
 {
-    twin_coord_t left = screen->damage.left;
-    twin_coord_t top = screen->damage.top;
-    twin_coord_t right = screen->damage.right;
-    twin_coord_t bottom = screen->damage.bottom;
-    twin_src_op pop16, pop32, bop32;
+    twin_src_op bop32 = _twin_vec_argb32_source_argb32;
+
+    if (screen->background) {
+        twin_pointer_t dst;
+        twin_source_u src;
+        twin_coord_t p_left;
+        twin_coord_t m_left;
+        twin_coord_t p_this;
+        twin_coord_t p_width = screen->background->width;
+        twin_coord_t p_y = y % screen->background->height;
+
+        for (p_left = left; p_left < right; p_left += p_this) {
+            dst.argb32 = span + (p_left - left);
+            m_left = p_left % p_width;
+            p_this = p_width - m_left;
+            if (p_left + p_this > right)
+                p_this = right - p_left;
+            src.p = twin_pixmap_pointer(screen->background, m_left, p_y);
+            bop32(dst, src, p_this);
+        }
+    } else
+        memset(span, 0xff, (right - left) * sizeof(twin_argb32_t));
+}
 
-    pop16 = _twin_rgb16_source_argb32;
-    pop32 = _twin_argb32_over_argb32;
-    bop32 = _twin_argb32_source_argb32;
+/* Blend a pixmap of the stack, and the drop shadow under it, over span */
+static void twin_screen_span_layer(twin_screen_t *screen,
+                                   twin_argb32_t *span,
+                                   twin_pixmap_t *p,
+                                   twin_coord_t y,
+                                   twin_coord_t left,
+                                   twin_coord_t right)
+{
+#if defined(CONFIG_DROP_SHADOW)
+    if (p->shadow && p->window)
+        _twin_window_span_shadow(p->window, span, y, left, right);
+#endif
+    twin_screen_span_pixmap(screen, span, p, y, left, right,
+                            _twin_vec_rgb16_source_argb32,
+                            _twin_vec_argb32_over_argb32);
+}
 
-    if (right > screen->width)
-        right = screen->width;
-    if (bottom > screen->height)
-        bottom = screen->height;
+/*
+ * Compose [left, right) of scanline y into span.
+ *
+ * Walk the stack top-down for the first pixmap whose opacity hint covers part
+ * of the span. That part is copied straight from it and only the pixmaps above
+ * are blended on top; the background and everything underneath are never
+ * touched. The uncovered parts on either side are handled the same way, so the
+ * work depends on what is visible rather than on the depth of the stack.
+ */
+static void twin_screen_span_visible(twin_screen_t *screen,
+                                     twin_argb32_t *span,
+                                     twin_coord_t y,
+                                     twin_coord_t left,
+                                     twin_coord_t right)
+{
+    twin_pixmap_t *p, *q;
+    twin_coord_t o_left = left, o_right = right;
+
+    for (p = screen->top; p; p = p->down) {
+        if (y < p->y + p->opaque.top || p->y + p->opaque.bottom <= y)
+            continue;
+        o_left = p->x + p->opaque.left;
+        if (o_left < left)
+            o_left = left;
+        o_right = p->x + p->opaque.right;
+        if (o_right > right)
+            o_right = right;
+        if (o_left < o_right)
+            break;
+    }
+
+    if (!p) {
+        twin_screen_span_background(screen, span, y, left, right);
+        for (q = screen->bottom; q; q = q->up)
+            twin_screen_span_layer(screen, span, q, y, left, right);
+        return;
+    }
+
+    if (left < o_left)
+        twin_screen_span_visible(screen, span, y, left, o_left);
 
-    if (!screen->disable && left < right && top < bottom) {
-        twin_argb32_t *span;
-        twin_pixmap_t *p;
-        twin_coord_t y;
-        twin_coord_t width = right - left;
-
-        screen->damage.left = screen->damage.right = 0;
-        screen->damage.top = screen->damage.bottom = 0;
-        /* FIXME: what is the maximum number of lines? */
-        span = malloc(width * sizeof(twin_argb32_t));
-        if (!span)
-            return;
-
-        if (screen->put_begin)
-            (*screen->put_begin)(left, top, right, bottom, screen->closure);
-        for (y = top; y < bottom; y++) {
-            if (screen->background) {
-                twin_pointer_t dst;
-                twin_source_u src;
-                twin_coord_t p_left;
-                twin_coord_t m_left;
-                twin_coord_t p_this;
-                twin_coord_t p_width = screen->background->width;
-                twin_coord_t p_y = y % screen->background->height;
-
-                for (p_left = left; p_left < right; p_left += p_this) {
-                    dst.argb32 = span + (p_left - left);
-                    m_left = p_left % p_width;
-                    p_this = p_width - m_left;
-                    if (p_left + p_this > right)
-                        p_this = right - p_left;
-                    src.p =
-                        twin_pixmap_pointer(screen->background, m_left, p_y);
-                    bop32(dst, src, p_this);
-                }
-            } else
-                memset(span, 0xff, width * sizeof(twin_argb32_t));
-
-            for (p = screen->bottom; p; p = p->up)
-                twin_screen_span_pixmap(screen, span, p, y, left, right, pop16,
-                                        pop32);
+    twin_screen_span_pixmap(screen, span + (o_left - left), p, y, o_left,
+                            o_right, _twin_vec_rgb16_source_argb32,
+                            _twin_vec_argb32_source_argb32);
+    for (q = p->up; q; q = q->up)
+        twin_screen_span_layer(screen, span + (o_left - left), q, y, o_left,
+                               o_right);
+
+    if (o_right < right)
+        twin_screen_span_visible(screen, span + (o_right - left), y, o_right,
+                                 right);
+}
+
+void _twin_screen_compose_span(twin_screen_t *screen,
+                               twin_argb32_t *span,
+                               twin_coord_t y,
+                               twin_coord_t left,
+                               twin_coord_t right)
+{
+    twin_screen_span_visible(screen, span, y, left, right);
 
 #if defined(CONFIG_CURSOR)
-            if (screen->cursor)
-                twin_screen_span_pixmap(screen, span, screen->cursor, y, left,
-                                        right, pop16, pop32);
+    if (screen->cursor)
+        twin_screen_span_pixmap(screen, span, screen->cursor, y, left, right,
+                                _twin_vec_rgb16_source_argb32,
+                                _twin_vec_argb32_over_argb32);
+#endif
+}
+
+static void twin_screen_update_rect(twin_screen_t *screen,
+                                    twin_argb32_t *span,
+                                    twin_coord_t left,
+                                    twin_coord_t top,
+                                    twin_coord_t right,
+                                    twin_coord_t bottom)
+{
+    twin_coord_t y;
+
+    if (screen->put_begin)
+        (*screen->put_begin)(left, top, right, bottom, screen->closure);
+
+    _twin_profile_count(TWIN_PROFILE_PIXELS,
+                        (uint64_t) (right - left) * (bottom - top));
+    _twin_profile_count(TWIN_PROFILE_SPANS, bottom - top);
+
+#if defined(CONFIG_SCREEN_THREADS)
+    if (_twin_screen_threads_update(screen, left, top, right, bottom))
+        return;
 #endif
 
-            (*screen->put_span)(left, y, right, span, screen->closure);
-        }
-        free(span);
+    for (y = top; y < bottom; y++) {
+        _twin_screen_compose_span(screen, span, y, left, right);
+        _twin_profile_begin(TWIN_PROFILE_PUT_SPAN);
+        (*screen->put_span)(left, y, right, span, screen->closure);
+        _twin_profile_end(TWIN_PROFILE_PUT_SPAN);
+    }
+}
+
+void twin_screen_update(twin_screen_t *screen)
+{
+    twin_region_t damage;
+    twin_argb32_t *span;
+    twin_arena_mark_t mark;
+    twin_coord_t width = 0;
+    int i;
+
+    if (screen->disable || _twin_region_is_empty(&screen->damage))
+        return;
+
+    /* Clamp to the current output size, which may have shrunk since the
+     * damage was recorded.
+     */
+    damage = screen->damage;
+    _twin_region_clear(&screen->damage);
+    for (i = 0; i < damage.n_rects; i++) {
+        twin_rect_t *r = &damage.rects[i];
+
+        if (r->right > screen->width)
+            r->right = screen->width;
+        if (r->bottom > screen->height)
+            r->bottom = screen->height;
+        if (r->left < r->right && width < r->right - r->left)
+            width = r->right - r->left;
+    }
+    if (!width)
+        return;
+
+    /* one span serves every rectangle */
+    mark = _twin_arena_mark();
+    span = _twin_arena_alloc(width * sizeof(twin_argb32_t));
+    if (!span) {
+        _twin_arena_release(mark);
+        return;
+    }
+
+    _twin_profile_begin(TWIN_PROFILE_COMPOSE);
+    for (i = 0; i < damage.n_rects; i++) {
+        twin_rect_t *r = &damage.rects[i];
+
+        if (r->left < r->right && r->top < r->bottom)
+            twin_screen_update_rect(screen, span, r->left, r->top, r->right,
+                                    r->bottom);
     }
+    _twin_profile_end(TWIN_PROFILE_COMPOSE);
+    _twin_profile_frame(screen);
+    _twin_arena_release(mark);
 }
 
 void twin_screen_set_active(twin_screen_t *screen, twin_pixmap_t *pixmap)
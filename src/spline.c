@@ -146,8 +146,9 @@ void _twin_path_scurve(twin_path_t *path,
         .c = {.x = x2, .y = y2},
         .d = {.x = x3, .y = y3},
     };
-    _twin_spline_decompose(path, &spline,
-                           TWIN_SFIXED_TOLERANCE * TWIN_SFIXED_TOLERANCE);
+    twin_dfixed_t tolerance = _twin_path_tolerance(path);
+
+    _twin_spline_decompose(path, &spline, tolerance * tolerance);
 }
 
 void twin_path_curve(twin_path_t *path,
@@ -0,0 +1,371 @@
+/*
+ * Twin - A Tiny Window System
+ * Copyright (c) 2025 National Cheng Kung University, Taiwan
+ * All rights reserved.
+ */
+
+#include <stdint.h>
+
+#include "twin_private.h"
+
+/*
+ * Offsetting stroker
+ *
+ * Rather than convolving every vertex with a pen polygon, the outline is
+ * built straight from the segment normals. The geometry is worked out in the
+ * user space of the stroke, where the pen is a circle of radius pen_width / 2,
+ * and each offset is mapped back through the linear part of the matrix, so a
+ * scaled or skewed pen becomes the matching ellipse.
+ *
+ * An open subpath becomes one contour: down one side, around the end cap,
+ * back up the other side and around the start cap. A closed subpath becomes
+ * two, one per side. The outer side of each turn gets the join while the
+ * inner side detours through the vertex itself, which the nonzero fill
+ * covers over.
+ */
+
+#define TWIN_MITER_LIMIT 10 /* the PostScript default */
+#define TWIN_ARC_DEPTH 8    /* at most 2^8 chords per half turn */
+
+typedef struct _twin_fvec {
+    float x, y;
+} twin_fvec_t;
+
+typedef struct _twin_outline {
+    twin_path_t *path;
+    float m[2][2];   /* user unit vector to device offset, in sfixed units */
+    float inv[2][2]; /* device direction to user direction, unscaled */
+    float radius;    /* widest device offset, in sfixed units */
+    float flat;      /* |a + b|^2 above which the arc from a to b is a chord */
+    twin_cap_t cap;
+    twin_join_t join;
+} twin_outline_t;
+
+/* 1 / sqrt(f) without libm: a bit level guess refined by Newton's method */
+static float _twin_rsqrtf(float f)
+{
+    union {
+        float f;
+        uint32_t i;
+    } u = {.f = f};
+
+    u.i = 0x5f3759df - (u.i >> 1);
+    for (int i = 0; i < 3; i++)
+        u.f *= 1.5f - 0.5f * f * u.f * u.f;
+    return u.f;
+}
+
+static float _twin_sqrtf(float f)
+{
+    return f > 0 ? f * _twin_rsqrtf(f) : 0;
+}
+
+static twin_fvec_t _twin_fvec_perp(twin_fvec_t v)
+{
+    return (twin_fvec_t) {-v.y, v.x};
+}
+
+static twin_fvec_t _twin_fvec_neg(twin_fvec_t v)
+{
+    return (twin_fvec_t) {-v.x, -v.y};
+}
+
+static bool _twin_outline_init(twin_outline_t *o,
+                               twin_path_t *path,
+                               twin_path_t *stroke,
+                               twin_fixed_t pen_width)
+{
+    const twin_matrix_t *matrix = &stroke->state.matrix;
+    float r = (float) pen_width / (2 * TWIN_FIXED_ONE) * TWIN_SFIXED_ONE;
+    float det, e, s2, c;
+
+    for (int i = 0; i < 2; i++)
+        for (int j = 0; j < 2; j++)
+            o->m[i][j] = r * matrix->m[i][j] / TWIN_FIXED_ONE;
+    det = o->m[0][0] * o->m[1][1] - o->m[1][0] * o->m[0][1];
+    if (r <= 0 || det == 0)
+        return false;
+
+    /* the adjugate, signed so that it keeps the orientation of the inverse */
+    c = det < 0 ? -1 : 1;
+    o->inv[0][0] = c * o->m[1][1];
+    o->inv[1][0] = -c * o->m[1][0];
+    o->inv[0][1] = -c * o->m[0][1];
+    o->inv[1][1] = c * o->m[0][0];
+
+    /* largest singular value of the scaled matrix */
+    e = o->m[0][0] * o->m[0][0] + o->m[0][1] * o->m[0][1] +
+        o->m[1][0] * o->m[1][0] + o->m[1][1] * o->m[1][1];
+    s2 = (e + _twin_sqrtf(e * e - 4 * det * det)) / 2;
+    o->radius = _twin_sqrtf(s2);
+
+    /* chords may stray from the pen by the tolerance of the stroke */
+    c = 1 - _twin_path_tolerance(stroke) / o->radius;
+    o->flat = c > 0 ? 4 * c * c : 0;
+
+    o->path = path;
+    o->cap = stroke->state.cap_style;
+    o->join = stroke->state.join_style;
+    return true;
+}
+
+static twin_sfixed_t _twin_outline_coord(float f)
+{
+    if (f >= TWIN_SFIXED_MAX)
+        return TWIN_SFIXED_MAX;
+    if (f <= TWIN_SFIXED_MIN)
+        return TWIN_SFIXED_MIN;
+    return (twin_sfixed_t) (f < 0 ? f - 0.5f : f + 0.5f);
+}
+
+static twin_spoint_t _twin_outline_point(twin_outline_t *o,
+                                         twin_spoint_t p,
+                                         twin_fvec_t v)
+{
+    return (twin_spoint_t) {
+        .x = _twin_outline_coord(p.x + o->m[0][0] * v.x + o->m[1][0] * v.y),
+        .y = _twin_outline_coord(p.y + o->m[0][1] * v.x + o->m[1][1] * v.y),
+    };
+}
+
+/* Move to p offset by the user-space vector v, in pen radii */
+static void _twin_outline_move(twin_outline_t *o,
+                               twin_spoint_t p,
+                               twin_fvec_t v)
+{
+    twin_spoint_t q = _twin_outline_point(o, p, v);
+
+    _twin_path_smove(o->path, q.x, q.y);
+}
+
+static void _twin_outline_draw(twin_outline_t *o,
+                               twin_spoint_t p,
+                               twin_fvec_t v)
+{
+    twin_spoint_t q = _twin_outline_point(o, p, v);
+
+    _twin_path_sdraw(o->path, q.x, q.y);
+}
+
+/* Follow the pen around p from unit vector a to b, less than a half turn on */
+static void _twin_outline_arc(twin_outline_t *o,
+                              twin_spoint_t p,
+                              twin_fvec_t a,
+                              twin_fvec_t b,
+                              int depth)
+{
+    twin_fvec_t h = {a.x + b.x, a.y + b.y};
+    float hh = h.x * h.x + h.y * h.y;
+
+    if (depth > 0 && hh < o->flat) {
+        float k = _twin_rsqrtf(hh);
+
+        h.x *= k;
+        h.y *= k;
+        _twin_outline_arc(o, p, a, h, depth - 1);
+        _twin_outline_arc(o, p, h, b, depth - 1);
+        return;
+    }
+    _twin_outline_draw(o, p, b);
+}
+
+/* As above, but passing through ahead when a and b are a half turn apart */
+static void _twin_outline_round(twin_outline_t *o,
+                                twin_spoint_t p,
+                                twin_fvec_t a,
+                                twin_fvec_t b,
+                                twin_fvec_t ahead)
+{
+    twin_fvec_t h = {a.x + b.x, a.y + b.y};
+    float hh = h.x * h.x + h.y * h.y;
+
+    if (hh >= o->flat) {
+        _twin_outline_draw(o, p, b);
+        return;
+    }
+    if (hh < 1e-4f) {
+        h = ahead;
+    } else {
+        float k = _twin_rsqrtf(hh);
+
+        h.x *= k;
+        h.y *= k;
+    }
+    _twin_outline_arc(o, p, a, h, TWIN_ARC_DEPTH);
+    _twin_outline_arc(o, p, h, b, TWIN_ARC_DEPTH);
+}
+
+/*
+ * Join the offset of the segment coming into p along a to the one leaving
+ * along b. The current point is p offset by the normal of a.
+ */
+static void _twin_outline_join(twin_outline_t *o,
+                               twin_spoint_t p,
+                               twin_fvec_t a,
+                               twin_fvec_t b)
+{
+    twin_fvec_t na = _twin_fvec_perp(a);
+    twin_fvec_t nb = _twin_fvec_perp(b);
+    float cross = a.x * b.y - a.y * b.x;
+    float dot = a.x * b.x + a.y * b.y;
+
+    if (cross > 0) {
+        /* inner side; a turn within the tolerance needs no detour */
+        if (2 + 2 * dot < o->flat)
+            _twin_outline_draw(o, p, (twin_fvec_t) {0, 0});
+        _twin_outline_draw(o, p, nb);
+        return;
+    }
+
+    switch (o->join) {
+    case TwinJoinMiter:
+        /* the miter is 1 / cos(angle / 2) = sqrt(2 / (1 + dot)) long */
+        if ((1 + dot) * TWIN_MITER_LIMIT * TWIN_MITER_LIMIT >= 2) {
+            float k = 1 / (1 + dot);
+
+            _twin_outline_draw(
+                o, p, (twin_fvec_t) {(na.x + nb.x) * k, (na.y + nb.y) * k});
+        }
+        break;
+    case TwinJoinRound:
+        _twin_outline_round(o, p, na, nb, a);
+        return;
+    case TwinJoinBevel:
+        break;
+    }
+    _twin_outline_draw(o, p, nb);
+}
+
+/*
+ * Cap the end p of a segment running along a, from its left offset to its
+ * right one.
+ */
+static void _twin_outline_cap(twin_outline_t *o, twin_spoint_t p, twin_fvec_t a)
+{
+    twin_fvec_t n = _twin_fvec_perp(a);
+    twin_fvec_t m = _twin_fvec_neg(n);
+
+    switch (o->cap) {
+    case TwinCapProjecting:
+        _twin_outline_draw(o, p, (twin_fvec_t) {n.x + a.x, n.y + a.y});
+        _twin_outline_draw(o, p, (twin_fvec_t) {m.x + a.x, m.y + a.y});
+        break;
+    case TwinCapRound:
+        _twin_outline_round(o, p, n, m, a);
+        return;
+    case TwinCapButt:
+        break;
+    }
+    _twin_outline_draw(o, p, m);
+}
+
+/*
+ * Offset one side of the m segments between the points pt, walking them
+ * backwards when rev is set. The current point is the offset of the first.
+ */
+static void _twin_outline_side(twin_outline_t *o,
+                               const twin_spoint_t *pt,
+                               const twin_fvec_t *dir,
+                               int m,
+                               bool rev)
+{
+    twin_fvec_t prev = {0, 0};
+
+    for (int k = 0; k < m; k++) {
+        twin_fvec_t d = rev ? _twin_fvec_neg(dir[m - 1 - k]) : dir[k];
+
+        if (k > 0)
+            _twin_outline_join(o, rev ? pt[m - k] : pt[k], prev, d);
+        _twin_outline_draw(o, rev ? pt[m - k - 1] : pt[k + 1],
+                           _twin_fvec_perp(d));
+        prev = d;
+    }
+}
+
+static void _twin_outline_subpath(twin_outline_t *o,
+                                  const twin_spoint_t *points,
+                                  int npoints)
+{
+    twin_arena_mark_t mark = _twin_arena_mark();
+    twin_spoint_t *pt = _twin_arena_alloc(npoints * sizeof(twin_spoint_t));
+    twin_fvec_t *dir = _twin_arena_alloc(npoints * sizeof(twin_fvec_t));
+    int m = 0;
+
+    if (!pt || !dir)
+        goto done;
+
+    /* drop repeated points, keeping the user-space direction of each segment */
+    pt[0] = points[0];
+    for (int i = 1; i < npoints; i++) {
+        float dx = points[i].x - pt[m].x;
+        float dy = points[i].y - pt[m].y;
+        twin_fvec_t u;
+        float k;
+
+        if (dx == 0 && dy == 0)
+            continue;
+        u.x = o->inv[0][0] * dx + o->inv[1][0] * dy;
+        u.y = o->inv[0][1] * dx + o->inv[1][1] * dy;
+        k = _twin_rsqrtf(u.x * u.x + u.y * u.y);
+        dir[m].x = u.x * k;
+        dir[m].y = u.y * k;
+        pt[++m] = points[i];
+    }
+
+    if (m == 0)
+        goto done;
+    if (m > 1 && pt[m].x == pt[0].x && pt[m].y == pt[0].y) {
+        _twin_outline_move(o, pt[0], _twin_fvec_perp(dir[0]));
+        _twin_outline_side(o, pt, dir, m, false);
+        _twin_outline_join(o, pt[0], dir[m - 1], dir[0]);
+        twin_path_close(o->path);
+        _twin_outline_move(o, pt[m],
+                           _twin_fvec_perp(_twin_fvec_neg(dir[m - 1])));
+        _twin_outline_side(o, pt, dir, m, true);
+        _twin_outline_join(o, pt[0], _twin_fvec_neg(dir[0]),
+                           _twin_fvec_neg(dir[m - 1]));
+    } else {
+        _twin_outline_move(o, pt[0], _twin_fvec_perp(dir[0]));
+        _twin_outline_side(o, pt, dir, m, false);
+        _twin_outline_cap(o, pt[m], dir[m - 1]);
+        _twin_outline_side(o, pt, dir, m, true);
+        _twin_outline_cap(o, pt[0], _twin_fvec_neg(dir[0]));
+    }
+    twin_path_close(o->path);
+done:
+    _twin_arena_release(mark);
+}
+
+void twin_path_stroke(twin_path_t *path,
+                      twin_path_t *stroke,
+                      twin_fixed_t pen_width)
+{
+    twin_outline_t o;
+    int p = 0;
+
+    if (!_twin_outline_init(&o, path, stroke, pen_width))
+        return;
+
+    for (int s = 0; s <= stroke->nsublen; s++) {
+        int sublen = s == stroke->nsublen ? stroke->npoints : stroke->sublen[s];
+
+        if (sublen - p > 1)
+            _twin_outline_subpath(&o, stroke->points + p, sublen - p);
+        p = sublen;
+    }
+}
+
+twin_coord_t _twin_path_stroke_reach(twin_path_t *stroke,
+                                     twin_fixed_t pen_width)
+{
+    twin_outline_t o;
+    float reach;
+
+    if (!_twin_outline_init(&o, NULL, stroke, pen_width))
+        return 0;
+
+    /* projecting caps reach sqrt(2) radii out, miters up to the limit */
+    reach = o.radius / TWIN_SFIXED_ONE;
+    reach *= o.join == TwinJoinMiter ? TWIN_MITER_LIMIT : 1.5f;
+    return reach < 4096 ? (twin_coord_t) reach + 1 : 4096;
+}
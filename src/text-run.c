@@ -0,0 +1,180 @@
+/*
+ * Twin - A Tiny Window System
+ * Copyright (c) 2025 National Cheng Kung University, Taiwan
+ * All rights reserved.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "twin_private.h"
+
+/*
+ * Text runs
+ *
+ * A run keeps a string together with its metrics and the coverage mask of the
+ * whole string, rasterized in one pass over the edges of every glyph. The mask
+ * is rendered at the subpixel part of the paint origin and reused for as long
+ * as the text, the font and that subpixel offset stay the same; painting a
+ * run is then a single composite.
+ */
+
+struct _twin_text_run {
+    const twin_font_t *font;
+    unsigned int font_generation; /* tells apart fonts at a reused address */
+    char *string;
+    twin_fixed_t font_size;
+    twin_style_t font_style;
+    twin_text_metrics_t metrics;
+
+    twin_pixmap_t *mask;
+    twin_sfixed_t mask_x, mask_y; /* subpixel origin of the mask */
+    twin_coord_t left, top;       /* mask offset from the whole-pixel origin */
+    bool rendered;                /* mask matches the text, may be NULL */
+};
+
+twin_text_run_t *twin_text_run_create(const char *string,
+                                      twin_fixed_t font_size,
+                                      twin_style_t font_style)
+{
+    twin_text_run_t *run = calloc(1, sizeof(twin_text_run_t));
+
+    if (!run)
+        return NULL;
+    if (!twin_text_run_set(run, string, font_size, font_style)) {
+        free(run);
+        return NULL;
+    }
+    return run;
+}
+
+void twin_text_run_destroy(twin_text_run_t *run)
+{
+    if (!run)
+        return;
+    if (run->mask)
+        twin_pixmap_destroy(run->mask);
+    free(run->string);
+    free(run);
+}
+
+static void _twin_text_run_invalidate(twin_text_run_t *run)
+{
+    if (run->mask)
+        twin_pixmap_destroy(run->mask);
+    run->mask = NULL;
+    run->rendered = false;
+}
+
+bool twin_text_run_set(twin_text_run_t *run,
+                       const char *string,
+                       twin_fixed_t font_size,
+                       twin_style_t font_style)
+{
+    twin_path_t *path;
+
+    if (run->string && !strcmp(run->string, string) &&
+        run->font == g_twin_font &&
+        run->font_generation == _twin_font_generation &&
+        run->font_size == font_size && run->font_style == font_style)
+        return true;
+
+    if (!run->string || strcmp(run->string, string)) {
+        char *copy = malloc(strlen(string) + 1);
+
+        if (!copy)
+            return false;
+        strcpy(copy, string);
+        free(run->string);
+        run->string = copy;
+    }
+    run->font = g_twin_font;
+    run->font_generation = _twin_font_generation;
+    run->font_size = font_size;
+    run->font_style = font_style;
+    _twin_text_run_invalidate(run);
+
+    path = twin_path_create();
+    if (!path)
+        return false;
+    twin_path_set_font_size(path, font_size);
+    twin_path_set_font_style(path, font_style);
+    twin_text_metrics_utf8(path, string, &run->metrics);
+    twin_path_destroy(path);
+    return true;
+}
+
+/*
+ * Catch up with a change of g_twin_font since the run was set, including an
+ * unload and a load that happened to land at the same address
+ */
+static void _twin_text_run_validate(twin_text_run_t *run)
+{
+    if (run->font != g_twin_font ||
+        run->font_generation != _twin_font_generation)
+        twin_text_run_set(run, run->string, run->font_size, run->font_style);
+}
+
+void twin_text_run_metrics(twin_text_run_t *run, twin_text_metrics_t *m)
+{
+    _twin_text_run_validate(run);
+    *m = run->metrics;
+}
+
+static void _twin_text_run_render(twin_text_run_t *run,
+                                  twin_sfixed_t x,
+                                  twin_sfixed_t y)
+{
+    twin_path_t *path = twin_path_create();
+    twin_rect_t bounds;
+
+    _twin_text_run_invalidate(run);
+    run->mask_x = x;
+    run->mask_y = y;
+    if (!path)
+        return;
+
+    twin_path_set_font_size(path, run->font_size);
+    twin_path_set_font_style(path, run->font_style);
+    _twin_path_smove(path, x, y);
+    twin_path_utf8(path, run->string);
+
+    twin_path_bounds(path, &bounds);
+    if (bounds.left < bounds.right && bounds.top < bounds.bottom) {
+        run->mask = twin_pixmap_create(TWIN_A8, bounds.right - bounds.left,
+                                       bounds.bottom - bounds.top);
+        if (!run->mask) {
+            twin_path_destroy(path);
+            return;
+        }
+        twin_fill_path(run->mask, path, -bounds.left, -bounds.top);
+        run->left = bounds.left;
+        run->top = bounds.top;
+    }
+    twin_path_destroy(path);
+    run->rendered = true;
+}
+
+void twin_text_run_paint(twin_pixmap_t *dst,
+                         twin_argb32_t argb,
+                         twin_text_run_t *run,
+                         twin_fixed_t x,
+                         twin_fixed_t y)
+{
+    twin_sfixed_t sx = twin_fixed_to_sfixed(x);
+    twin_sfixed_t sy = twin_fixed_to_sfixed(y);
+    twin_operand_t src = {.source_kind = TWIN_SOLID, .u.argb = argb};
+    twin_operand_t msk = {.source_kind = TWIN_PIXMAP};
+
+    _twin_text_run_validate(run);
+    if (!run->rendered || run->mask_x != twin_sfixed_mod(sx) ||
+        run->mask_y != twin_sfixed_mod(sy))
+        _twin_text_run_render(run, twin_sfixed_mod(sx), twin_sfixed_mod(sy));
+    if (!run->mask)
+        return;
+
+    msk.u.pixmap = run->mask;
+    twin_composite(dst, twin_sfixed_trunc(sx) + run->left,
+                   twin_sfixed_trunc(sy) + run->top, &src, 0, 0, &msk, 0, 0,
+                   TWIN_OVER, run->mask->width, run->mask->height);
+}
@@ -5,59 +5,143 @@
  */
 
 #include <stdlib.h>
-#include <sys/time.h>
 #include <time.h>
 
 #include "twin_private.h"
 
-#define twin_time_compare(a, op, b) (((a) - (b)) op 0)
+/*
+ * Pending timeouts live in a binary min-heap ordered by expiry time, so
+ * scheduling, rescheduling and cancelling are O(log n). Ties are broken by
+ * insertion sequence, which keeps timeouts due at the same time in FIFO order.
+ */
+
+static twin_timeout_t **heap;
+static int heap_len, heap_size;
+static uint32_t sequence;
+
+/* timeout whose proc is running, and whether it was cleared meanwhile */
+static twin_timeout_t *running;
+static bool running_cleared;
 
+/* Milliseconds of CLOCK_MONOTONIC, counted from the first call */
 static twin_time_t twin_now(void)
 {
-    struct timeval tv;
-    gettimeofday(&tv, NULL);
-    return tv.tv_sec * 1000 + tv.tv_usec / 1000;
+    static struct timespec start;
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    if (!start.tv_sec && !start.tv_nsec)
+        start = ts;
+    return (twin_time_t) ((ts.tv_sec - start.tv_sec) * 1000 +
+                          (ts.tv_nsec - start.tv_nsec) / 1000000);
+}
+
+static bool _twin_timeout_before(const twin_timeout_t *a,
+                                 const twin_timeout_t *b)
+{
+    if (a->time != b->time)
+        return twin_time_compare(a->time, <, b->time);
+    return (int32_t) (a->sequence - b->sequence) < 0;
 }
 
-static twin_queue_t *head;
-static twin_time_t start;
+static void _twin_heap_set(int i, twin_timeout_t *timeout)
+{
+    heap[i] = timeout;
+    timeout->index = i;
+}
+
+static void _twin_heap_sift_up(int i)
+{
+    twin_timeout_t *timeout = heap[i];
+
+    while (i > 0) {
+        int parent = (i - 1) / 2;
+
+        if (!_twin_timeout_before(timeout, heap[parent]))
+            break;
+        _twin_heap_set(i, heap[parent]);
+        i = parent;
+    }
+    _twin_heap_set(i, timeout);
+}
 
-static twin_order_t _twin_timeout_order(twin_queue_t *a, twin_queue_t *b)
+static void _twin_heap_sift_down(int i)
 {
-    const twin_timeout_t *at = (twin_timeout_t *) a;
-    const twin_timeout_t *bt = (twin_timeout_t *) b;
-
-    if (twin_time_compare(at->time, <, bt->time))
-        return TWIN_AFTER;
-    if (twin_time_compare(at->time, >, bt->time))
-        return TWIN_BEFORE;
-    return TWIN_AT;
+    twin_timeout_t *timeout = heap[i];
+
+    for (;;) {
+        int child = 2 * i + 1;
+
+        if (child >= heap_len)
+            break;
+        if (child + 1 < heap_len &&
+            _twin_timeout_before(heap[child + 1], heap[child]))
+            child++;
+        if (!_twin_timeout_before(heap[child], timeout))
+            break;
+        _twin_heap_set(i, heap[child]);
+        i = child;
+    }
+    _twin_heap_set(i, timeout);
 }
 
-static void _twin_queue_timeout(twin_timeout_t *timeout, twin_time_t time)
+static bool _twin_heap_push(twin_timeout_t *timeout, twin_time_t time)
 {
+    if (heap_len == heap_size) {
+        int size = heap_size ? heap_size * 2 : 16;
+        twin_timeout_t **grown = realloc(heap, size * sizeof(*heap));
+
+        if (!grown)
+            return false;
+        heap = grown;
+        heap_size = size;
+    }
     timeout->time = time;
-    _twin_queue_remove(&head, &timeout->queue);
-    _twin_queue_insert(&head, _twin_timeout_order, &timeout->queue);
+    timeout->sequence = sequence++;
+    heap[heap_len] = timeout;
+    _twin_heap_sift_up(heap_len++);
+    return true;
+}
+
+static void _twin_heap_remove(twin_timeout_t *timeout)
+{
+    int i = timeout->index;
+    twin_timeout_t *last = heap[--heap_len];
+
+    timeout->index = -1;
+    if (last == timeout)
+        return;
+    _twin_heap_set(i, last);
+    if (i > 0 && _twin_timeout_before(last, heap[(i - 1) / 2]))
+        _twin_heap_sift_up(i);
+    else
+        _twin_heap_sift_down(i);
 }
 
 void _twin_run_timeout(void)
 {
     twin_time_t now = twin_now();
+    /* timeouts queued by this run wait for the next one */
+    uint32_t limit = sequence;
     twin_timeout_t *timeout;
     twin_time_t delay;
 
-    twin_timeout_t *first = (twin_timeout_t *) _twin_queue_set_order(&head);
-    for (timeout = first; timeout && twin_time_compare(now, >=, timeout->time);
-         timeout = (twin_timeout_t *) timeout->queue.order) {
+    while (heap_len) {
+        timeout = heap[0];
+        if (twin_time_compare(now, <, timeout->time) ||
+            (int32_t) (timeout->sequence - limit) >= 0)
+            break;
+
+        _twin_heap_remove(timeout);
+        running = timeout;
+        running_cleared = false;
         delay = (*timeout->proc)(now, timeout->closure);
-        if (delay >= 0) {
-            timeout->time = twin_now() + delay;
-            _twin_queue_reorder(&head, _twin_timeout_order, &timeout->queue);
-        } else
-            _twin_queue_delete(&head, &timeout->queue);
+        running = NULL;
+
+        if (delay < 0 || running_cleared ||
+            !_twin_heap_push(timeout, twin_now() + delay))
+            free(timeout);
     }
-    _twin_queue_review_order(&first->queue);
 }
 
 twin_timeout_t *twin_set_timeout(twin_timeout_proc_t timeout_proc,
@@ -68,28 +152,34 @@ twin_timeout_t *twin_set_timeout(twin_timeout_proc_t timeout_proc,
     if (!timeout)
         return NULL;
 
-    if (!start)
-        start = twin_now();
     timeout->delay = delay;
     timeout->proc = timeout_proc;
     timeout->closure = closure;
-    _twin_queue_timeout(timeout, twin_now() + delay);
+    if (!_twin_heap_push(timeout, twin_now() + delay)) {
+        free(timeout);
+        return NULL;
+    }
     return timeout;
 }
 
 void twin_clear_timeout(twin_timeout_t *timeout)
 {
-    _twin_queue_delete(&head, &timeout->queue);
+    /* a running timeout is released once its proc returns */
+    if (timeout == running) {
+        running_cleared = true;
+        return;
+    }
+    _twin_heap_remove(timeout);
+    free(timeout);
 }
 
 twin_time_t _twin_timeout_delay(void)
 {
-    if (head) {
-        const twin_timeout_t *thead = (twin_timeout_t *) head;
+    if (heap_len) {
         twin_time_t now = twin_now();
-        if (twin_time_compare(now, >=, thead->time))
+        if (twin_time_compare(now, >=, heap[0]->time))
             return 0;
-        return thead->time - now;
+        return heap[0]->time - now;
     }
     return -1;
 }
@@ -75,6 +75,71 @@ static void _twin_widget_paint(twin_widget_t *widget)
                              _twin_widget_height(widget), widget->radius);
 }
 
+/* Have widget painted again, with its own content unchanged */
+static void _twin_widget_queue_repaint(twin_widget_t *widget)
+{
+    while (widget->parent) {
+        if (widget->paint)
+            return;
+
+        widget->paint = true;
+        widget = &widget->parent->widget;
+    }
+    _twin_toplevel_queue_paint(widget);
+}
+
+/*
+ * Render widget into its cache by pointing its window at the cache for the
+ * duration of the paint, then copy the cache over the widget extents. Every
+ * pixel of the extents is either painted with TWIN_SOURCE or composited over
+ * the parent background the box lays under non-rectangular shapes, so copying
+ * the cache yields exactly what painting in place would.
+ */
+void _twin_widget_paint_child(twin_widget_t *widget, twin_event_t *event)
+{
+    twin_window_t *window = widget->window;
+    twin_pixmap_t *pixmap = window->pixmap;
+    twin_coord_t width = _twin_widget_width(widget);
+    twin_coord_t height = _twin_widget_height(widget);
+    twin_argb32_t bg = 0;
+    twin_operand_t src;
+
+    if (!widget->retained || width <= 0 || height <= 0) {
+        (*widget->dispatch)(widget, event);
+        return;
+    }
+
+    if (widget->shape != TwinShapeRectangle && widget->parent)
+        bg = widget->parent->widget.background;
+    if (widget->cache && (widget->cache->width != width ||
+                          widget->cache->height != height)) {
+        twin_pixmap_destroy(widget->cache);
+        widget->cache = NULL;
+    }
+    if (!widget->cache) {
+        widget->cache = twin_pixmap_create(pixmap->format, width, height);
+        if (!widget->cache) {
+            (*widget->dispatch)(widget, event);
+            return;
+        }
+        widget->dirty = true;
+    }
+
+    if (widget->dirty || widget->cache_bg != bg) {
+        twin_fill(widget->cache, bg, TWIN_SOURCE, 0, 0, width, height);
+        window->pixmap = widget->cache;
+        (*widget->dispatch)(widget, event);
+        window->pixmap = pixmap;
+        widget->cache_bg = bg;
+        widget->dirty = false;
+    }
+
+    src.source_kind = TWIN_PIXMAP;
+    src.u.pixmap = widget->cache;
+    twin_composite(pixmap, 0, 0, &src, 0, 0, NULL, 0, 0, TWIN_SOURCE, width,
+                   height);
+}
+
 twin_dispatch_result_t _twin_widget_dispatch(twin_widget_t *widget,
                                              twin_event_t *event)
 {
@@ -90,7 +155,15 @@ twin_dispatch_result_t _twin_widget_dispatch(twin_widget_t *widget,
         }
         break;
     case TwinEventConfigure:
-        widget->extents = event->u.configure.extents;
+        /* a widget that merely moved is repainted, not re-rendered */
+        if (widget->extents.left != event->u.configure.extents.left ||
+            widget->extents.top != event->u.configure.extents.top ||
+            widget->extents.right != event->u.configure.extents.right ||
+            widget->extents.bottom != event->u.configure.extents.bottom) {
+            widget->extents = event->u.configure.extents;
+            _twin_widget_queue_repaint(widget);
+        }
+        widget->configure = false;
         break;
     case TwinEventPaint:
         _twin_widget_paint(widget);
@@ -124,6 +197,7 @@ void _twin_widget_init(twin_widget_t *widget,
     widget->copy_geom = NULL;
     widget->paint = true;
     widget->layout = true;
+    widget->configure = true;
     widget->want_focus = false;
     widget->background = 0x00000000;
     widget->extents.left = widget->extents.top = 0;
@@ -132,30 +206,30 @@ void _twin_widget_init(twin_widget_t *widget,
     widget->dispatch = dispatch;
     widget->shape = TwinShapeRectangle;
     widget->radius = twin_int_to_fixed(12);
+    widget->retained = false;
+    widget->dirty = true;
+    widget->cache = NULL;
 }
 
 void _twin_widget_queue_paint(twin_widget_t *widget)
 {
-    while (widget->parent) {
-        if (widget->paint)
-            return;
-
-        widget->paint = true;
-        widget = &widget->parent->widget;
-    }
-    _twin_toplevel_queue_paint(widget);
+    widget->dirty = true;
+    _twin_widget_queue_repaint(widget);
 }
 
 void _twin_widget_queue_layout(twin_widget_t *widget)
 {
+    widget->dirty = true;
     while (widget->parent) {
         if (widget->layout)
             return;
 
         widget->layout = true;
+        widget->configure = true;
         widget->paint = true;
         widget = &widget->parent->widget;
     }
+    widget->configure = true;
     _twin_toplevel_queue_layout(widget);
 }
 
@@ -208,7 +282,7 @@ void _twin_widget_bevel(twin_widget_t *widget, twin_fixed_t b, bool down)
 void twin_widget_children_paint(twin_box_t *box)
 {
     for (twin_widget_t *child = box->children; child; child = child->next)
-        _twin_widget_queue_paint(child);
+        _twin_widget_queue_repaint(child);
 }
 
 twin_widget_t *twin_widget_create(twin_box_t *parent,
@@ -238,3 +312,12 @@ void twin_widget_set(twin_widget_t *widget, twin_argb32_t background)
     widget->background = background;
     _twin_widget_queue_paint(widget);
 }
+
+void twin_widget_set_retained(twin_widget_t *widget, bool retained)
+{
+    widget->retained = retained;
+    if (!retained && widget->cache) {
+        twin_pixmap_destroy(widget->cache);
+        widget->cache = NULL;
+    }
+}
@@ -84,6 +84,10 @@ twin_window_t *twin_window_create(twin_screen_t *screen,
     window->draw_queued = false;
     window->client_data = 0;
     window->name = 0;
+    window->frame[0] = window->frame[1] = NULL;
+#if defined(CONFIG_DROP_SHADOW)
+    window->shadow = NULL;
+#endif
 
     window->draw = 0;
     window->event = 0;
@@ -91,9 +95,208 @@ twin_window_t *twin_window_create(twin_screen_t *screen,
     return window;
 }
 
+#if defined(CONFIG_DROP_SHADOW)
+/*
+ * Drop shadow
+ *
+ * The shadow of a window is not drawn into its pixmap, whose shadow area stays
+ * transparent; the compositor lays it under the window as long as the pixmap
+ * is flagged. Away from the corners the shadow repeats the same row down the
+ * right side and the same column along the bottom, so it is rendered once for
+ * a window just large enough to have one stationary row and column, and
+ * stretched from there: a nine-slice asset. Windows smaller than that get an
+ * asset of their own size. Focus changes then only flip a flag and damage the
+ * shadow areas.
+ */
+
+/* The stretched row and column of the asset, past the top and left corners */
+static twin_coord_t twin_window_shadow_top(twin_window_t *window)
+{
+    twin_coord_t top = CONFIG_VERTICAL_OFFSET + CONFIG_SHADOW_BLUR;
+
+    return window->style == TwinWindowApplication ? TWIN_TITLE_HEIGHT + top
+                                                  : top;
+}
+
+static twin_coord_t twin_window_shadow_left(void)
+{
+    return CONFIG_HORIZONTAL_OFFSET + CONFIG_SHADOW_BLUR;
+}
+
+static void twin_window_shadow_flush(twin_window_t *window)
+{
+    if (window->shadow)
+        twin_pixmap_destroy(window->shadow);
+    window->shadow = NULL;
+}
+
+/* Make sure the asset fits the current size and style of the window */
+static void twin_window_shadow_update(twin_window_t *window)
+{
+    twin_pixmap_t *shadow = window->shadow;
+    twin_coord_t width = window->pixmap->width - window->shadow_x;
+    twin_coord_t height = window->pixmap->height - window->shadow_y;
+    /* the corners are independent once a blur radius apart from each other */
+    twin_coord_t full_width =
+        twin_window_shadow_left() + 1 + CONFIG_SHADOW_BLUR;
+    twin_coord_t full_height =
+        twin_window_shadow_top(window) + 1 + CONFIG_SHADOW_BLUR;
+
+    if (width > full_width)
+        width = full_width;
+    if (height > full_height)
+        height = full_height;
+
+    if (shadow && shadow->width == width + window->shadow_x &&
+        shadow->height == height + window->shadow_y)
+        return;
+
+    twin_window_shadow_flush(window);
+    shadow = twin_pixmap_create(TWIN_ARGB32, width + window->shadow_x,
+                                height + window->shadow_y);
+    if (!shadow)
+        return;
+    /* twin_shadow_border() takes the shadow geometry from the window */
+    shadow->window = window;
+    window->shadow = shadow;
+
+    /*
+     * Create a darker border of the window that gives a more dimensional
+     * appearance. The shift offset and color of the shadow can be selected by
+     * the user.
+     */
+    twin_shadow_border(shadow, SHADOW_COLOR, CONFIG_VERTICAL_OFFSET,
+                       CONFIG_HORIZONTAL_OFFSET);
+
+    /* Add a blur effect to the right and then the bottom side. */
+    twin_stack_blur(shadow, CONFIG_SHADOW_BLUR, width, shadow->width, 0,
+                    shadow->height);
+    twin_stack_blur(shadow, CONFIG_SHADOW_BLUR, 0, shadow->width, height,
+                    shadow->height);
+}
+
+static void twin_window_shadow_damage(twin_pixmap_t *pixmap)
+{
+    twin_coord_t width = pixmap->width - pixmap->window->shadow_x;
+    twin_coord_t height = pixmap->height - pixmap->window->shadow_y;
+
+    twin_pixmap_damage(pixmap, width, 0, pixmap->width, height);
+    twin_pixmap_damage(pixmap, 0, height, pixmap->width, pixmap->height);
+}
+
+static void twin_window_drop_shadow(twin_window_t *window)
+{
+    twin_pixmap_t *prev_active_pix = window->screen->top,
+                  *active_pix = window->pixmap;
+
+    /* Remove the drop shadow from the previously active pixel map. */
+    if (prev_active_pix && prev_active_pix != active_pix &&
+        prev_active_pix->shadow) {
+        prev_active_pix->shadow = false;
+        twin_window_shadow_damage(prev_active_pix);
+    }
+
+    /*
+     * The shadow effect of the window only becomes visible when the window is
+     * active.
+     */
+    twin_window_shadow_update(window);
+    if (!active_pix->shadow) {
+        active_pix->shadow = true;
+        twin_window_shadow_damage(active_pix);
+    }
+}
+
+/* Compose the asset over [p_left, p_right), one pixel of it if repeat */
+static void twin_window_shadow_piece(twin_argb32_t *span,
+                                     twin_coord_t left,
+                                     twin_coord_t right,
+                                     twin_pixmap_t *shadow,
+                                     twin_coord_t row,
+                                     twin_coord_t p_left,
+                                     twin_coord_t p_right,
+                                     twin_coord_t shift,
+                                     bool repeat)
+{
+    twin_coord_t x = p_left - shift;
+    twin_pointer_t dst;
+    twin_source_u src;
+
+    if (p_left < left)
+        p_left = left;
+    if (p_right > right)
+        p_right = right;
+    if (p_left >= p_right)
+        return;
+    dst.argb32 = span + (p_left - left);
+    if (repeat) {
+        src.c = *twin_pixmap_pointer(shadow, x, row).argb32;
+        if (src.c)
+            _twin_c_over_argb32(dst, src, p_right - p_left);
+    } else {
+        src.p = twin_pixmap_pointer(shadow, p_left - shift, row);
+        _twin_vec_argb32_over_argb32(dst, src, p_right - p_left);
+    }
+}
+
+void _twin_window_span_shadow(twin_window_t *window,
+                              twin_argb32_t *span,
+                              twin_coord_t y,
+                              twin_coord_t left,
+                              twin_coord_t right)
+{
+    twin_pixmap_t *pixmap = window->pixmap, *shadow = window->shadow;
+    twin_coord_t x = pixmap->x, mid = twin_window_shadow_left();
+    twin_coord_t top = twin_window_shadow_top(window);
+    twin_coord_t stretch_x, stretch_y, row;
+
+    y -= pixmap->y;
+    if (!shadow || y < 0 || pixmap->height <= y)
+        return;
+    stretch_x = pixmap->width - shadow->width;
+    stretch_y = pixmap->height - shadow->height;
+    if (y < top)
+        row = y;
+    else if (y < top + stretch_y)
+        row = top;
+    else
+        row = y - stretch_y;
+
+    if (y < pixmap->height - window->shadow_y) {
+        /* right side */
+        twin_window_shadow_piece(span, left, right, shadow, row,
+                                 x + pixmap->width - window->shadow_x,
+                                 x + pixmap->width, x + stretch_x, false);
+        return;
+    }
+    /* bottom side, stretched between its corners */
+    twin_window_shadow_piece(span, left, right, shadow, row, x, x + mid, x,
+                             false);
+    if (stretch_x > 0)
+        twin_window_shadow_piece(span, left, right, shadow, row, x + mid,
+                                 x + mid + stretch_x, x, true);
+    twin_window_shadow_piece(span, left, right, shadow, row,
+                             x + mid + stretch_x, x + pixmap->width,
+                             x + stretch_x, false);
+}
+#endif
+
+static void twin_window_frame_flush(twin_window_t *window)
+{
+    for (int i = 0; i < 2; i++) {
+        if (window->frame[i])
+            twin_pixmap_destroy(window->frame[i]);
+        window->frame[i] = NULL;
+    }
+}
+
 void twin_window_destroy(twin_window_t *window)
 {
     twin_window_hide(window);
+    twin_window_frame_flush(window);
+#if defined(CONFIG_DROP_SHADOW)
+    twin_window_shadow_flush(window);
+#endif
     twin_pixmap_destroy(window->pixmap);
     free(window->name);
     free(window);
@@ -123,6 +326,9 @@ void twin_window_configure(twin_window_t *window,
     if (style != window->style) {
         window->style = style;
         need_repaint = true;
+#if defined(CONFIG_DROP_SHADOW)
+        twin_window_shadow_flush(window);
+#endif
     }
     if (width != window->pixmap->width || height != window->pixmap->height) {
         twin_pixmap_t *old = window->pixmap;
@@ -130,12 +336,16 @@ void twin_window_configure(twin_window_t *window,
 
         window->pixmap = twin_pixmap_create(old->format, width, height);
         window->pixmap->window = window;
+#if defined(CONFIG_DROP_SHADOW)
+        window->pixmap->shadow = old->shadow;
+#endif
         twin_pixmap_move(window->pixmap, x, y);
         if (old->screen)
             twin_pixmap_show(window->pixmap, window->screen, old);
         for (i = 0; i < old->disable; i++)
             twin_pixmap_disable_update(window->pixmap);
         twin_pixmap_destroy(old);
+        twin_window_frame_flush(window);
         twin_pixmap_reset_clip(window->pixmap);
         twin_pixmap_clip(window->pixmap, window->client.left,
                          window->client.top, window->client.right,
@@ -144,6 +354,10 @@ void twin_window_configure(twin_window_t *window,
     }
     if (x != window->pixmap->x || y != window->pixmap->y)
         twin_pixmap_move(window->pixmap, x, y);
+#if defined(CONFIG_DROP_SHADOW)
+    if (window->pixmap->shadow)
+        twin_window_shadow_update(window);
+#endif
     if (need_repaint)
         twin_window_draw(window);
     twin_pixmap_enable_update(window->pixmap);
@@ -207,15 +421,17 @@ void twin_window_set_name(twin_window_t *window, const char *name)
     window->name = malloc(strlen(name) + 1);
     if (window->name)
         strcpy(window->name, name);
+    twin_window_frame_flush(window);
     twin_window_draw(window);
 }
 
-static void twin_window_frame(twin_window_t *window)
+/* Render the title bar of window into pixmap, as tall as the title bar */
+static void twin_window_frame_render(twin_window_t *window,
+                                     twin_pixmap_t *pixmap)
 {
     twin_fixed_t bw = twin_int_to_fixed(TWIN_TITLE_BW);
     twin_path_t *path;
     twin_fixed_t bw_2 = bw / 2;
-    twin_pixmap_t *pixmap = window->pixmap;
     twin_fixed_t w_top = bw_2;
     twin_fixed_t c_left = bw_2;
     twin_fixed_t t_h = twin_int_to_fixed(window->client.top) - bw;
@@ -236,19 +452,13 @@ static void twin_window_frame(twin_window_t *window)
     twin_fixed_t close_x;
     twin_fixed_t max_x;
     twin_fixed_t min_x;
-    twin_fixed_t resize_x;
-    twin_fixed_t resize_y;
     const char *name;
 
-    twin_pixmap_reset_clip(pixmap);
-    twin_pixmap_origin_to_clip(pixmap);
-
     twin_fill(pixmap, 0x00000000, TWIN_SOURCE, 0, 0, pixmap->width,
               window->client.top);
 
     path = twin_path_create();
 
-
     /* name */
     name = window->name;
     if (!name)
@@ -263,12 +473,9 @@ static void twin_window_frame(twin_window_t *window)
     if (title_right < c_right)
         c_right = title_right;
 
-
     close_x = c_right - t_arc_2 - icon_size;
     max_x = close_x - bw - icon_size;
     min_x = max_x - bw - icon_size;
-    resize_x = twin_int_to_fixed(window->client.right);
-    resize_y = twin_int_to_fixed(window->client.bottom);
 
     /* border */
 
@@ -297,8 +504,7 @@ static void twin_window_frame(twin_window_t *window)
     twin_pixmap_origin_to_clip(pixmap);
 
     twin_path_move(path, text_x - twin_fixed_floor(menu_x), text_y);
-    twin_path_utf8(path, window->name);
-    twin_paint_path(pixmap, TWIN_FRAME_TEXT, path);
+    twin_paint_utf8(pixmap, TWIN_FRAME_TEXT, path, window->name);
 
     twin_pixmap_reset_clip(pixmap);
     twin_pixmap_origin_to_clip(pixmap);
@@ -327,81 +533,102 @@ static void twin_window_frame(twin_window_t *window)
         twin_matrix_translate(&m, close_x, icon_y);
         twin_matrix_scale(&m, icon_size, icon_size);
         twin_icon_draw(pixmap, TwinIconClose, m);
+    }
 
-        twin_matrix_identity(&m);
-        twin_matrix_translate(&m, resize_x, resize_y);
-        twin_matrix_scale(&m, twin_int_to_fixed(TWIN_TITLE_HEIGHT),
-                          twin_int_to_fixed(TWIN_TITLE_HEIGHT));
-        twin_icon_draw(pixmap, TwinIconResize, m);
+    twin_path_destroy(path);
+}
+
+/*
+ * The title bar only changes with the width, the name and the active state of
+ * the window, so both of its looks are rendered once and copied in from then
+ * on. The resize grip is drawn over the client area and stays live.
+ */
+static void twin_window_frame(twin_window_t *window)
+{
+    twin_pixmap_t *pixmap = window->pixmap;
+    twin_pixmap_t **frame = &window->frame[window->active];
+    twin_operand_t src = {.source_kind = TWIN_PIXMAP};
+    twin_matrix_t m;
+
+    if (*frame && (*frame)->width != pixmap->width) {
+        twin_pixmap_destroy(*frame);
+        *frame = NULL;
+    }
+    if (!*frame && window->client.top > 0) {
+        *frame = twin_pixmap_create(pixmap->format, pixmap->width,
+                                    window->client.top);
+        if (*frame)
+            twin_window_frame_render(window, *frame);
     }
 
+    twin_pixmap_reset_clip(pixmap);
+    twin_pixmap_origin_to_clip(pixmap);
+#if defined(CONFIG_DROP_SHADOW)
+    /* The shadow area is left transparent for the compositor. */
+    twin_pixmap_clip(pixmap, 0, 0, pixmap->width - window->shadow_x,
+                     pixmap->height - window->shadow_y);
+#endif
+
+    if (*frame) {
+        src.u.pixmap = *frame;
+        twin_composite(pixmap, 0, 0, &src, 0, 0, NULL, 0, 0, TWIN_SOURCE,
+                       pixmap->width, window->client.top);
+    } else
+        twin_window_frame_render(window, pixmap);
+
+    twin_matrix_identity(&m);
+    twin_matrix_translate(&m, twin_int_to_fixed(window->client.right),
+                          twin_int_to_fixed(window->client.bottom));
+    twin_matrix_scale(&m, twin_int_to_fixed(TWIN_TITLE_HEIGHT),
+                      twin_int_to_fixed(TWIN_TITLE_HEIGHT));
+    twin_icon_draw(pixmap, TwinIconResize, m);
+
     twin_pixmap_clip(pixmap, window->client.left, window->client.top,
                      window->client.right, window->client.bottom);
     twin_pixmap_origin_to_clip(pixmap);
-
-    twin_path_destroy(path);
 }
 
-#if defined(CONFIG_DROP_SHADOW)
-static void twin_window_drop_shadow(twin_window_t *window)
+/*
+ * Refresh the opacity hint of the window pixmap after the client area was
+ * redrawn. Only the freshly drawn pixels need checking: the hint is kept while
+ * they stay opaque, dropped as soon as one is not, and set once a redraw of the
+ * whole client area leaves it fully opaque.
+ */
+static void twin_window_update_opaque(twin_window_t *window)
 {
-    twin_pixmap_t *prev_active_pix = window->screen->top,
-                  *active_pix = window->pixmap;
-    twin_source_u src;
-    twin_coord_t y, ori_wid, ori_hei;
+    twin_pixmap_t *pixmap = window->pixmap;
+    twin_rect_t *damage = &window->damage;
+    twin_coord_t x, y;
 
-    /* Remove the drop shadow from the previously active pixel map. */
-    if (prev_active_pix) {
-        src.c = 0x00000000;
-        for (y = 0; y < prev_active_pix->height; y++) {
-            if (y < prev_active_pix->height - prev_active_pix->window->shadow_y)
-                twin_cover(
-                    prev_active_pix, src.c,
-                    prev_active_pix->width - prev_active_pix->window->shadow_x,
-                    y, prev_active_pix->window->shadow_x);
-            else
-                twin_cover(prev_active_pix, src.c, 0, y,
-                           prev_active_pix->width);
-        }
-        prev_active_pix->shadow = false;
-    }
+    if (pixmap->format != TWIN_ARGB32)
+        return;
 
-    /* Mark the previously active pixel map as damaged to update its changes. */
-    if (prev_active_pix && active_pix != prev_active_pix)
-        twin_pixmap_damage(prev_active_pix, 0, 0, prev_active_pix->width,
-                           prev_active_pix->height);
+    for (y = damage->top; y < damage->bottom; y++) {
+        twin_argb32_t *p = twin_pixmap_pointer(pixmap, damage->left, y).argb32;
 
-    /*
-     * The shadow effect of the window only becomes visible when the window is
-     * active.
-     */
-    active_pix->shadow = true;
-    ori_wid = active_pix->width - active_pix->window->shadow_x;
-    ori_hei = active_pix->height - active_pix->window->shadow_y;
-    /*
-     * Create a darker border of the active window that gives a more
-     * dimensional appearance.
-     */
-    /* The shift offset and color of the shadow can be selected by the user. */
-    twin_shadow_border(active_pix, SHADOW_COLOR, CONFIG_VERTICAL_OFFSET,
-                       CONFIG_HORIZONTAL_OFFSET);
+        for (x = damage->left; x < damage->right; x++)
+            if ((*p++ >> 24) != 0xff) {
+                twin_pixmap_set_opaque(pixmap, 0, 0, 0, 0);
+                return;
+            }
+    }
 
-    /* Add a blur effect to the shadow of the active window. */
-    /* Right side of the active window */
-    twin_stack_blur(active_pix, CONFIG_SHADOW_BLUR, ori_wid,
-                    ori_wid + active_pix->window->shadow_x, 0,
-                    ori_hei + active_pix->window->shadow_y);
-    /* Bottom side of the active window */
-    twin_stack_blur(active_pix, CONFIG_SHADOW_BLUR, 0,
-                    ori_wid + active_pix->window->shadow_x, ori_hei,
-                    ori_hei + active_pix->window->shadow_y);
+    if (pixmap->opaque.left == pixmap->opaque.right &&
+        (damage->left > window->client.left ||
+         damage->top > window->client.top ||
+         damage->right < window->client.right ||
+         damage->bottom < window->client.bottom))
+        return;
+    twin_pixmap_set_opaque(pixmap, window->client.left, window->client.top,
+                           window->client.right, window->client.bottom);
 }
-#endif
 
 void twin_window_draw(twin_window_t *window)
 {
     twin_pixmap_t *pixmap = window->pixmap;
 
+    _twin_profile_begin(TWIN_PROFILE_DRAW);
+
     switch (window->style) {
     case TwinWindowPlain:
     default:
@@ -413,8 +640,10 @@ void twin_window_draw(twin_window_t *window)
 
     /* if no draw function or no damage, return */
     if (window->draw == NULL || (window->damage.left >= window->damage.right ||
-                                 window->damage.top >= window->damage.bottom))
+                                 window->damage.top >= window->damage.bottom)) {
+        _twin_profile_end(TWIN_PROFILE_DRAW);
         return;
+    }
 
     /* clip to damaged area and draw */
     twin_pixmap_reset_clip(pixmap);
@@ -423,6 +652,7 @@ void twin_window_draw(twin_window_t *window)
     twin_screen_disable_update(window->screen);
 
     (*window->draw)(window);
+    twin_window_update_opaque(window);
 
     /* damage matching screen area */
     twin_pixmap_damage(pixmap, window->damage.left, window->damage.top,
@@ -436,6 +666,8 @@ void twin_window_draw(twin_window_t *window)
     twin_pixmap_reset_clip(pixmap);
     twin_pixmap_clip(pixmap, window->client.left, window->client.top,
                      window->client.right, window->client.bottom);
+
+    _twin_profile_end(TWIN_PROFILE_DRAW);
 }
 
 /* window keep track of local damage */
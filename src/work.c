@@ -10,6 +10,9 @@
 
 static twin_queue_t *head;
 
+/* work was queued since the queue last ran */
+static bool queued;
+
 static twin_order_t _twin_work_order(twin_queue_t *a, twin_queue_t *b)
 {
     const twin_work_t *aw = (twin_work_t *) a, *bw = (twin_work_t *) b;
@@ -31,6 +34,7 @@ void _twin_run_work(void)
     twin_work_t *work;
     twin_work_t *first;
 
+    queued = false;
     first = (twin_work_t *) _twin_queue_set_order(&head);
     for (work = first; work; work = (twin_work_t *) work->queue.order)
         if (!(*work->proc)(work->closure))
@@ -50,9 +54,15 @@ twin_work_t *twin_set_work(twin_work_proc_t work_proc,
     work->priority = priority;
     work->closure = closure;
     _twin_queue_work(work);
+    queued = true;
     return work;
 }
 
+bool _twin_work_queued(void)
+{
+    return queued;
+}
+
 void twin_clear_work(twin_work_t *work)
 {
     _twin_queue_delete(&head, &work->queue);
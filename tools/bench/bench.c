@@ -0,0 +1,1381 @@
+/*
+ * Twin - A Tiny Window System
+ * Copyright (c) 2025 National Cheng Kung University, Taiwan
+ * All rights reserved.
+ */
+
+#include <getopt.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <twin.h>
+
+#include "twin_private.h"
+
+/*
+ * Micro- and macro-benchmarks for the rendering core
+ *
+ * Every case builds its inputs from a fixed seed, then repeats its operation
+ * until the minimum run time has elapsed and reports the throughput in the
+ * unit that suits it (Mpix/s, paths/s, glyphs/s or frames/s). Case names are
+ * stable so that results of different versions can be compared line by line.
+ *
+ * With -c the benchmarks are skipped; the same seeded inputs instead feed
+ * self-checks comparing the optimized paths against their references, and the
+ * exit status tells whether they all passed.
+ */
+
+#define DEFAULT_SEED 0x6d61646f
+#define DEFAULT_MIN_MS 200
+
+#define SIZE 256 /* edge of the square pixmaps used by the micro benchmarks */
+
+#define SCREEN_WIDTH 1920
+#define SCREEN_HEIGHT 1080
+#define WINDOW_WIDTH 640
+#define WINDOW_HEIGHT 480
+
+typedef enum { OUTPUT_TEXT, OUTPUT_CSV, OUTPUT_JSON } output_t;
+
+typedef struct {
+    const char *name;
+    const char *unit;
+    double scale; /* units per iteration */
+    void (*run)(void *closure);
+    void *closure;
+} bench_case_t;
+
+static uint32_t seed = DEFAULT_SEED;
+static uint32_t rng_state;
+static double min_seconds = DEFAULT_MIN_MS / 1000.0;
+static output_t output = OUTPUT_TEXT;
+static char **filters;
+static int n_filters;
+static int n_results;
+static bool check_mode;
+static int n_failures;
+
+/* xorshift32; every case restarts it so results do not depend on order */
+static uint32_t bench_random(void)
+{
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+static void bench_reseed(void)
+{
+    rng_state = seed ? seed : DEFAULT_SEED;
+}
+
+static double bench_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static bool bench_selected(const char *name)
+{
+    int i;
+
+    if (!n_filters)
+        return true;
+    for (i = 0; i < n_filters; i++)
+        if (strstr(name, filters[i]))
+            return true;
+    return false;
+}
+
+static void bench_report(const char *name,
+                         const char *unit,
+                         long iterations,
+                         double seconds,
+                         double rate)
+{
+    switch (output) {
+    case OUTPUT_CSV:
+        if (!n_results)
+            printf("name,unit,rate,iterations,seconds\n");
+        printf("%s,%s,%.3f,%ld,%.6f\n", name, unit, rate, iterations, seconds);
+        break;
+    case OUTPUT_JSON:
+        printf("%s\n    {\"name\": \"%s\", \"unit\": \"%s\", \"rate\": %.3f, "
+               "\"iterations\": %ld, \"seconds\": %.6f}",
+               n_results ? "," : "[", name, unit, rate, iterations, seconds);
+        break;
+    case OUTPUT_TEXT:
+    default:
+        printf("%-44s %12.3f %-9s (%ld iterations)\n", name, rate, unit,
+               iterations);
+        break;
+    }
+    fflush(stdout);
+    n_results++;
+}
+
+static void check_report(const char *name, bool ok, const char *detail)
+{
+    switch (output) {
+    case OUTPUT_CSV:
+        if (!n_results)
+            printf("name,status,detail\n");
+        printf("%s,%s,%s\n", name, ok ? "ok" : "fail", detail);
+        break;
+    case OUTPUT_JSON:
+        printf("%s\n    {\"name\": \"%s\", \"status\": \"%s\", "
+               "\"detail\": \"%s\"}",
+               n_results ? "," : "[", name, ok ? "ok" : "fail", detail);
+        break;
+    case OUTPUT_TEXT:
+    default:
+        printf("%-44s %-4s %s\n", name, ok ? "ok" : "FAIL", detail);
+        break;
+    }
+    fflush(stdout);
+    if (!ok)
+        n_failures++;
+    n_results++;
+}
+
+static void bench_run(const bench_case_t *c)
+{
+    long iterations = 0, batch = 1;
+    double start, elapsed;
+
+    if (!bench_selected(c->name))
+        return;
+
+    /* warm up caches and lazily created state */
+    (*c->run)(c->closure);
+
+    start = bench_now();
+    do {
+        long i;
+
+        for (i = 0; i < batch; i++)
+            (*c->run)(c->closure);
+        iterations += batch;
+        elapsed = bench_now() - start;
+        if (elapsed < min_seconds / 8)
+            batch *= 2;
+    } while (elapsed < min_seconds);
+
+    bench_report(c->name, c->unit, iterations, elapsed,
+                 iterations * c->scale / elapsed);
+}
+
+static const char *format_name(twin_format_t format)
+{
+    switch (format) {
+    case TWIN_A8:
+        return "a8";
+    case TWIN_RGB16:
+        return "rgb16";
+    case TWIN_ARGB32:
+    default:
+        return "argb32";
+    }
+}
+
+/* A pixmap filled with seeded noise; ARGB32 pixels are kept premultiplied */
+static twin_pixmap_t *bench_pixmap(twin_format_t format,
+                                   twin_coord_t width,
+                                   twin_coord_t height)
+{
+    twin_pixmap_t *pixmap = twin_pixmap_create(format, width, height);
+    twin_coord_t x, y;
+
+    if (!pixmap) {
+        fprintf(stderr, "bench: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+    for (y = 0; y < height; y++) {
+        uint8_t *row = pixmap->p.b + y * pixmap->stride;
+
+        for (x = 0; x < width; x++) {
+            uint32_t r = bench_random();
+
+            switch (format) {
+            case TWIN_A8:
+                row[x] = r;
+                break;
+            case TWIN_RGB16:
+                ((uint16_t *) row)[x] = r;
+                break;
+            case TWIN_ARGB32: {
+                uint32_t a = r >> 24;
+                uint32_t c = (((r >> 16) & 0xff) * a / 255) << 16 |
+                             (((r >> 8) & 0xff) * a / 255) << 8 |
+                             ((r & 0xff) * a / 255);
+
+                ((uint32_t *) row)[x] = a << 24 | c;
+                break;
+            }
+            }
+        }
+    }
+    return pixmap;
+}
+
+/*
+ * twin_composite
+ */
+
+typedef struct {
+    twin_pixmap_t *dst;
+    twin_operand_t src, msk;
+    bool has_msk;
+    twin_operator_t op;
+} composite_t;
+
+static void run_composite(void *closure)
+{
+    composite_t *c = closure;
+
+    twin_composite(c->dst, 0, 0, &c->src, 0, 0, c->has_msk ? &c->msk : NULL, 0,
+                   0, c->op, SIZE, SIZE);
+}
+
+/* A solid operand or a noise pixmap of the given format */
+static void bench_operand(twin_operand_t *operand, int kind)
+{
+    if (kind < 0) {
+        operand->source_kind = TWIN_SOLID;
+        operand->u.argb = 0x80402010;
+    } else {
+        operand->source_kind = TWIN_PIXMAP;
+        operand->u.pixmap = bench_pixmap(kind, SIZE, SIZE);
+    }
+}
+
+static void bench_operand_fini(twin_operand_t *operand)
+{
+    if (operand->source_kind == TWIN_PIXMAP)
+        twin_pixmap_destroy(operand->u.pixmap);
+}
+
+static const char *operand_name(int kind)
+{
+    return kind < 0 ? "solid" : format_name(kind);
+}
+
+static void bench_composite(void)
+{
+    /* -1 stands for a solid color; -2 (masks only) for no mask at all */
+    static const int srcs[] = {-1, TWIN_A8, TWIN_RGB16, TWIN_ARGB32};
+    static const int msks[] = {-2, -1, TWIN_A8, TWIN_RGB16, TWIN_ARGB32};
+    static const twin_format_t dsts[] = {TWIN_A8, TWIN_RGB16, TWIN_ARGB32};
+    static const twin_operator_t ops[] = {TWIN_OVER, TWIN_SOURCE};
+    size_t s, m, d, o;
+
+    for (s = 0; s < sizeof(srcs) / sizeof(srcs[0]); s++)
+        for (m = 0; m < sizeof(msks) / sizeof(msks[0]); m++)
+            for (d = 0; d < sizeof(dsts) / sizeof(dsts[0]); d++)
+                for (o = 0; o < sizeof(ops) / sizeof(ops[0]); o++) {
+                    composite_t c = {.has_msk = msks[m] != -2, .op = ops[o]};
+                    char name[64];
+                    bench_case_t bc = {name, "Mpix/s", SIZE * SIZE / 1e6,
+                                       run_composite, &c};
+
+                    snprintf(name, sizeof(name), "composite/%s-%s-%s/%s",
+                             operand_name(srcs[s]),
+                             c.has_msk ? operand_name(msks[m]) : "none",
+                             format_name(dsts[d]),
+                             ops[o] == TWIN_OVER ? "over" : "source");
+                    if (!bench_selected(name))
+                        continue;
+
+                    bench_reseed();
+                    c.dst = bench_pixmap(dsts[d], SIZE, SIZE);
+                    bench_operand(&c.src, srcs[s]);
+                    if (c.has_msk)
+                        bench_operand(&c.msk, msks[m]);
+                    bench_run(&bc);
+                    if (c.has_msk)
+                        bench_operand_fini(&c.msk);
+                    bench_operand_fini(&c.src);
+                    twin_pixmap_destroy(c.dst);
+                }
+}
+
+/*
+ * twin_fill
+ */
+
+typedef struct {
+    twin_pixmap_t *dst;
+    twin_operator_t op;
+} fill_t;
+
+static void run_fill(void *closure)
+{
+    fill_t *f = closure;
+
+    twin_fill(f->dst, 0x80402010, f->op, 0, 0, SIZE, SIZE);
+}
+
+static void bench_fill(void)
+{
+    static const twin_format_t dsts[] = {TWIN_A8, TWIN_RGB16, TWIN_ARGB32};
+    size_t d;
+    int o;
+
+    for (d = 0; d < sizeof(dsts) / sizeof(dsts[0]); d++)
+        for (o = 0; o < 2; o++) {
+            fill_t f = {.op = o ? TWIN_SOURCE : TWIN_OVER};
+            char name[64];
+            bench_case_t bc = {name, "Mpix/s", SIZE * SIZE / 1e6, run_fill,
+                               &f};
+
+            snprintf(name, sizeof(name), "fill/%s/%s", format_name(dsts[d]),
+                     o ? "source" : "over");
+            if (!bench_selected(name))
+                continue;
+
+            bench_reseed();
+            f.dst = bench_pixmap(dsts[d], SIZE, SIZE);
+            bench_run(&bc);
+            twin_pixmap_destroy(f.dst);
+        }
+}
+
+/*
+ * twin_fill_path and twin_paint_stroke
+ */
+
+typedef struct {
+    twin_pixmap_t *dst;
+    twin_path_t *path;
+} path_t;
+
+static twin_fixed_t random_coord(void)
+{
+    return (twin_fixed_t) (bench_random() % (SIZE << 16));
+}
+
+/* A closed polygon, or an open polyline, through seeded random points */
+static twin_path_t *random_path(int n_points, bool close)
+{
+    twin_path_t *path = twin_path_create();
+    int i;
+
+    twin_path_move(path, random_coord(), random_coord());
+    for (i = 1; i < n_points; i++)
+        twin_path_draw(path, random_coord(), random_coord());
+    if (close)
+        twin_path_close(path);
+    return path;
+}
+
+static void run_fill_path(void *closure)
+{
+    path_t *p = closure;
+
+    twin_fill_path(p->dst, p->path, 0, 0);
+}
+
+static void run_paint_stroke(void *closure)
+{
+    path_t *p = closure;
+
+    twin_paint_stroke(p->dst, 0xff204080, p->path, twin_int_to_fixed(2));
+}
+
+static void bench_paths(void)
+{
+    static const int vertices[] = {4, 16, 64, 256};
+    size_t v;
+    int stroke;
+
+    for (stroke = 0; stroke < 2; stroke++)
+        for (v = 0; v < sizeof(vertices) / sizeof(vertices[0]); v++) {
+            path_t p;
+            char name[64];
+            bench_case_t bc = {name, "paths/s", 1,
+                               stroke ? run_paint_stroke : run_fill_path, &p};
+
+            snprintf(name, sizeof(name), "%s/%d",
+                     stroke ? "stroke" : "fill_path", vertices[v]);
+            if (!bench_selected(name))
+                continue;
+
+            bench_reseed();
+            p.dst = twin_pixmap_create(stroke ? TWIN_ARGB32 : TWIN_A8, SIZE,
+                                       SIZE);
+            p.path = random_path(vertices[v], !stroke);
+            bench_run(&bc);
+            twin_path_destroy(p.path);
+            twin_pixmap_destroy(p.dst);
+        }
+}
+
+/*
+ * Flattening: build and fill a circle, so both the arc segment count and the
+ * edges it hands the rasterizer show up
+ */
+
+typedef struct {
+    twin_pixmap_t *dst;
+    twin_path_t *path;
+    twin_fixed_t radius;
+} circle_t;
+
+static void run_circle(void *closure)
+{
+    circle_t *c = closure;
+
+    twin_path_empty(c->path);
+    twin_path_circle(c->path, twin_int_to_fixed(SIZE / 2),
+                     twin_int_to_fixed(SIZE / 2), c->radius);
+    twin_fill_path(c->dst, c->path, 0, 0);
+}
+
+static void bench_circles(void)
+{
+    static const int radii[] = {4, 32, 120};
+    size_t r;
+
+    for (r = 0; r < sizeof(radii) / sizeof(radii[0]); r++) {
+        circle_t c;
+        char name[64];
+        bench_case_t bc = {name, "paths/s", 1, run_circle, &c};
+
+        snprintf(name, sizeof(name), "circle/%d", radii[r]);
+        if (!bench_selected(name))
+            continue;
+
+        c.dst = twin_pixmap_create(TWIN_A8, SIZE, SIZE);
+        c.path = twin_path_create();
+        c.radius = twin_int_to_fixed(radii[r]);
+        bench_run(&bc);
+        twin_path_destroy(c.path);
+        twin_pixmap_destroy(c.dst);
+    }
+}
+
+/*
+ * A window's worth of small filled and outlined shapes, painted into the whole
+ * pixmap and into a 32x32 clip as a partial repaint would
+ */
+
+#define CLIP_SIZE 32
+
+typedef struct {
+    twin_pixmap_t *dst;
+    twin_path_t **shapes;
+    int n_shapes;
+} shapes_t;
+
+static void run_paint_shapes(void *closure)
+{
+    shapes_t *s = closure;
+
+    for (int i = 0; i < s->n_shapes; i++) {
+        twin_paint_path(s->dst, 0xff204080, s->shapes[i]);
+        twin_paint_stroke(s->dst, 0xff804020, s->shapes[i],
+                          twin_int_to_fixed(2));
+    }
+}
+
+static void bench_clipped_paths(void)
+{
+    static const int counts[] = {16, 256};
+    size_t c;
+    int clipped, i;
+
+    for (clipped = 0; clipped < 2; clipped++)
+        for (c = 0; c < sizeof(counts) / sizeof(counts[0]); c++) {
+            shapes_t s;
+            char name[64];
+            bench_case_t bc = {name, "frames/s", 1, run_paint_shapes, &s};
+
+            snprintf(name, sizeof(name), "paint_shapes/%s/%d",
+                     clipped ? "clipped" : "full", counts[c]);
+            if (!bench_selected(name))
+                continue;
+
+            bench_reseed();
+            s.dst = twin_pixmap_create(TWIN_ARGB32, SIZE, SIZE);
+            if (clipped)
+                twin_pixmap_clip(s.dst, (SIZE - CLIP_SIZE) / 2,
+                                 (SIZE - CLIP_SIZE) / 2, (SIZE + CLIP_SIZE) / 2,
+                                 (SIZE + CLIP_SIZE) / 2);
+            s.n_shapes = counts[c];
+            s.shapes = calloc(s.n_shapes, sizeof(twin_path_t *));
+            for (i = 0; i < s.n_shapes; i++) {
+                s.shapes[i] = twin_path_create();
+                twin_path_rounded_rectangle(
+                    s.shapes[i], random_coord(), random_coord(),
+                    twin_int_to_fixed(8 + bench_random() % 32),
+                    twin_int_to_fixed(8 + bench_random() % 32),
+                    twin_int_to_fixed(4), twin_int_to_fixed(4));
+            }
+            bench_run(&bc);
+            for (i = 0; i < s.n_shapes; i++)
+                twin_path_destroy(s.shapes[i]);
+            free(s.shapes);
+            twin_pixmap_destroy(s.dst);
+        }
+}
+
+/*
+ * Rasterizers: the same random polygons and the TinyVG tiger, which is a few
+ * hundred overlapping filled and stroked paths, through each of them
+ */
+
+#define TIGER_SIZE 512
+
+static void run_tiger(void *closure)
+{
+    twin_pixmap_t *pixmap;
+
+    (void) closure;
+    pixmap = twin_tvg_to_pixmap_scale("assets/tiger.tvg", TWIN_ARGB32,
+                                      TIGER_SIZE, TIGER_SIZE);
+    if (pixmap)
+        twin_pixmap_destroy(pixmap);
+}
+
+static void bench_rasterizers(void)
+{
+    static const int vertices[] = {4, 16, 64, 256};
+    static const struct {
+        const char *name;
+        twin_rasterizer_t kind;
+    } kinds[] = {{"sampled", TWIN_RASTER_SAMPLED},
+                 {"analytic", TWIN_RASTER_ANALYTIC}};
+    twin_rasterizer_t saved = twin_get_rasterizer();
+    size_t k, v;
+
+    for (k = 0; k < sizeof(kinds) / sizeof(kinds[0]); k++) {
+        if (!twin_set_rasterizer(kinds[k].kind))
+            continue;
+
+        for (v = 0; v < sizeof(vertices) / sizeof(vertices[0]); v++) {
+            path_t p;
+            char name[64];
+            bench_case_t bc = {name, "paths/s", 1, run_fill_path, &p};
+
+            snprintf(name, sizeof(name), "raster/%s/%d", kinds[k].name,
+                     vertices[v]);
+            if (!bench_selected(name))
+                continue;
+
+            bench_reseed();
+            p.dst = twin_pixmap_create(TWIN_A8, SIZE, SIZE);
+            p.path = random_path(vertices[v], true);
+            bench_run(&bc);
+            twin_path_destroy(p.path);
+            twin_pixmap_destroy(p.dst);
+        }
+
+#if defined(CONFIG_LOADER_TVG)
+        {
+            char name[64];
+            bench_case_t bc = {name, "frames/s", 1, run_tiger, NULL};
+            twin_pixmap_t *probe;
+
+            snprintf(name, sizeof(name), "raster/%s/tiger", kinds[k].name);
+            if (!bench_selected(name))
+                continue;
+            /* the asset is looked up from the top of the source tree */
+            probe = twin_tvg_to_pixmap_scale("assets/tiger.tvg", TWIN_ARGB32,
+                                             1, 1);
+            if (!probe)
+                continue;
+            twin_pixmap_destroy(probe);
+            bench_run(&bc);
+        }
+#endif
+    }
+    twin_set_rasterizer(saved);
+}
+
+/*
+ * Strokers: the same random polylines and a chart trace of 10000 points, a
+ * random walk across a wide pixmap, outlined by each of them
+ */
+
+#define CHART_WIDTH 2000
+#define CHART_POINTS 10000
+
+static twin_path_t *chart_path(void)
+{
+    twin_path_t *path = twin_path_create();
+    twin_fixed_t y = twin_int_to_fixed(SIZE / 2);
+
+    twin_path_move(path, 0, y);
+    for (int i = 1; i < CHART_POINTS; i++) {
+        y += (twin_fixed_t) (bench_random() % (8 << 16)) - (4 << 16);
+        if (y < 0 || y > twin_int_to_fixed(SIZE))
+            y = twin_int_to_fixed(SIZE / 2);
+        twin_path_draw(path,
+                       (twin_fixed_t) ((int64_t) i * (CHART_WIDTH << 16) /
+                                       CHART_POINTS),
+                       y);
+    }
+    return path;
+}
+
+static void bench_strokers(void)
+{
+    static const int vertices[] = {16, 256, CHART_POINTS};
+    static const struct {
+        const char *name;
+        twin_stroker_t kind;
+    } kinds[] = {{"convolve", TWIN_STROKE_CONVOLVE},
+                 {"offset", TWIN_STROKE_OFFSET}};
+    twin_stroker_t saved = twin_get_stroker();
+    size_t k, v;
+
+    for (k = 0; k < sizeof(kinds) / sizeof(kinds[0]); k++) {
+        if (!twin_set_stroker(kinds[k].kind))
+            continue;
+
+        for (v = 0; v < sizeof(vertices) / sizeof(vertices[0]); v++) {
+            bool chart = vertices[v] == CHART_POINTS;
+            path_t p;
+            char name[64];
+            bench_case_t bc = {name, "paths/s", 1, run_paint_stroke, &p};
+
+            if (chart)
+                snprintf(name, sizeof(name), "stroker/%s/chart",
+                         kinds[k].name);
+            else
+                snprintf(name, sizeof(name), "stroker/%s/%d", kinds[k].name,
+                         vertices[v]);
+            if (!bench_selected(name))
+                continue;
+
+            bench_reseed();
+            p.dst = twin_pixmap_create(TWIN_ARGB32, chart ? CHART_WIDTH : SIZE,
+                                       SIZE);
+            p.path = chart ? chart_path() : random_path(vertices[v], false);
+            bench_run(&bc);
+            twin_path_destroy(p.path);
+            twin_pixmap_destroy(p.dst);
+        }
+    }
+    twin_set_stroker(saved);
+}
+
+/*
+ * twin_path_utf8
+ */
+
+static const char bench_text[] =
+    "The quick brown fox jumps over the lazy dog 0123456789";
+
+#define TEXT_GLYPHS (sizeof(bench_text) - 1)
+
+typedef struct {
+    twin_pixmap_t *dst;
+    twin_path_t *path;
+    twin_text_run_t *run;
+    int size;
+} text_t;
+
+static void run_text(void *closure)
+{
+    text_t *t = closure;
+
+    twin_path_empty(t->path);
+    twin_path_move(t->path, twin_int_to_fixed(2), twin_int_to_fixed(t->size));
+    twin_path_utf8(t->path, bench_text);
+    twin_paint_path(t->dst, 0xff000000, t->path);
+}
+
+/* The same line through twin_paint_utf8(), which may use the glyph atlas */
+static void run_paint_text(void *closure)
+{
+    text_t *t = closure;
+
+    twin_path_empty(t->path);
+    twin_path_move(t->path, twin_int_to_fixed(2), twin_int_to_fixed(t->size));
+    twin_paint_utf8(t->dst, 0xff000000, t->path, bench_text);
+}
+
+/* The same line kept in a text run, painted from its cached mask */
+static void run_text_run(void *closure)
+{
+    text_t *t = closure;
+
+    twin_text_run_paint(t->dst, 0xff000000, t->run, twin_int_to_fixed(2),
+                        twin_int_to_fixed(t->size));
+}
+
+static void bench_text_render(void)
+{
+    static const int sizes[] = {12, 24, 48};
+    static const struct {
+        const char *name;
+        void (*run)(void *closure);
+    } kinds[] = {{"text", run_text},
+                 {"paint_utf8", run_paint_text},
+                 {"text_run", run_text_run}};
+    size_t k, s;
+
+    for (k = 0; k < sizeof(kinds) / sizeof(kinds[0]); k++) {
+        for (s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+            text_t t = {.size = sizes[s]};
+            char name[64];
+            bench_case_t bc = {name, "glyphs/s", TEXT_GLYPHS, kinds[k].run,
+                               &t};
+
+            snprintf(name, sizeof(name), "%s/%d", kinds[k].name, sizes[s]);
+            if (!bench_selected(name))
+                continue;
+
+            t.dst = twin_pixmap_create(TWIN_ARGB32, sizes[s] * TEXT_GLYPHS,
+                                       sizes[s] * 2);
+            t.path = twin_path_create();
+            twin_path_set_font_size(t.path, twin_int_to_fixed(sizes[s]));
+            t.run = twin_text_run_create(
+                bench_text, twin_int_to_fixed(sizes[s]), TwinStyleRoman);
+            bench_run(&bc);
+            twin_text_run_destroy(t.run);
+            twin_path_destroy(t.path);
+            twin_pixmap_destroy(t.dst);
+        }
+    }
+}
+
+/*
+ * twin_stack_blur
+ */
+
+typedef struct {
+    twin_pixmap_t *dst;
+    int radius;
+} blur_t;
+
+static void run_blur(void *closure)
+{
+    blur_t *b = closure;
+
+    twin_stack_blur(b->dst, b->radius, 0, SIZE, 0, SIZE);
+}
+
+static void bench_blur(void)
+{
+    static const int radii[] = {2, 10, 32};
+    size_t r;
+
+    for (r = 0; r < sizeof(radii) / sizeof(radii[0]); r++) {
+        blur_t b = {.radius = radii[r]};
+        char name[64];
+        bench_case_t bc = {name, "Mpix/s", SIZE * SIZE / 1e6, run_blur, &b};
+
+        snprintf(name, sizeof(name), "blur/%d", radii[r]);
+        if (!bench_selected(name))
+            continue;
+
+        bench_reseed();
+        b.dst = bench_pixmap(TWIN_ARGB32, SIZE, SIZE);
+        bench_run(&bc);
+        twin_pixmap_destroy(b.dst);
+    }
+}
+
+/*
+ * twin_screen_update
+ */
+
+typedef struct {
+    twin_screen_t *screen;
+    twin_argb32_t *framebuffer;
+} screen_t;
+
+static void bench_put_span(twin_coord_t left,
+                           twin_coord_t top,
+                           twin_coord_t right,
+                           twin_argb32_t *pixels,
+                           void *closure)
+{
+    screen_t *s = closure;
+
+    memcpy(s->framebuffer + top * SCREEN_WIDTH + left, pixels,
+           (right - left) * sizeof(*pixels));
+}
+
+static void run_screen(void *closure)
+{
+    screen_t *s = closure;
+
+    twin_screen_damage(s->screen, 0, 0, SCREEN_WIDTH, SCREEN_HEIGHT);
+    twin_screen_update(s->screen);
+}
+
+static void bench_screen(void)
+{
+    static const int windows[] = {0, 1, 4, 16};
+    twin_pixmap_t *pixmaps[16];
+    size_t w;
+    int i;
+
+    for (w = 0; w < sizeof(windows) / sizeof(windows[0]); w++) {
+        screen_t s;
+        char name[64];
+        bench_case_t bc = {name, "frames/s", 1, run_screen, &s};
+
+        snprintf(name, sizeof(name), "screen/1080p/%d", windows[w]);
+        if (!bench_selected(name))
+            continue;
+
+        bench_reseed();
+        s.framebuffer =
+            calloc(SCREEN_WIDTH * SCREEN_HEIGHT, sizeof(twin_argb32_t));
+        s.screen = twin_screen_create(SCREEN_WIDTH, SCREEN_HEIGHT, NULL,
+                                      bench_put_span, &s);
+        if (!s.framebuffer || !s.screen) {
+            fprintf(stderr, "bench: out of memory\n");
+            exit(EXIT_FAILURE);
+        }
+        twin_screen_set_background(s.screen, twin_make_pattern());
+        for (i = 0; i < windows[w]; i++) {
+            pixmaps[i] = bench_pixmap(TWIN_ARGB32, WINDOW_WIDTH, WINDOW_HEIGHT);
+            twin_pixmap_move(
+                pixmaps[i], bench_random() % (SCREEN_WIDTH - WINDOW_WIDTH),
+                bench_random() % (SCREEN_HEIGHT - WINDOW_HEIGHT));
+            twin_pixmap_show(pixmaps[i], s.screen, s.screen->top);
+        }
+        bench_run(&bc);
+        for (i = 0; i < windows[w]; i++) {
+            twin_pixmap_hide(pixmaps[i]);
+            twin_pixmap_destroy(pixmaps[i]);
+        }
+        twin_screen_set_background(s.screen, NULL);
+        twin_screen_destroy(s.screen);
+        free(s.framebuffer);
+    }
+}
+
+/*
+ * Self-checks
+ */
+
+/* A random premultiplied ARGB32 pixel */
+static uint32_t random_argb32(void)
+{
+    uint32_t r = bench_random(), a = r >> 24;
+
+    return a << 24 | (((r >> 16) & 0xff) * a / 255) << 16 |
+           (((r >> 8) & 0xff) * a / 255) << 8 | ((r & 0xff) * a / 255);
+}
+
+#define SIMD_TRIALS 20000
+#define SIMD_SPAN 80 /* longest span, a few vectors plus a tail */
+#define SIMD_SLACK 8 /* offsets that move a span across vector alignments */
+
+typedef enum {
+    SIMD_OVER,
+    SIMD_SOURCE,
+    SIMD_RGB16,
+    SIMD_IN_A8,
+} simd_kernel_t;
+
+/*
+ * Run one kernel and its scalar reference on the same span, starting at
+ * random offsets into the buffers, and compare the whole destination so that
+ * writes past the end of the span are caught too
+ */
+static bool check_simd_kernel(simd_kernel_t kernel)
+{
+    enum { LEN = SIMD_SPAN + SIMD_SLACK };
+    uint32_t src[LEN], ref[LEN], vec[LEN];
+    uint16_t src16[LEN];
+    uint8_t msk[LEN];
+
+    for (int t = 0; t < SIMD_TRIALS; t++) {
+        int width = bench_random() % (SIMD_SPAN + 1);
+        int d = bench_random() % SIMD_SLACK, o = bench_random() % SIMD_SLACK;
+        twin_pointer_t rp = {.argb32 = ref + d}, vp = {.argb32 = vec + d};
+        twin_source_u s, m;
+
+        for (int i = 0; i < LEN; i++) {
+            src[i] = random_argb32();
+            src16[i] = bench_random();
+            ref[i] = vec[i] = random_argb32();
+            /* masks are mostly fully off or on, like antialiased edges */
+            switch (bench_random() % 4) {
+            case 0:
+                msk[i] = 0;
+                break;
+            case 1:
+                msk[i] = 0xff;
+                break;
+            default:
+                msk[i] = bench_random();
+                break;
+            }
+        }
+        switch (kernel) {
+        case SIMD_OVER:
+            s.p.argb32 = src + o;
+            _twin_argb32_over_argb32(rp, s, width);
+            _twin_vec_argb32_over_argb32(vp, s, width);
+            break;
+        case SIMD_SOURCE:
+            s.p.argb32 = src + o;
+            _twin_argb32_source_argb32(rp, s, width);
+            _twin_vec_argb32_source_argb32(vp, s, width);
+            break;
+        case SIMD_RGB16:
+            s.p.rgb16 = src16 + o;
+            _twin_rgb16_source_argb32(rp, s, width);
+            _twin_vec_rgb16_source_argb32(vp, s, width);
+            break;
+        case SIMD_IN_A8:
+            s.c = random_argb32();
+            m.p.a8 = msk + o;
+            _twin_c_in_a8_over_argb32(rp, s, m, width);
+            _twin_vec_c_in_a8_over_argb32(vp, s, m, width);
+            break;
+        }
+        if (memcmp(ref, vec, sizeof(ref)))
+            return false;
+    }
+    return true;
+}
+
+/* Every kernel set built in and supported, against primitive.c */
+static void check_simd(void)
+{
+    static const char *isas[] = {"sse2", "avx2", "neon"};
+    static const struct {
+        const char *name;
+        simd_kernel_t kernel;
+    } kernels[] = {
+        {"argb32_over_argb32", SIMD_OVER},
+        {"argb32_source_argb32", SIMD_SOURCE},
+        {"rgb16_source_argb32", SIMD_RGB16},
+        {"c_in_a8_over_argb32", SIMD_IN_A8},
+    };
+
+    for (size_t i = 0; i < sizeof(isas) / sizeof(isas[0]); i++) {
+        if (!_twin_vec_select(isas[i]))
+            continue;
+        for (size_t k = 0; k < sizeof(kernels) / sizeof(kernels[0]); k++) {
+            char name[64], detail[64];
+            bool ok;
+
+            snprintf(name, sizeof(name), "check/simd/%s/%s", isas[i],
+                     kernels[k].name);
+            if (!bench_selected(name))
+                continue;
+            bench_reseed();
+            ok = check_simd_kernel(kernels[k].kernel);
+            snprintf(detail, sizeof(detail), "%d random spans%s", SIMD_TRIALS,
+                     ok ? "" : ", output differs from scalar");
+            check_report(name, ok, detail);
+        }
+    }
+    _twin_vec_select(NULL);
+}
+
+/*
+ * twin_stack_blur against a direct evaluation of the stack kernel, weights
+ * r + 1 - |k| over [-r, r] with the edges repeated, one pass per direction
+ */
+static void blur_reference(uint32_t *pixels,
+                           int stride,
+                           int step,
+                           int n_lines,
+                           int n,
+                           int radius)
+{
+    uint32_t den = (radius + 1) * (radius + 1);
+    uint32_t line[SIZE];
+
+    for (int l = 0; l < n_lines; l++) {
+        uint32_t *p = pixels + l * stride;
+
+        for (int i = 0; i < n; i++)
+            line[i] = p[i * step];
+        for (int i = 0; i < n; i++) {
+            uint32_t out = 0;
+
+            for (int c = 0; c < 32; c += 8) {
+                uint32_t sum = 0;
+
+                for (int k = -radius; k <= radius; k++) {
+                    int at = i + k < 0 ? 0 : i + k >= n ? n - 1 : i + k;
+
+                    sum += (radius + 1 - abs(k)) * ((line[at] >> c) & 0xff);
+                }
+                out |= sum / den << c;
+            }
+            p[i * step] = out;
+        }
+    }
+}
+
+#define BLUR_RADIUS_MAX 63
+
+static void check_blur(void)
+{
+    bench_reseed();
+    for (int radius = 1; radius <= BLUR_RADIUS_MAX; radius++) {
+        twin_pixmap_t *pixmap;
+        uint32_t *ref;
+        int left, right, top, bottom, stride, diffs = 0;
+        char name[64], detail[64];
+
+        /* an area off the origin, at times narrower than the kernel */
+        left = bench_random() % (SIZE / 4);
+        top = bench_random() % (SIZE / 4);
+        right = left + 1 + bench_random() % (SIZE / 2 - left);
+        bottom = top + 1 + bench_random() % (SIZE / 2 - top);
+
+        snprintf(name, sizeof(name), "check/blur/%d", radius);
+        if (!bench_selected(name))
+            continue;
+        pixmap = bench_pixmap(TWIN_ARGB32, SIZE / 2, SIZE / 2);
+        stride = pixmap->stride / 4;
+        ref = malloc(pixmap->height * pixmap->stride);
+        if (!ref) {
+            fprintf(stderr, "bench: out of memory\n");
+            exit(EXIT_FAILURE);
+        }
+        memcpy(ref, pixmap->p.argb32, pixmap->height * pixmap->stride);
+
+        twin_stack_blur(pixmap, radius, left, right, top, bottom);
+        blur_reference(ref + top * stride + left, stride, 1, bottom - top,
+                       right - left, radius);
+        blur_reference(ref + top * stride + left, 1, stride, right - left,
+                       bottom - top, radius);
+
+        for (int i = 0; i < pixmap->height * stride; i++)
+            diffs += ref[i] != pixmap->p.argb32[i];
+        snprintf(detail, sizeof(detail), "%dx%d area, %d pixels differ",
+                 right - left, bottom - top, diffs);
+        check_report(name, !diffs, detail);
+        free(ref);
+        twin_pixmap_destroy(pixmap);
+    }
+}
+
+/*
+ * The analytic rasterizer against the 4x4 sampled one, which it replaces by
+ * default. They cannot agree pixel for pixel, the sampled one only sees 16
+ * points of each pixel, but their total coverage has to match closely. A fill
+ * clipped to a window of the destination has to match that window of the
+ * full fill, whatever edges cross the clip.
+ */
+
+typedef struct {
+    double sum_a, sum_b, sum_diff;
+    int max_diff;
+} raster_diff_t;
+
+static void raster_diff(raster_diff_t *d,
+                        const uint8_t *a,
+                        int a_stride,
+                        const uint8_t *b,
+                        int b_stride,
+                        int bytes,
+                        int rows)
+{
+    for (int y = 0; y < rows; y++)
+        for (int x = 0; x < bytes; x++) {
+            int va = a[y * a_stride + x], vb = b[y * b_stride + x];
+
+            d->sum_a += va;
+            d->sum_b += vb;
+            d->sum_diff += abs(va - vb);
+            d->max_diff = max(d->max_diff, abs(va - vb));
+        }
+}
+
+static twin_pixmap_t *raster_fill(twin_rasterizer_t kind,
+                                  twin_path_t *path,
+                                  twin_coord_t size,
+                                  twin_coord_t offset)
+{
+    twin_pixmap_t *pixmap = twin_pixmap_create(TWIN_A8, size, size);
+
+    if (!pixmap) {
+        fprintf(stderr, "bench: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+    twin_fill(pixmap, 0, TWIN_SOURCE, 0, 0, size, size);
+    twin_set_rasterizer(kind);
+    twin_fill_path(pixmap, path, offset, offset);
+    return pixmap;
+}
+
+/* Total coverage may differ by 0.5%, a clipped fill by rounding only */
+#define RASTER_COVERAGE_TOLERANCE 0.005
+#define RASTER_CLIP_TOLERANCE 1
+
+static void check_rasterizers(void)
+{
+    static const int vertices[] = {4, 16, 64, 256};
+    twin_rasterizer_t saved = twin_get_rasterizer();
+
+    if (!twin_set_rasterizer(TWIN_RASTER_ANALYTIC) ||
+        !twin_set_rasterizer(TWIN_RASTER_SAMPLED))
+        return;
+
+    for (size_t v = 0; v < sizeof(vertices) / sizeof(vertices[0]); v++) {
+        twin_pixmap_t *sampled, *analytic, *clipped;
+        twin_path_t *path;
+        raster_diff_t d = {0}, c = {0};
+        double total;
+        char name[64], detail[96];
+        bool ok;
+
+        snprintf(name, sizeof(name), "check/raster/%d", vertices[v]);
+        if (!bench_selected(name))
+            continue;
+
+        bench_reseed();
+        path = random_path(vertices[v], true);
+        sampled = raster_fill(TWIN_RASTER_SAMPLED, path, SIZE, 0);
+        analytic = raster_fill(TWIN_RASTER_ANALYTIC, path, SIZE, 0);
+        /* a window in the middle, crossed by edges on all four sides */
+        clipped = raster_fill(TWIN_RASTER_ANALYTIC, path, SIZE / 2, -SIZE / 4);
+
+        raster_diff(&d, sampled->p.a8, sampled->stride, analytic->p.a8,
+                    analytic->stride, SIZE, SIZE);
+        total = d.sum_a ? (d.sum_b - d.sum_a) / d.sum_a : 0;
+        ok = total <= RASTER_COVERAGE_TOLERANCE &&
+             total >= -RASTER_COVERAGE_TOLERANCE;
+        snprintf(detail, sizeof(detail),
+                 "coverage %+.3f%%, mean |diff| %.3f, max %d", total * 100,
+                 d.sum_diff / (SIZE * SIZE), d.max_diff);
+        check_report(name, ok, detail);
+
+        snprintf(name, sizeof(name), "check/raster/%d/clipped", vertices[v]);
+        raster_diff(&c, analytic->p.a8 + SIZE / 4 * analytic->stride + SIZE / 4,
+                    analytic->stride, clipped->p.a8, clipped->stride, SIZE / 2,
+                    SIZE / 2);
+        snprintf(detail, sizeof(detail), "max |diff| %d against the full fill",
+                 c.max_diff);
+        check_report(name, c.max_diff <= RASTER_CLIP_TOLERANCE, detail);
+
+        twin_pixmap_destroy(clipped);
+        twin_pixmap_destroy(analytic);
+        twin_pixmap_destroy(sampled);
+        twin_path_destroy(path);
+    }
+
+#if defined(CONFIG_LOADER_TVG)
+    if (bench_selected("check/raster/tiger")) {
+        twin_pixmap_t *sampled, *analytic;
+        raster_diff_t d = {0};
+        double total;
+        char detail[96];
+
+        twin_set_rasterizer(TWIN_RASTER_SAMPLED);
+        sampled = twin_tvg_to_pixmap_scale("assets/tiger.tvg", TWIN_ARGB32,
+                                           TIGER_SIZE, TIGER_SIZE);
+        twin_set_rasterizer(TWIN_RASTER_ANALYTIC);
+        analytic = twin_tvg_to_pixmap_scale("assets/tiger.tvg", TWIN_ARGB32,
+                                            TIGER_SIZE, TIGER_SIZE);
+        /* the asset is looked up from the top of the source tree */
+        if (sampled && analytic) {
+            raster_diff(&d, sampled->p.b, sampled->stride, analytic->p.b,
+                        analytic->stride, TIGER_SIZE * 4, TIGER_SIZE);
+            total = d.sum_a ? (d.sum_b - d.sum_a) / d.sum_a : 0;
+            snprintf(detail, sizeof(detail),
+                     "channels %+.3f%%, mean |diff| %.3f, max %d",
+                     total * 100, d.sum_diff / (TIGER_SIZE * TIGER_SIZE * 4),
+                     d.max_diff);
+            check_report("check/raster/tiger",
+                         total <= RASTER_COVERAGE_TOLERANCE &&
+                             total >= -RASTER_COVERAGE_TOLERANCE,
+                         detail);
+        }
+        if (sampled)
+            twin_pixmap_destroy(sampled);
+        if (analytic)
+            twin_pixmap_destroy(analytic);
+    }
+#endif
+    twin_set_rasterizer(saved);
+}
+
+/*
+ * Text drawn from several threads at once, which share the glyph cache and
+ * atlas, has to come out exactly as drawn by one thread. Every thread cycles
+ * through sizes and cap styles of its own so that glyphs are stored and
+ * evicted while other threads are looking them up.
+ */
+
+#define TEXT_THREADS 8
+#define TEXT_ROUNDS 40
+#define TEXT_REPEATS 4 /* passes over the rounds by every thread */
+
+typedef struct {
+    int id;
+    bool paint; /* through twin_paint_utf8() rather than twin_path_utf8() */
+    uint64_t ref[TEXT_ROUNDS];
+    int mismatches;
+} text_thread_t;
+
+/* FNV-1a of the pixels of an A8 pixmap */
+static uint64_t pixmap_hash(const twin_pixmap_t *pixmap)
+{
+    uint64_t hash = 14695981039346656037u;
+
+    for (twin_coord_t y = 0; y < pixmap->height; y++)
+        for (twin_coord_t x = 0; x < pixmap->width; x++)
+            hash = (hash ^ pixmap->p.a8[y * pixmap->stride + x]) *
+                   1099511628211u;
+    return hash;
+}
+
+static uint64_t text_render(int id, int round, bool paint)
+{
+    int size = 8 + (id * 7 + round * 3) % 33;
+    twin_pixmap_t *dst = twin_pixmap_create(TWIN_A8, SIZE * 2, 48);
+    twin_path_t *path = twin_path_create();
+    uint64_t hash = 0;
+
+    if (dst && path) {
+        twin_fill(dst, 0, TWIN_SOURCE, 0, 0, dst->width, dst->height);
+        twin_path_set_font_size(path, twin_int_to_fixed(size));
+        twin_path_set_cap_style(path, (id + round) % 2 ? TwinCapRound
+                                                       : TwinCapButt);
+        twin_path_move(path, twin_int_to_fixed(2), twin_int_to_fixed(size));
+        if (paint) {
+            twin_paint_utf8(dst, 0xff000000, path, bench_text);
+        } else {
+            twin_path_utf8(path, bench_text);
+            twin_fill_path(dst, path, 0, 0);
+        }
+        hash = pixmap_hash(dst);
+    }
+    if (path)
+        twin_path_destroy(path);
+    if (dst)
+        twin_pixmap_destroy(dst);
+    return hash;
+}
+
+static void *text_thread(void *closure)
+{
+    text_thread_t *t = closure;
+
+    for (int i = 0; i < TEXT_REPEATS * TEXT_ROUNDS; i++)
+        if (text_render(t->id, i % TEXT_ROUNDS, t->paint) !=
+            t->ref[i % TEXT_ROUNDS])
+            t->mismatches++;
+    return NULL;
+}
+
+static void check_text_threads(void)
+{
+    static const struct {
+        const char *name;
+        bool paint;
+    } kinds[] = {{"check/threads/path_utf8", false},
+                 {"check/threads/paint_utf8", true}};
+
+    for (size_t k = 0; k < sizeof(kinds) / sizeof(kinds[0]); k++) {
+        text_thread_t threads[TEXT_THREADS];
+        pthread_t ids[TEXT_THREADS];
+        int started = 0, mismatches = 0;
+        char detail[96];
+
+        if (!bench_selected(kinds[k].name))
+            continue;
+
+        for (int i = 0; i < TEXT_THREADS; i++) {
+            threads[i].id = i;
+            threads[i].paint = kinds[k].paint;
+            threads[i].mismatches = 0;
+            for (int round = 0; round < TEXT_ROUNDS; round++)
+                threads[i].ref[round] = text_render(i, round, kinds[k].paint);
+        }
+        for (; started < TEXT_THREADS; started++)
+            if (pthread_create(&ids[started], NULL, text_thread,
+                               &threads[started]))
+                break;
+        for (int i = 0; i < started; i++) {
+            pthread_join(ids[i], NULL);
+            mismatches += threads[i].mismatches;
+        }
+        snprintf(detail, sizeof(detail), "%d threads, %d of %d renders differ",
+                 started, mismatches, started * TEXT_REPEATS * TEXT_ROUNDS);
+        check_report(kinds[k].name, started && !mismatches, detail);
+    }
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "usage: %s [-c] [-f text|csv|json] [-s seed] [-t min_ms] "
+            "[filter...]\n"
+            "  -c  run the self-checks instead of the benchmarks\n"
+            "  -f  output format (default: text)\n"
+            "  -s  seed for generated inputs (default: 0x%x)\n"
+            "  -t  minimum run time per case in milliseconds (default: %d)\n"
+            "Only cases whose name contains one of the filters are run.\n",
+            prog, DEFAULT_SEED, DEFAULT_MIN_MS);
+}
+
+int main(int argc, char **argv)
+{
+    int opt;
+
+    while ((opt = getopt(argc, argv, "cf:s:t:h")) != -1) {
+        switch (opt) {
+        case 'c':
+            check_mode = true;
+            break;
+        case 'f':
+            if (!strcmp(optarg, "text"))
+                output = OUTPUT_TEXT;
+            else if (!strcmp(optarg, "csv"))
+                output = OUTPUT_CSV;
+            else if (!strcmp(optarg, "json"))
+                output = OUTPUT_JSON;
+            else {
+                usage(argv[0]);
+                return EXIT_FAILURE;
+            }
+            break;
+        case 's':
+            seed = strtoul(optarg, NULL, 0);
+            break;
+        case 't':
+            min_seconds = atoi(optarg) / 1000.0;
+            break;
+        default:
+            usage(argv[0]);
+            return opt == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    }
+    filters = argv + optind;
+    n_filters = argc - optind;
+
+    if (check_mode) {
+        check_simd();
+        check_blur();
+        check_rasterizers();
+        check_text_threads();
+    } else {
+        bench_composite();
+        bench_fill();
+        bench_paths();
+        bench_circles();
+        bench_clipped_paths();
+        bench_rasterizers();
+        bench_strokers();
+        bench_text_render();
+        bench_blur();
+        bench_screen();
+    }
+
+    if (output == OUTPUT_JSON)
+        printf("%s\n", n_results ? "\n]" : "[]");
+    return n_failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
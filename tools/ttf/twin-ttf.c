@@ -20,25 +20,66 @@
  * PERFORMANCE OF THIS SOFTWARE.
  */
 
+#include <getopt.h>
+
 #include "twin-ttf.h"
 
-static double pos(FT_Pos x, outline_closure_t *c)
+/*
+ * Glyphs are written in the layout src/font.c reads for TWIN_FONT_TYPE_TTF:
+ * left, right, ascent and descent, then 'm', 'l', '2' (quadratic) and 'c'
+ * (cubic) commands up to 'e'. Coordinates are 2.6 fixed point fractions of
+ * the em with y growing downwards.
+ */
+
+typedef struct {
+    int offset;
+    FT_ULong ucs4; /* first character drawn with the glyph */
+} glyph_start_t;
+
+typedef struct {
+    outline_closure_t closure;
+    unsigned int *glyph_offsets; /* per glyph index, offset + 1 once written */
+    glyph_start_t *starts;       /* in outline order, for C comments */
+    int nstarts;
+    charmap_t *charmap;
+    int ncharmap;
+} font_t;
+
+static void *xrealloc(void *ptr, size_t size)
 {
-    FT_Face face = c->face;
+    ptr = realloc(ptr, size);
+    if (!ptr) {
+        fprintf(stderr, "out of memory\n");
+        exit(1);
+    }
+    return ptr;
+}
 
-    return (double) x / (double) face->units_per_EM;
+static void emit(int v, outline_closure_t *c)
+{
+    if (c->offset == c->size) {
+        c->size = c->size ? c->size * 2 : 4096;
+        c->outlines = xrealloc(c->outlines, c->size);
+    }
+    c->outlines[c->offset++] = v;
 }
 
-static void command(char cmd, outline_closure_t *c)
+static int pos(FT_Pos x, outline_closure_t *c)
 {
-    printf("\t'%c', ", cmd);
-    c->offset++;
+    int v = (int) floor(64.0 * x / c->face->units_per_EM + 0.5);
+
+    return v < -128 ? -128 : v > 127 ? 127 : v;
 }
 
 static void cpos(FT_Pos x, outline_closure_t *c)
 {
-    printf("0x%02x, ", ((int) (floor(64.0 * pos(x, c) + 0.5))) & 0xff);
-    c->offset++;
+    emit(pos(x, c), c);
+}
+
+static void cpoint(const FT_Vector *p, outline_closure_t *c)
+{
+    cpos(p->x, c);
+    cpos(-p->y, c);
 }
 
 static unsigned char *ucs4_to_utf8(FT_ULong ucs4, unsigned char dest[8])
@@ -74,31 +115,19 @@ static unsigned char *ucs4_to_utf8(FT_ULong ucs4, unsigned char dest[8])
     return dest;
 }
 
-static void glyph(FT_Pos advance, FT_ULong ucs4, outline_closure_t *c)
-{
-    unsigned char utf8[8];
-    printf("    /* 0x%lx (%s) */ ", ucs4, ucs4_to_utf8(ucs4, utf8));
-    cpos(advance, c);
-    printf("\n");
-}
-
 static int outline_moveto(const FT_Vector *to, void *user)
 {
     outline_closure_t *c = user;
-    command('m', c);
-    cpos(to->x, c);
-    cpos(to->y, c);
-    printf("\n");
+    emit('m', c);
+    cpoint(to, c);
     return 0;
 }
 
 static int outline_lineto(const FT_Vector *to, void *user)
 {
     outline_closure_t *c = user;
-    command('l', c);
-    cpos(to->x, c);
-    cpos(to->y, c);
-    printf("\n");
+    emit('l', c);
+    cpoint(to, c);
     return 0;
 }
 
@@ -107,12 +136,9 @@ static int outline_conicto(const FT_Vector *control,
                            void *user)
 {
     outline_closure_t *c = user;
-    command('2', c);
-    cpos(control->x, c);
-    cpos(control->y, c);
-    cpos(to->x, c);
-    cpos(to->y, c);
-    printf("\n");
+    emit('2', c);
+    cpoint(control, c);
+    cpoint(to, c);
     return 0;
 }
 
@@ -122,14 +148,10 @@ static int outline_cubicto(const FT_Vector *control1,
                            void *user)
 {
     outline_closure_t *c = user;
-    command('2', c);
-    cpos(control1->x, c);
-    cpos(control1->y, c);
-    cpos(control2->x, c);
-    cpos(control2->y, c);
-    cpos(to->x, c);
-    cpos(to->y, c);
-    printf("\n");
+    emit('c', c);
+    cpoint(control1, c);
+    cpoint(control2, c);
+    cpoint(to, c);
     return 0;
 }
 
@@ -137,17 +159,37 @@ static const FT_Outline_Funcs outline_funcs = {
     outline_moveto, outline_lineto, outline_conicto, outline_cubicto, 0, 0,
 };
 
-#define UCS_PAGE_SHIFT 7
-#define UCS_PER_PAGE (1 << UCS_PAGE_SHIFT)
+/* Append the outline of glyph gindex, or an empty glyph if it has none */
+static void glyph(FT_UInt gindex, outline_closure_t *c)
+{
+    FT_Face face = c->face;
+    FT_Int32 load_flags = FT_LOAD_NO_SCALE | FT_LOAD_LINEAR_DESIGN;
+
+    if (FT_Load_Glyph(face, gindex, load_flags) != 0) {
+        emit(0, c);
+        emit(0, c);
+        emit(0, c);
+        emit(0, c);
+        emit('e', c);
+        return;
+    }
+    cpos(face->glyph->metrics.horiBearingX, c);
+    /* glyphs are spaced by their right edge, so that is the advance */
+    cpos(face->glyph->linearHoriAdvance, c);
+    cpos(face->glyph->metrics.horiBearingY, c);
+    cpos(face->glyph->metrics.height - face->glyph->metrics.horiBearingY, c);
+    FT_Outline_Decompose(&face->glyph->outline, &outline_funcs, c);
+    emit('e', c);
+}
 
 static int ucs_page(FT_ULong ucs4)
 {
     return ucs4 >> UCS_PAGE_SHIFT;
 }
 
-static FT_ULong ucs_first_in_page(FT_ULong ucs4)
+static int ucs_char_in_page(FT_ULong ucs4)
 {
-    return ucs4 & ~(UCS_PER_PAGE - 1);
+    return ucs4 & (UCS_PER_PAGE - 1);
 }
 
 static void sanitize(char *in, char *out, int first)
@@ -182,103 +224,219 @@ static char *facename(FT_Face face)
 
 #define MAX_UCS4 0x1000000
 
-static int convert_font(char *in_name, int id)
+static void collect_font(FT_Face face, font_t *font)
 {
-    FT_Library ftLibrary;
-    FT_Face face;
+    outline_closure_t *c = &font->closure;
     FT_UInt gindex;
     FT_ULong ucs4;
-    FT_Int32 load_flags;
-    outline_closure_t closure;
-    FT_ULong min_ucs4, max_ucs4;
-    int *offsets;
-    int ncharmap;
 
-    if (FT_Init_FreeType(&ftLibrary))
-        return 0;
+    c->face = face;
+    font->glyph_offsets = calloc(face->num_glyphs + 1, sizeof(unsigned int));
 
-    if (FT_New_Face(ftLibrary, in_name, id, &face))
-        return 0;
+    /* characters missing from a page draw glyph 0, at offset 0 */
+    glyph(0, c);
+    font->glyph_offsets[0] = 1;
+    font->starts = xrealloc(NULL, sizeof(glyph_start_t));
+    font->starts[font->nstarts++] = (glyph_start_t) {0, 0};
 
-    if (FT_Select_Charmap(face, ft_encoding_unicode))
-        return 0;
+    for (ucs4 = FT_Get_First_Char(face, &gindex);
+         gindex != 0 && ucs4 < MAX_UCS4;
+         ucs4 = FT_Get_Next_Char(face, ucs4, &gindex)) {
+        charmap_t *page;
 
-    load_flags = FT_LOAD_NO_SCALE | FT_LOAD_LINEAR_DESIGN;
+        if (!font->glyph_offsets[gindex]) {
+            int start = c->offset;
 
-    closure.face = face;
-    closure.offset = 0;
+            glyph(gindex, c);
+            font->glyph_offsets[gindex] = start + 1;
+            font->starts = xrealloc(font->starts, (font->nstarts + 1) *
+                                                      sizeof(glyph_start_t));
+            font->starts[font->nstarts++] = (glyph_start_t) {start, ucs4};
+        }
 
-    offsets = calloc(face->num_glyphs + 1, sizeof(int));
+        if (!font->ncharmap ||
+            font->charmap[font->ncharmap - 1].page != ucs_page(ucs4)) {
+            font->charmap = xrealloc(font->charmap,
+                                     (font->ncharmap + 1) * sizeof(charmap_t));
+            page = &font->charmap[font->ncharmap++];
+            memset(page, 0, sizeof(*page));
+            page->page = ucs_page(ucs4);
+        }
+        page = &font->charmap[font->ncharmap - 1];
+        page->offsets[ucs_char_in_page(ucs4)] =
+            font->glyph_offsets[gindex] - 1;
+    }
+}
+
+/* Print one glyph, a command per line; returns the offset past it */
+static int write_c_glyph(const signed char *g, int offset)
+{
+    int n;
+
+    printf("    %d, %d, %d, %d,\n", g[offset], g[offset + 1], g[offset + 2],
+           g[offset + 3]);
+    offset += 4;
+    for (;;) {
+        char op = g[offset++];
+
+        switch (op) {
+        case 'm':
+        case 'l':
+            n = 2;
+            break;
+        case '2':
+            n = 4;
+            break;
+        case 'c':
+            n = 6;
+            break;
+        default:
+            printf("    'e',\n");
+            return offset;
+        }
+        printf("    '%c',", op);
+        while (n--)
+            printf(" %d,", g[offset++]);
+        printf("\n");
+    }
+}
+
+static void write_c(FT_Face face, font_t *font, const char *in_name)
+{
+    outline_closure_t *c = &font->closure;
+    unsigned char utf8[8];
+    int offset = 0;
 
-    min_ucs4 = 0xffffff;
-    max_ucs4 = 0;
     printf("/* Derived from %s */\n\n", in_name);
-    printf("#include \"twin_private.h\"\n\n");
+    printf("#include \"twin.h\"\n\n");
     printf("/* clang-format off */\n");
-    printf("static const char outlines[] = {\n");
-    for (ucs4 = FT_Get_First_Char(face, &gindex);
-         gindex != 0 && ucs4 < MAX_UCS4;
-         ucs4 = FT_Get_Next_Char(face, ucs4, &gindex)) {
-        if (FT_Load_Glyph(face, gindex, load_flags) != 0)
-            continue;
-        if (ucs4 < min_ucs4)
-            min_ucs4 = ucs4;
-        if (ucs4 > max_ucs4)
-            max_ucs4 = ucs4;
-        offsets[gindex] = closure.offset + 1;
-        glyph(face->glyph->linearHoriAdvance, ucs4, &closure);
-        FT_Outline_Decompose(&face->glyph->outline, &outline_funcs, &closure);
-        command('e', &closure);
-        printf("\n");
+    printf("static const signed char outlines[] = {\n");
+    for (int g = 0; g < font->nstarts; g++) {
+        if (g == 0)
+            printf("/* missing glyph  offset 0 */\n");
+        else
+            printf("/* 0x%lx (%s)  offset %d */\n", font->starts[g].ucs4,
+                   ucs4_to_utf8(font->starts[g].ucs4, utf8), offset);
+        offset = write_c_glyph(c->outlines, offset);
     }
     printf("};\n");
     printf("/* clang-format on */\n\n");
-    printf("static const twin_charmap_t charmap[] = {\n");
-    ncharmap = 0;
-    for (ucs4 = FT_Get_First_Char(face, &gindex);
-         gindex != 0 && ucs4 < MAX_UCS4;
-         ucs4 = FT_Get_Next_Char(face, ucs4, &gindex)) {
-        FT_ULong page = ucs_first_in_page(ucs4);
-        FT_ULong off;
 
-        printf("    { 0x%04x, {\n", ucs_page(page));
-        for (off = 0; off < UCS_PER_PAGE; off++) {
-            FT_UInt g = FT_Get_Char_Index(face, page + off);
+    printf("static const twin_charmap_t charmap[] = {\n");
+    for (int p = 0; p < font->ncharmap; p++) {
+        printf("    {0x%04x,\n     {\n", font->charmap[p].page);
+        for (int off = 0; off < UCS_PER_PAGE; off++) {
             if ((off & 7) == 0)
-                printf("\t");
-            printf("0x%04x, ", offsets[g]);
+                printf("        ");
+            printf(" %u,", font->charmap[p].offsets[off]);
             if ((off & 7) == 7)
                 printf("\n");
         }
-        printf("    }},\n");
-        ucs4 = page + UCS_PER_PAGE - 1;
-        ncharmap++;
+        printf("     }},\n");
     }
     printf("};\n\n");
+
     printf("twin_font_t twin_%s = {\n", facename(face));
+    printf("    .type = TWIN_FONT_TYPE_TTF,\n");
     printf("    .name = \"%s\",\n", face->family_name);
     printf("    .style = \"%s\",\n", face->style_name);
-    printf("    .n_charmap = %d,\n", ncharmap);
+    printf("    .n_charmap = %d,\n", font->ncharmap);
     printf("    .charmap = charmap,\n");
     printf("    .outlines = outlines,\n");
-    printf("    .ascender = ");
-    cpos(face->ascender, &closure);
-    printf("\n");
-    printf("    .descender = ");
-    cpos(face->descender, &closure);
-    printf("\n");
-    printf("    .height = ");
-    cpos(face->height, &closure);
-    printf("\n");
+    printf("    .ascender = %d,\n", pos(face->ascender, c));
+    printf("    .descender = %d,\n", pos(face->descender, c));
+    printf("    .height = %d,\n", pos(face->height, c));
     printf("};\n");
+}
+
+static int write_binary(FT_Face face, font_t *font, const char *out_name)
+{
+    outline_closure_t *c = &font->closure;
+    size_t name_len = strlen(face->family_name) + 1;
+    size_t style_len = strlen(face->style_name) + 1;
+    font_file_header_t header = {
+        .magic = FONT_FILE_MAGIC,
+        .version = FONT_FILE_VERSION,
+        .type = FONT_TYPE_TTF,
+        .n_charmap = font->ncharmap,
+        .outlines_size = c->offset,
+        .ascender = pos(face->ascender, c),
+        .descender = pos(face->descender, c),
+        .height = pos(face->height, c),
+    };
+    static const char zero[4];
+    size_t pad;
+    FILE *f;
+
+    header.name = sizeof(header);
+    header.style = header.name + name_len;
+    header.charmap = (header.style + style_len + 3) & ~3u;
+    header.outlines = header.charmap + font->ncharmap * sizeof(charmap_t);
+    pad = header.charmap - (header.style + style_len);
+
+    f = fopen(out_name, "wb");
+    if (!f) {
+        perror(out_name);
+        return 0;
+    }
+    fwrite(&header, sizeof(header), 1, f);
+    fwrite(face->family_name, name_len, 1, f);
+    fwrite(face->style_name, style_len, 1, f);
+    fwrite(zero, pad, 1, f);
+    fwrite(font->charmap, sizeof(charmap_t), font->ncharmap, f);
+    fwrite(c->outlines, 1, c->offset, f);
+    if (fclose(f) != 0) {
+        perror(out_name);
+        return 0;
+    }
+    return 1;
+}
+
+static int convert_font(const char *in_name, const char *out_name)
+{
+    FT_Library ftLibrary;
+    FT_Face face;
+    font_t font = {0};
+
+    if (FT_Init_FreeType(&ftLibrary))
+        return 0;
+
+    if (FT_New_Face(ftLibrary, in_name, 0, &face))
+        return 0;
+
+    if (FT_Select_Charmap(face, ft_encoding_unicode))
+        return 0;
+
+    collect_font(face, &font);
+    if (out_name)
+        return write_binary(face, &font, out_name);
+    write_c(face, &font, in_name);
     return 1;
 }
 
 int main(int argc, char **argv)
 {
-    if (argc < 2)
-        return 1;
+    const char *out_name = NULL;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "o:")) != -1) {
+        switch (opt) {
+        case 'o':
+            out_name = optarg;
+            break;
+        default:
+            goto usage;
+        }
+    }
+    if (optind != argc - 1)
+        goto usage;
 
-    convert_font(argv[1], 0);
-    return 0;
+    return convert_font(argv[optind], out_name) ? 0 : 1;
+
+usage:
+    fprintf(stderr,
+            "usage: %s [-o font.twf] font.ttf\n"
+            "  without -o, the font is printed as C source to stdout\n",
+            argv[0]);
+    return 1;
 }
@@ -28,12 +28,44 @@
 #include FT_OUTLINE_H
 
 #include <math.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+
+#define UCS_PAGE_SHIFT 7
+#define UCS_PER_PAGE (1 << UCS_PAGE_SHIFT)
+
+typedef struct {
+    unsigned int page;
+    unsigned int offsets[UCS_PER_PAGE];
+} charmap_t;
 
 typedef struct {
     FT_Face face;
-    int offset;
+    signed char *outlines;
+    int offset; /* bytes of outlines in use */
+    int size;
 } outline_closure_t;
 
+/*
+ * Font file layout, which has to match twin_font_file_header_t in
+ * include/twin_private.h
+ */
+#define FONT_FILE_MAGIC 0x31465754 /* "TWF1" */
+#define FONT_FILE_VERSION 1
+#define FONT_TYPE_TTF 2
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t type;
+    uint32_t n_charmap;
+    uint32_t charmap;
+    uint32_t outlines;
+    uint32_t outlines_size;
+    uint32_t name, style;
+    int8_t ascender, descender, height, pad;
+} font_file_header_t;
+
 #endif /* _TWIN_TTF_H_ */